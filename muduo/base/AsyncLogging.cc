@@ -7,16 +7,16 @@ using namespace muduo;
 AsyncLogging::AsyncLogging(const string &basename,
                            size_t rollSize,
                            int flushInterval)
-    : flushInterval_(flushInterval),
-      running_(false),
-      basename_(basename),
+    : basename_(basename),
       rollSize_(rollSize),
+      flushInterval_(flushInterval),
+      running_(false),
       thread_(boost::bind(&AsyncLogging::threadFunc, this), "Logging"),
       latch_(1),
       mutex_(),
       cond_(mutex_),
-      currentBuffer_(new Buffer),
-      nextBuffer_(new Buffer),
+      currentBuffer_(new Buffer, BufferPtr::deleter_type()),
+      nextBuffer_(new Buffer, BufferPtr::deleter_type()),
       buffers_()
 {
     currentBuffer_->bzero();
@@ -44,7 +44,7 @@ void AsyncLogging::append(const char *logline, int len)
         else
         {
             // 这种情况, 极少发生, 前端写入速度太快, 一下子把两块缓冲区都写完, 那么, 只好分配一块新的缓冲区.
-            currentBuffer_.reset(new Buffer);
+            currentBuffer_.reset(new Buffer, BufferPtr::deleter_type());
         }
 
         currentBuffer_->append(logline, len);
@@ -61,8 +61,8 @@ void AsyncLogging::threadFunc()
     LogFile output(basename_, rollSize_, false);
 
     // 准备两块空闲缓冲区
-    BufferPtr newBuffer1(new Buffer);
-    BufferPtr newBuffer2(new Buffer);
+    BufferPtr newBuffer1(new Buffer, BufferPtr::deleter_type());
+    BufferPtr newBuffer2(new Buffer, BufferPtr::deleter_type());
     newBuffer1->bzero();
     newBuffer2->bzero();
 
@@ -28,6 +28,7 @@ class LoggerImpl
 */
     __thread char t_errnobuf[512];
     __thread char t_time[32];
+    __thread const Timestamp *t_clock = NULL; // 见Logger::setThreadClock()
     __thread time_t t_lastSecond;
 
     const char *strerror_tl(int savedErrno)
@@ -102,7 +103,7 @@ class LoggerImpl
 using namespace muduo;
 
 Logger::Impl::Impl(LogLevel level, int savedErrno, const SourceFile &file, int line)
-    : time_(Timestamp::now()),
+    : time_(t_clock && t_clock->valid() ? *t_clock : Timestamp::now()),
       stream_(),
       level_(level),
       line_(line),
@@ -188,3 +189,8 @@ void Logger::setFlush(FlushFunc flush)
 {
     g_flush = flush;
 }
+
+void Logger::setThreadClock(const Timestamp *clock)
+{
+    t_clock = clock;
+}
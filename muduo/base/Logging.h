@@ -70,6 +70,10 @@ namespace muduo
         static void setOutput(OutputFunc);
         static void setFlush(FlushFunc);
 
+        // 本线程的日志使用*clock作为时间, 而不是每条日志都读一次时钟. NULL表示恢复成Timestamp::now().
+        // EventLoop在粗粒度时钟模式下会把它设为poll返回的时刻, 见EventLoop::setCoarseClock().
+        static void setThreadClock(const Timestamp *clock);
+
     private:
         // -------------------------------------
         // Impl
@@ -0,0 +1,267 @@
+#include <muduo/base/ThreadPlacement.h>
+#include <muduo/base/CurrentThread.h>
+#include <muduo/base/Logging.h>
+
+#include <algorithm>
+
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+using namespace muduo;
+
+namespace
+{
+    // set_mempolicy()/get_mempolicy()的节点掩码位数
+    const int kMaxNodes = 1024;
+    const int kBitsPerLong = static_cast<int>(8 * sizeof(unsigned long));
+
+    struct NodeMask
+    {
+        unsigned long bits[kMaxNodes / kBitsPerLong];
+
+        NodeMask() { memset(bits, 0, sizeof bits); }
+        void set(int node) { bits[node / kBitsPerLong] |= 1UL << (node % kBitsPerLong); }
+        bool isSet(int node) const { return (bits[node / kBitsPerLong] >> (node % kBitsPerLong)) & 1; }
+    };
+
+    // 内核先把maxnode减一, 所以要多传一位
+    const unsigned long kMaxNodeArg = kMaxNodes + 1;
+
+    const char *policyName(int mode)
+    {
+        switch (mode)
+        {
+        case MPOL_DEFAULT:
+            return "default";
+        case MPOL_PREFERRED:
+            return "preferred";
+        case MPOL_BIND:
+            return "bind";
+        case MPOL_INTERLEAVE:
+            return "interleave";
+        default:
+            return "other";
+        }
+    }
+}
+
+bool ThreadPlacement::parseCpuList(const string &list, std::vector<int> *cpus)
+{
+    std::vector<int> result;
+    const char *p = list.c_str();
+    while (*p)
+    {
+        char *end = NULL;
+        long first = ::strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            ++p;
+            last = ::strtol(p, &end, 10);
+            if (end == p || last < first || last >= CPU_SETSIZE)
+            {
+                return false;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+        {
+            result.push_back(static_cast<int>(cpu));
+        }
+        if (*p == ',')
+        {
+            ++p;
+        }
+        else if (*p)
+        {
+            return false;
+        }
+    }
+    if (result.empty())
+    {
+        return false;
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    cpus->swap(result);
+    return true;
+}
+
+string ThreadPlacement::formatCpuList(const std::vector<int> &cpus)
+{
+    std::vector<int> sorted(cpus);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    string result;
+    for (size_t i = 0; i < sorted.size();)
+    {
+        size_t j = i;
+        while (j + 1 < sorted.size() && sorted[j + 1] == sorted[j] + 1)
+        {
+            ++j;
+        }
+        char buf[32];
+        if (j == i)
+        {
+            snprintf(buf, sizeof buf, "%s%d", result.empty() ? "" : ",", sorted[i]);
+        }
+        else
+        {
+            snprintf(buf, sizeof buf, "%s%d-%d", result.empty() ? "" : ",", sorted[i], sorted[j]);
+        }
+        result += buf;
+        i = j + 1;
+    }
+    return result;
+}
+
+int ThreadPlacement::nodeOfCpu(int cpu)
+{
+    char path[64];
+    snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = ::opendir(path);
+    if (dir == NULL)
+    {
+        return -1;
+    }
+
+    int node = -1;
+    while (struct dirent *entry = ::readdir(dir))
+    {
+        char *end = NULL;
+        if (strncmp(entry->d_name, "node", 4) == 0)
+        {
+            long n = ::strtol(entry->d_name + 4, &end, 10);
+            if (end != entry->d_name + 4 && *end == '\0')
+            {
+                node = static_cast<int>(n);
+                break;
+            }
+        }
+    }
+    ::closedir(dir);
+    return node;
+}
+
+// 先检查完所有参数再修改, set_mempolicy失败时恢复原来的CPU亲和性, 失败的apply()不留下一半的效果.
+bool ThreadPlacement::apply() const
+{
+    if (cpus_.empty())
+    {
+        return true;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cpus_.size(); ++i)
+    {
+        if (cpus_[i] < 0 || cpus_[i] >= CPU_SETSIZE)
+        {
+            LOG_ERROR << "ThreadPlacement::apply invalid cpu " << cpus_[i];
+            return false;
+        }
+        CPU_SET(cpus_[i], &set);
+    }
+
+    NodeMask nodes;
+    if (bindMemory_)
+    {
+        bool found = false;
+        for (size_t i = 0; i < cpus_.size(); ++i)
+        {
+            int node = nodeOfCpu(cpus_[i]);
+            if (node >= 0 && node < kMaxNodes)
+            {
+                nodes.set(node);
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            LOG_WARN << "ThreadPlacement::apply unknown NUMA node of cpus " << formatCpuList(cpus_);
+            return false;
+        }
+    }
+
+    cpu_set_t old;
+    if (::sched_getaffinity(0, sizeof old, &old) < 0)
+    {
+        LOG_SYSERR << "ThreadPlacement::apply sched_getaffinity";
+        return false;
+    }
+    if (::sched_setaffinity(0, sizeof set, &set) < 0)
+    {
+        LOG_SYSERR << "ThreadPlacement::apply sched_setaffinity " << formatCpuList(cpus_);
+        return false;
+    }
+
+    if (bindMemory_ && ::syscall(SYS_set_mempolicy, MPOL_BIND, nodes.bits, kMaxNodeArg) < 0)
+    {
+        LOG_SYSERR << "ThreadPlacement::apply set_mempolicy";
+        if (::sched_setaffinity(0, sizeof old, &old) < 0)
+        {
+            LOG_SYSERR << "ThreadPlacement::apply restore affinity";
+        }
+        return false;
+    }
+    return true;
+}
+
+string ThreadPlacement::current()
+{
+    char buf[128];
+    snprintf(buf, sizeof buf, "%s tid %d cpu %d cpus ", CurrentThread::name(), CurrentThread::tid(), ::sched_getcpu());
+    string result(buf);
+
+    cpu_set_t set;
+    if (::sched_getaffinity(0, sizeof set, &set) == 0)
+    {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        result += formatCpuList(cpus);
+    }
+    else
+    {
+        result += "?";
+    }
+
+    int mode = 0;
+    NodeMask nodes;
+    if (::syscall(SYS_get_mempolicy, &mode, nodes.bits, kMaxNodeArg, NULL, 0) == 0)
+    {
+        mode &= ~MPOL_MODE_FLAGS;
+        result += " mempolicy ";
+        result += policyName(mode);
+        if (mode != MPOL_DEFAULT)
+        {
+            std::vector<int> list;
+            for (int node = 0; node < kMaxNodes; ++node)
+            {
+                if (nodes.isSet(node))
+                {
+                    list.push_back(node);
+                }
+            }
+            result += " nodes " + formatCpuList(list);
+        }
+    }
+    return result;
+}
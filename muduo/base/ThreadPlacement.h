@@ -0,0 +1,50 @@
+#ifndef MUDUO_BASE_THREADPLACEMENT_H
+#define MUDUO_BASE_THREADPLACEMENT_H
+
+#include <muduo/base/copyable.h>
+#include <muduo/base/Types.h>
+
+#include <vector>
+
+namespace muduo
+{
+    // 线程放在哪里运行: 绑定到一组CPU(sched_setaffinity), 并且可以把内存策略绑定(MPOL_BIND)到这些CPU所在的NUMA节点,
+    // 之后这个线程分配并首次访问的内存(比如连接的缓冲区)都在本地节点上, 不会因为线程迁移到别的socket而变成远端内存.
+    // 直接使用系统调用, 不依赖libnuma. 在要放置的线程中调用apply(), 见EventLoopThreadPool和ThreadPool.
+    class ThreadPlacement : public muduo::copyable
+    {
+    public:
+        ThreadPlacement() : bindMemory_(false) {} // 不限制
+
+        // bindMemory: 同时把内存策略绑定到cpus所在的NUMA节点
+        explicit ThreadPlacement(const std::vector<int> &cpus, bool bindMemory = false)
+            : cpus_(cpus), bindMemory_(bindMemory)
+        {
+        }
+
+        // 解析"0-3,8,10-11"这样的CPU列表, 格式和taskset -c以及/sys/devices/system/cpu/online相同. 格式错误返回false.
+        static bool parseCpuList(const string &list, std::vector<int> *cpus);
+        static string formatCpuList(const std::vector<int> &cpus);
+
+        // cpu所在的NUMA节点, 从/sys/devices/system/cpu/cpuN/nodeM读取, 不知道时返回-1
+        static int nodeOfCpu(int cpu);
+
+        bool empty() const { return cpus_.empty(); }
+        const std::vector<int> &cpus() const { return cpus_; }
+        bool bindMemory() const { return bindMemory_; }
+
+        // 对当前线程生效. 失败时记日志并返回false, 线程还是按原来的放置运行. empty()时什么也不做.
+        bool apply() const;
+
+        // 当前线程实际的放置, 比如"io0 tid 1234 cpu 2 cpus 0-3 mempolicy bind nodes 0"
+        // (线程名, tid, 正在运行的CPU, 允许的CPU, 内存策略), 用于报告.
+        static string current();
+
+    private:
+        std::vector<int> cpus_;
+        bool bindMemory_;
+    };
+
+} // namespace muduo
+
+#endif // MUDUO_BASE_THREADPLACEMENT_H
@@ -58,6 +58,12 @@ void ThreadPool::run(const Task &task)
     }
 }
 
+std::vector<string> ThreadPool::threadPlacementReports()
+{
+    MutexLockGuard lock(mutex_);
+    return placementReports_;
+}
+
 ThreadPool::Task ThreadPool::take()
 {
     MutexLockGuard lock(mutex_);
@@ -77,6 +83,12 @@ ThreadPool::Task ThreadPool::take()
 
 void ThreadPool::runInThread()
 {
+    placement_.apply();
+    {
+        MutexLockGuard lock(mutex_);
+        placementReports_.push_back(ThreadPlacement::current());
+    }
+
     try
     {
         while (running_)
@@ -4,6 +4,7 @@
 #include <muduo/base/Condition.h>
 #include <muduo/base/Mutex.h>
 #include <muduo/base/Thread.h>
+#include <muduo/base/ThreadPlacement.h>
 #include <muduo/base/Types.h>
 
 #include <boost/function.hpp>
@@ -11,6 +12,7 @@
 #include <boost/ptr_container/ptr_vector.hpp>
 
 #include <deque>
+#include <vector>
 
 namespace muduo
 {
@@ -22,6 +24,12 @@ namespace muduo
         explicit ThreadPool(const string &name = string());
         ~ThreadPool();
 
+        // 所有工作线程都按placement放置, 通常是和IO线程分开的一组CPU. 必须在start()之前调用.
+        void setThreadPlacement(const ThreadPlacement &placement) { placement_ = placement; }
+
+        // 已经启动的工作线程实际的放置, 每个线程一行, 见ThreadPlacement::current()
+        std::vector<string> threadPlacementReports();
+
         void start(int numThreads);
         void stop();
 
@@ -37,6 +45,8 @@ namespace muduo
         boost::ptr_vector<muduo::Thread> threads_;
         std::deque<Task> queue_;
         bool running_;
+        ThreadPlacement placement_;
+        std::vector<string> placementReports_; // 由mutex_保护
     };
 
 } // namespace muduo
@@ -1,5 +1,6 @@
 #include <muduo/base/Timestamp.h>
 #include <sys/time.h>
+#include <time.h>
 #include <stdio.h>
 #define __STDC_FORMAT_MACROS  // 本机测试, 可以不需要定义这个宏, inttypes.h源码也没有这个条件了.
 #include <inttypes.h>  // PRId64
@@ -58,6 +59,14 @@ Timestamp Timestamp::now()
     return Timestamp(seconds * kMicroSecondsPerSecond + tv.tv_usec); // tv.tv_usec就是微秒
 }
 
+Timestamp Timestamp::nowCoarse()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    int64_t seconds = ts.tv_sec;
+    return Timestamp(seconds * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
 Timestamp Timestamp::invalid()
 {
     return Timestamp();
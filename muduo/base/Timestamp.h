@@ -36,6 +36,10 @@ namespace muduo
         // 返回一个记录当前时间的Timestamp对象.
         static Timestamp now();
 
+        // CLOCK_REALTIME_COARSE, 不进内核也不读TSC, 比now()快, 但精度只有一个tick(通常1~4ms).
+        // 只适合能容忍毫秒级误差的场合, 见EventLoop::setCoarseClock().
+        static Timestamp nowCoarse();
+
         // 返回一个invalid的Timestamp对象
         static Timestamp invalid();
 
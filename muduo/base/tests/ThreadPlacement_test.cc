@@ -0,0 +1,62 @@
+#include <muduo/base/ThreadPlacement.h>
+#include <muduo/base/ThreadPool.h>
+#include <muduo/base/CountDownLatch.h>
+
+#include <boost/bind.hpp>
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+
+// 用法: threadplacement_test [cpu列表]  比如 threadplacement_test 0-1
+int main(int argc, char *argv[])
+{
+  std::vector<int> cpus;
+  bool parsed = muduo::ThreadPlacement::parseCpuList("0-3,8,10-11", &cpus);
+  assert(parsed);
+  assert(cpus.size() == 7 && cpus[4] == 8);
+  assert(muduo::ThreadPlacement::formatCpuList(cpus) == "0-3,8,10-11");
+  std::vector<int> bad;
+  bool parsedEmpty = muduo::ThreadPlacement::parseCpuList("", &bad);
+  bool parsedReversed = muduo::ThreadPlacement::parseCpuList("3-1", &bad);
+  bool parsedJunk = muduo::ThreadPlacement::parseCpuList("1,x", &bad);
+  assert(!parsedEmpty && !parsedReversed && !parsedJunk);
+  assert(bad.empty());
+  (void)parsed;
+  (void)parsedEmpty;
+  (void)parsedReversed;
+  (void)parsedJunk;
+
+  // 失败的apply()不改变当前线程的放置
+  cpu_set_t before;
+  cpu_set_t after;
+  ::sched_getaffinity(0, sizeof before, &before);
+  bool applied = muduo::ThreadPlacement(std::vector<int>(1, CPU_SETSIZE - 1), true).apply();
+  ::sched_getaffinity(0, sizeof after, &after);
+  assert(!applied);
+  assert(CPU_EQUAL(&before, &after));
+  (void)applied;
+
+  printf("main: %s\n", muduo::ThreadPlacement::current().c_str());
+  printf("cpu 0 is on node %d\n", muduo::ThreadPlacement::nodeOfCpu(0));
+
+  if (!muduo::ThreadPlacement::parseCpuList(argc > 1 ? argv[1] : "0", &cpus))
+  {
+    printf("bad cpu list\n");
+    return 1;
+  }
+  muduo::ThreadPool pool("placed");
+  pool.setThreadPlacement(muduo::ThreadPlacement(cpus, true));
+  pool.start(2);
+
+  muduo::CountDownLatch latch(2);
+  pool.run(boost::bind(&muduo::CountDownLatch::countDown, &latch));
+  pool.run(boost::bind(&muduo::CountDownLatch::countDown, &latch));
+  latch.wait();
+  pool.stop(); // 两个任务可能都由同一个线程执行, 等所有线程都启动过再取报告
+
+  std::vector<muduo::string> reports(pool.threadPlacementReports());
+  for (size_t i = 0; i < reports.size(); ++i)
+  {
+    printf("%s\n", reports[i].c_str());
+  }
+}
@@ -58,6 +58,39 @@ void benchmark()
     }
 }
 
+// now()与nowCoarse()的开销和精度对比
+void benchmarkCoarse()
+{
+    const int kNumber = 1000 * 1000;
+
+    Timestamp start(Timestamp::now());
+    int64_t sum = 0;
+    for (int i = 0; i < kNumber; ++i)
+    {
+        sum += Timestamp::now().microSecondsSinceEpoch() & 1;
+    }
+    Timestamp middle(Timestamp::now());
+    int changes = 0;
+    Timestamp last(Timestamp::nowCoarse());
+    for (int i = 0; i < kNumber; ++i)
+    {
+        Timestamp t(Timestamp::nowCoarse());
+        if (t < last)
+        {
+            printf("reverse!\n");
+        }
+        else if (last < t)
+        {
+            ++changes;
+        }
+        last = t;
+    }
+    Timestamp end(Timestamp::now());
+    printf("now()       %.1f ns/call (%d)\n", timeDifference(middle, start) * 1e9 / kNumber, static_cast<int>(sum));
+    printf("nowCoarse() %.1f ns/call, %d distinct values, lag %.3fms\n", timeDifference(end, middle) * 1e9 / kNumber,
+           changes, timeDifference(Timestamp::now(), Timestamp::nowCoarse()) * 1000);
+}
+
 int main()
 {
     Timestamp tt(Timestamp::now());
@@ -66,5 +99,7 @@ int main()
     passByConstReference(tt);
     printf("----------- benchmark() ------------\n");
     benchmark();
+    printf("----------- benchmarkCoarse() ------------\n");
+    benchmarkCoarse();
 }
  
\ No newline at end of file
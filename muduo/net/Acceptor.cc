@@ -1,4 +1,5 @@
 #include <muduo/net/Acceptor.h>
+#include <muduo/base/Logging.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/InetAddress.h>
 #include <muduo/net/SocketsOps.h>
@@ -10,16 +11,21 @@
 using namespace muduo;
 using namespace muduo::net;
 
-Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr)
+Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusePort)
     : loop_(loop),
       acceptSocket_(sockets::createNonblockingOrDie()),
       acceptChannel_(loop, acceptSocket_.fd()),
+      maxAcceptsPerWakeup_(kDefaultMaxAcceptsPerWakeup),
       listenning_(false),
       idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
 {
     assert(idleFd_ >= 0);
 
     acceptSocket_.setReuseAddr(true);
+    if (reusePort && !acceptSocket_.setReusePort(true))
+    {
+        LOG_SYSERR << "Acceptor::Acceptor setReusePort";
+    }
     acceptSocket_.bindAddress(listenAddr);
 
     acceptChannel_.setReadCallback(boost::bind(&Acceptor::handleRead, this));
@@ -42,37 +48,51 @@ void Acceptor::listen()
     acceptChannel_.enableReading();
 }
 
-// (1) 调用 accept 来接受新连接
-// (2) 调用用户回调 newConnectionCallback_
+// (1) 调用 accept 来接受新连接, 一直到EAGAIN或者maxAcceptsPerWakeup_个
+// (2) 调用用户回调 newConnectionsCallback_/newConnectionCallback_
 void Acceptor::handleRead()
 {
     loop_->assertInLoopThread();
 
-    InetAddress peerAddr(0);
-
     // 这里直接把cfd传递给cb, 不够好. 优化思路: 可以先创建Socket对象, 再用move把Socket给cb, 确保资源的安全释放.
-    // 这里没有考虑fd消耗完的情况.
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0)
+    accepted_.clear();
+    while (static_cast<int>(accepted_.size()) < maxAcceptsPerWakeup_)
     {
-        if (newConnectionCallback_)
+        InetAddress peerAddr(0);
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd < 0)
         {
-            newConnectionCallback_(connfd, peerAddr);
-        }
-        else
-        {
-            sockets::close(connfd);
+            // 当服务器fd不够用了, 此时客户端发起连接, 对于客户端来说, 是会被立刻关闭连接, 而不是卡着等待服务器.
+            if (errno == EMFILE) // fd不够用了
+            {
+                ::close(idleFd_);
+                idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
+                ::close(idleFd_);
+                idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            }
+            break;
         }
+        accepted_.push_back(std::make_pair(connfd, peerAddr));
+    }
+
+    if (accepted_.empty())
+    {
+        return;
+    }
+    if (newConnectionsCallback_)
+    {
+        newConnectionsCallback_(accepted_);
+        return;
     }
-    else
+    for (size_t i = 0; i < accepted_.size(); ++i)
     {
-        // 当服务器fd不够用了, 此时客户端发起连接, 对于客户端来说, 是会被立刻关闭连接, 而不是卡着等待服务器.
-        if (errno == EMFILE) // fd不够用了
+        if (newConnectionCallback_)
+        {
+            newConnectionCallback_(accepted_[i].first, accepted_[i].second);
+        }
+        else
         {
-            ::close(idleFd_);
-            idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
-            ::close(idleFd_);
-            idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            sockets::close(accepted_[i].first);
         }
     }
 }
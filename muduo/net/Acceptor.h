@@ -2,17 +2,20 @@
 #define MUDUO_NET_ACCEPTOR_H
 
 #include <muduo/net/Channel.h>
+#include <muduo/net/InetAddress.h>
 #include <muduo/net/Socket.h>
 
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 
+#include <utility>
+#include <vector>
+
 namespace muduo
 {
     namespace net
     {
         class EventLoop;
-        class InetAddress;
 
         // 内部类, 作为TcpServer的成员, 生命周期由TcpServer管理.
         class Acceptor : boost::noncopyable
@@ -20,7 +23,14 @@ namespace muduo
         public:
             typedef boost::function<void(int sockfd, const InetAddress &)> NewConnectionCallback;
 
-            Acceptor(EventLoop *loop, const InetAddress &listenAddr);
+            // 一次可读事件中accept到的所有连接, first: cfd, second: 客户端的地址
+            typedef std::vector<std::pair<int, InetAddress> > AcceptedList;
+            typedef boost::function<void(const AcceptedList &)> NewConnectionsCallback;
+
+            static const int kDefaultMaxAcceptsPerWakeup = 64;
+
+            // reusePort: 开启SO_REUSEPORT, 多个Acceptor(比如每个IO线程一个)可以监听同一个地址, 见TcpServer::setAcceptPerLoop().
+            Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusePort = false);
             ~Acceptor();
 
             void setNewConnectionCallback(const NewConnectionCallback &cb)
@@ -28,6 +38,21 @@ namespace muduo
                 newConnectionCallback_ = cb;
             }
 
+            // 设置之后一次可读事件accept到的连接一起交给cb, 不再逐个调用NewConnectionCallback
+            void setNewConnectionsCallback(const NewConnectionsCallback &cb)
+            {
+                newConnectionsCallback_ = cb;
+            }
+
+            // 每次可读事件一直accept到EAGAIN, 最多n个, 剩下的等下一次事件(水平触发), 免得连接风暴时饿死同一个loop上的连接.
+            // 1表示每次只accept一个.
+            void setMaxAcceptsPerWakeup(int n)
+            {
+                assert(n > 0);
+                maxAcceptsPerWakeup_ = n;
+            }
+
+            EventLoop *loop() const { return loop_; }
             bool listenning() const { return listenning_; }
             void listen();
 
@@ -40,6 +65,9 @@ namespace muduo
             // 在构造函数Acceptor()中set cb, 在listen()中enable cb.
 
             NewConnectionCallback newConnectionCallback_; // 在TcpServer::TcpServer()中设置
+            NewConnectionsCallback newConnectionsCallback_;
+            int maxAcceptsPerWakeup_;
+            AcceptedList accepted_; // 本次事件accept到的连接, 重复使用
             bool listenning_;
             int idleFd_; // 故意占用一个fd.
         };
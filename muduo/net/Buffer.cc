@@ -1,7 +1,9 @@
 #include <muduo/net/Buffer.h>
+#include <muduo/net/BufferPool.h>
 #include <muduo/net/SocketsOps.h>
 
 #include <errno.h>
+#include <limits.h>
 #include <sys/uio.h>
 
 using namespace muduo;
@@ -11,35 +13,135 @@ const char Buffer::kCRLF[] = "\r\n";
 
 const size_t Buffer::kCheapPrepend;
 const size_t Buffer::kInitialSize;
+const size_t Buffer::kDefaultSlabSize;
+const size_t Buffer::kSpillSize;
 
-// 结合栈上的空间, 避免内存使用过大, 提高内存使用率.
+namespace
+{
+    // readFd()的溢出区, 每个线程一份, 不用每次调用都在栈上开64K.
+    __thread char t_spillArea[Buffer::kSpillSize];
+} // namespace
+
+Buffer::Buffer(BufferPool *pool)
+    : buffer_(pool ? 0 : kCheapPrepend + kInitialSize),
+      readerIndex_(kCheapPrepend),
+      writerIndex_(kCheapPrepend),
+      slabSize_(pool ? pool->chunkSize() : 0),
+      chainBytes_(0),
+      pool_(pool)
+{
+    assert(pool == NULL || pool->chunkSize() > kCheapPrepend);
+}
+
+Buffer::Buffer(const Buffer &rhs)
+    : buffer_(rhs.buffer_),
+      readerIndex_(rhs.readerIndex_),
+      writerIndex_(rhs.writerIndex_),
+      slabs_(rhs.slabs_),
+      slabSize_(rhs.slabSize_),
+      chainBytes_(rhs.chainBytes_),
+      pool_(NULL)
+{
+}
+
+Buffer &Buffer::operator=(const Buffer &rhs)
+{
+    if (this != &rhs)
+    {
+        Buffer tmp(rhs);
+        clearSlabs(); // 先把借用的chunk还回去
+        pool_ = NULL;
+        swap(tmp);
+    }
+    return *this;
+}
+
+Buffer::~Buffer()
+{
+    clearSlabs(); // 池化模式下把借用的chunk还给pool
+}
+
+void Buffer::detachPool()
+{
+    if (pool_ == NULL)
+    {
+        return;
+    }
+
+    BufferPool *pool = pool_;
+    pool_ = NULL;
+    std::deque<Slab> old;
+    old.swap(slabs_);
+    chainBytes_ = 0;
+
+    for (std::deque<Slab>::iterator it = old.begin(); it != old.end(); ++it)
+    {
+        appendSegments(it->peek(), it->readableBytes());
+        if (it->data.size() == pool->chunkSize())
+        {
+            pool->put(&it->data);
+        }
+    }
+}
+
+// 结合线程的溢出区, 避免内存使用过大, 提高内存使用率.
 // 如果有5k个连接, 每个连接就分配64K+64K的缓冲区的话, 将占用640M内存, 而大多数时候, 这些缓冲区的使用率很低.
-ssize_t Buffer::readFd(int fd, int *savedErrno)
+// hint是希望直接读进缓冲区的字节数, 读进溢出区的部分还要再拷贝一次, 由调用者根据连接最近的流量来估计.
+ssize_t Buffer::readFd(int fd, int *savedErrno, size_t hint, size_t maxBytes)
 {
-    char extrabuf[65536]; // 64K: 千兆网卡在500us之内全速受到的数据量: 1000Mbit/s / 8 * 0.001 * 0.5 = 62.5KB, 64K足够容纳.
+    char *extrabuf = t_spillArea; // 64K: 千兆网卡在500us之内全速受到的数据量: 1000Mbit/s / 8 * 0.001 * 0.5 = 62.5KB, 64K足够容纳.
     struct iovec vec[2];
-    const size_t writable = writableBytes();
+
+    if (segmented())
+    {
+        // 分段模式: 最后一个slab放不下就追加一个新的, 直接读进slab, 不需要移动已有数据.
+        hint = std::min(hint, slabSize_ - kCheapPrepend);
+        if (writableBytes() == 0 || writableBytes() < hint)
+        {
+            addSlab(hint);
+        }
+    }
+    else if (writableBytes() < hint)
+    {
+        ensureWritableBytes(hint);
+    }
+    size_t writable = writableBytes();
+    size_t spill = kSpillSize;
+    if (maxBytes > 0)
+    {
+        writable = std::min(writable, maxBytes);
+        spill = std::min(spill, maxBytes - writable);
+    }
     
     // 第一块缓冲区
-    vec[0].iov_base = begin() + writerIndex_;
+    vec[0].iov_base = beginWrite();
     vec[0].iov_len = writable;
     
     // 第二块缓冲区
     vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof(extrabuf);
+    vec[1].iov_len = spill;
 
-    const ssize_t n = sockets::readv(fd, vec, 2);
+    const ssize_t n = sockets::readv(fd, vec, spill > 0 ? 2 : 1);
     if (n < 0)
     {
         *savedErrno = errno;
     }
+    if (n <= 0)
+    {
+        // 池化模式下, 没读到数据(EAGAIN/EOF)时把上面借来的空slab还回去, 空闲连接不占用chunk
+        if (pool_ && !slabs_.empty() && slabs_.back().readableBytes() == 0)
+        {
+            releaseSlab(slabs_.back());
+            slabs_.pop_back();
+        }
+    }
     else if (implicit_cast<size_t>(n) <= writable) //第一块缓冲区足够容纳
     {
-        writerIndex_ += n;
+        hasWritten(n);
     }
     else // 当前缓冲区不够容纳, 因而数据被接收到了第二块缓冲区extrabuf, 将其append至buffer
     {
-        writerIndex_ = buffer_.size();
+        hasWritten(writable);
         append(extrabuf, n - writable);
     }
 
@@ -50,3 +152,266 @@ ssize_t Buffer::readFd(int fd, int *savedErrno)
 
     return n;
 }
+
+ssize_t Buffer::writeFd(int fd, int *savedErrno)
+{
+    struct iovec vec[IOV_MAX];
+    int cnt = readableIovecs(0, readableBytes(), vec, IOV_MAX);
+
+    const ssize_t n = cnt == 1 ? sockets::write(fd, vec[0].iov_base, vec[0].iov_len)
+                               : sockets::writev(fd, vec, cnt);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    else
+    {
+        retrieve(n);
+    }
+    return n;
+}
+
+int Buffer::readableIovecs(size_t offset, size_t len, struct iovec *iov, int maxIov) const
+{
+    assert(offset + len <= readableBytes());
+    assert(maxIov > 0);
+
+    if (!segmented())
+    {
+        iov[0].iov_base = const_cast<char *>(peek() + offset);
+        iov[0].iov_len = len;
+        return 1;
+    }
+
+    int cnt = 0;
+    for (std::deque<Slab>::const_iterator it = slabs_.begin();
+         it != slabs_.end() && len > 0 && cnt < maxIov; ++it)
+    {
+        size_t readable = it->readableBytes();
+        if (offset >= readable) // 跳过offset之前的slab
+        {
+            offset -= readable;
+            continue;
+        }
+        size_t n = std::min(readable - offset, len);
+        iov[cnt].iov_base = const_cast<char *>(it->peek() + offset);
+        iov[cnt].iov_len = n;
+        ++cnt;
+        len -= n;
+        offset = 0;
+    }
+    return cnt;
+}
+
+size_t Buffer::internalCapacity() const
+{
+    if (!segmented())
+    {
+        return buffer_.capacity();
+    }
+
+    size_t capacity = 0;
+    for (std::deque<Slab>::const_iterator it = slabs_.begin(); it != slabs_.end(); ++it)
+    {
+        capacity += it->data.capacity();
+    }
+    return capacity;
+}
+
+void Buffer::enableSegments(size_t slabSize)
+{
+    assert(slabSize > kCheapPrepend);
+    if (segmented())
+    {
+        return;
+    }
+
+    // 已有数据搬到第一个slab, 然后释放buffer_
+    Buffer old;
+    old.swap(*this);
+    slabSize_ = slabSize;
+    std::vector<char>().swap(buffer_);
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend;
+
+    addSlab(old.readableBytes());
+    append(old.peek(), old.readableBytes());
+}
+
+// 合并出连续视图: 只有一个slab有数据时直接返回, 否则把所有数据拷贝到一个足够大的slab中.
+const char *Buffer::peekSegments() const
+{
+    if (slabs_.empty())
+    {
+        return NULL;
+    }
+    if (slabs_.front().readableBytes() == chainBytes_)
+    {
+        return slabs_.front().peek();
+    }
+
+    mergeInto(std::max(slabSize_, kCheapPrepend + chainBytes_));
+    return slabs_.front().peek();
+}
+
+// 把所有数据拷贝到一个大小为size的新slab中, 用它替换整个链.
+void Buffer::mergeInto(size_t size) const
+{
+    assert(size >= kCheapPrepend + chainBytes_);
+    Slab merged = newSlab(size, kCheapPrepend);
+    copyOut(merged.beginWrite(), chainBytes_);
+    merged.writerIndex += chainBytes_;
+
+    clearSlabs();
+    slabs_.push_back(Slab(0, 0));
+    slabs_.back().data.swap(merged.data); // 避免再拷贝一次
+    slabs_.back().readerIndex = merged.readerIndex;
+    slabs_.back().writerIndex = merged.writerIndex;
+}
+
+void Buffer::retrieveSegments(size_t len)
+{
+    assert(len <= chainBytes_);
+    chainBytes_ -= len;
+
+    while (!slabs_.empty())
+    {
+        Slab &head = slabs_.front();
+        size_t readable = head.readableBytes();
+        if (len < readable)
+        {
+            head.readerIndex += len;
+            len = 0;
+            break;
+        }
+
+        len -= readable;
+        if (slabs_.size() == 1 && pool_ == NULL) // 数据取完了, 留下最后一个slab复用, 同retrieveAll()
+        {
+            head.readerIndex = kCheapPrepend;
+            head.writerIndex = kCheapPrepend;
+            break;
+        }
+        releaseSlab(head); // 已经读完的slab直接释放, 池化模式下连最后一个也还给pool
+        slabs_.pop_front();
+    }
+    assert(len == 0);
+}
+
+void Buffer::appendSegments(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        if (writableBytes() == 0)
+        {
+            addSlab(0);
+        }
+        size_t n = std::min(len, writableBytes());
+        std::copy(data, data + n, slabs_.back().beginWrite());
+        slabs_.back().writerIndex += n;
+        chainBytes_ += n;
+        data += n;
+        len -= n;
+    }
+}
+
+// 在尾部追加一个slab, 保证至少有minWritable字节的可写空间, 一般就是slabSize_.
+void Buffer::addSlab(size_t minWritable)
+{
+    assert(segmented());
+
+    // 缓冲区是空的, 最后一个slab可以直接复用
+    if (chainBytes_ == 0 && !slabs_.empty())
+    {
+        while (slabs_.size() > 1)
+        {
+            releaseSlab(slabs_.front());
+            slabs_.pop_front();
+        }
+        Slab &tail = slabs_.back();
+        tail.readerIndex = kCheapPrepend;
+        tail.writerIndex = kCheapPrepend;
+        if (tail.writableBytes() >= minWritable && tail.writableBytes() > 0)
+        {
+            return;
+        }
+        clearSlabs();
+    }
+
+    // 尾部slab没有可读数据(写满之前被取走了), 直接丢掉, 免得留下空洞.
+    if (!slabs_.empty() && slabs_.back().readableBytes() == 0)
+    {
+        releaseSlab(slabs_.back());
+        slabs_.pop_back();
+    }
+
+    size_t prepend = slabs_.empty() ? kCheapPrepend : 0;
+    slabs_.push_back(newSlab(std::max(slabSize_, prepend + minWritable), prepend));
+}
+
+// 池化模式下, 不超过chunk大小的slab从pool_借用, 更大的直接分配.
+Buffer::Slab Buffer::newSlab(size_t size, size_t prepend) const
+{
+    Slab slab(0, prepend);
+    if (pool_ && size <= pool_->chunkSize())
+    {
+        pool_->get(&slab.data);
+    }
+    else
+    {
+        slab.data.resize(size);
+    }
+    return slab;
+}
+
+void Buffer::releaseSlab(Slab &slab) const
+{
+    if (pool_ && slab.data.size() == pool_->chunkSize())
+    {
+        pool_->put(&slab.data);
+    }
+}
+
+void Buffer::clearSlabs() const
+{
+    for (std::deque<Slab>::iterator it = slabs_.begin(); it != slabs_.end(); ++it)
+    {
+        releaseSlab(*it);
+    }
+    slabs_.clear();
+}
+
+void Buffer::shrinkSegments(size_t reserve)
+{
+    if (chainBytes_ > 0)
+    {
+        mergeInto(kCheapPrepend + chainBytes_ + reserve); // 合并到一个刚好够用的slab中
+    }
+    else
+    {
+        clearSlabs();
+        if (reserve > 0)
+        {
+            addSlab(reserve);
+        }
+    }
+}
+
+void Buffer::copyOut(void *dst, size_t len) const
+{
+    assert(len <= readableBytes());
+    if (!segmented())
+    {
+        ::memcpy(dst, peek(), len);
+        return;
+    }
+
+    char *d = static_cast<char *>(dst);
+    for (std::deque<Slab>::const_iterator it = slabs_.begin(); it != slabs_.end() && len > 0; ++it)
+    {
+        size_t n = std::min(len, it->readableBytes());
+        ::memcpy(d, it->peek(), n);
+        d += n;
+        len -= n;
+    }
+}
@@ -4,18 +4,24 @@
 #include <muduo/base/copyable.h>
 #include <muduo/base/StringPiece.h>
 #include <muduo/base/Types.h>
+#include <muduo/net/ByteScan.h>
 #include <muduo/net/Endian.h>
 
 #include <algorithm>
+#include <deque>
 #include <vector>
 
 #include <assert.h>
 #include <string.h>
 
+struct iovec;
+
 namespace muduo
 {
     namespace net
     {
+        class BufferPool;
+
         // 非阻塞网络编成必须在用户态接受缓冲的主要原因: 对方一次发送的数据不够读取的, 需要后续数据到达.
         // 
         /// A buffer class modeled after org.jboss.netty.buffer.ChannelBuffer
@@ -28,64 +34,145 @@ namespace muduo
         // / |                   |                  |                  |
         // / 0      <=      readerIndex   <=   writerIndex    <=     size
         /// @endcode
+        ///
+        /// 分段模式(enableSegments()): 数据保存在一串固定大小的slab中,
+        /// 增长时只追加新的slab, 已缓存的数据不会被realloc/memmove.
+        /// peek()等需要连续内存的接口在数据跨越多个slab时, 会把数据合并到一个slab中(连续视图).
+        /// 池化模式(Buffer(BufferPool*)): 分段模式的slab从BufferPool借用, 数据被取空时归还,
+        /// 构造时不分配内存.
         class Buffer : public muduo::copyable
         {
         public:
             static const size_t kCheapPrepend = 8;
             static const size_t kInitialSize = 1024;
+            static const size_t kDefaultSlabSize = 64 * 1024;
+            static const size_t kSpillSize = 64 * 1024; // readFd()溢出区的大小
 
             Buffer()
                 : buffer_(kCheapPrepend + kInitialSize),
                   readerIndex_(kCheapPrepend),
-                  writerIndex_(kCheapPrepend)
+                  writerIndex_(kCheapPrepend),
+                  slabSize_(0),
+                  chainBytes_(0),
+                  pool_(NULL)
             {
                 assert(readableBytes() == 0);
                 assert(writableBytes() == kInitialSize);
                 assert(prependableBytes() == kCheapPrepend);
             }
 
-            // default copy-ctor, dtor and assignment are fine
+            // 池化模式, pool为NULL时等同于Buffer().
+            // 池化的Buffer只能在pool所属的IO线程中使用(包括析构), 析构时借用的chunk自动归还.
+            explicit Buffer(BufferPool *pool);
+
+            // 拷贝得到的Buffer不属于任何pool.
+            Buffer(const Buffer &rhs);
+            Buffer &operator=(const Buffer &rhs);
+            ~Buffer();
+
+            // 不再使用pool: 已借用的chunk归还给pool, 可读数据搬到普通的slab中.
+            void detachPool();
+
+            BufferPool *pool() const { return pool_; }
 
             void swap(Buffer &rhs)
             {
                 buffer_.swap(rhs.buffer_);
                 std::swap(readerIndex_, rhs.readerIndex_);
                 std::swap(writerIndex_, rhs.writerIndex_);
+                slabs_.swap(rhs.slabs_);
+                std::swap(slabSize_, rhs.slabSize_);
+                std::swap(chainBytes_, rhs.chainBytes_);
+                std::swap(pool_, rhs.pool_);
             }
 
+            // 切换到分段模式, 已有的可读数据会被搬到第一个slab中. 切换之后不能再切回连续模式.
+            void enableSegments(size_t slabSize = kDefaultSlabSize);
+
+            bool segmented() const { return slabSize_ > 0; }
+
+            // 分段模式下的slab数量, 连续模式下总是1.
+            size_t numSegments() const { return segmented() ? slabs_.size() : 1; }
+
             size_t readableBytes() const
             {
-                return writerIndex_ - readerIndex_;
+                return segmented() ? chainBytes_ : writerIndex_ - readerIndex_;
             }
 
+            // 分段模式下指的是最后一个slab的可写空间
             size_t writableBytes() const
             {
+                if (segmented())
+                {
+                    return slabs_.empty() ? 0 : slabs_.back().writableBytes();
+                }
                 return buffer_.size() - writerIndex_;
             }
 
             size_t prependableBytes() const
             {
+                if (segmented())
+                {
+                    return slabs_.empty() ? 0 : slabs_.front().readerIndex;
+                }
                 return readerIndex_;
             }
 
+            // 分段模式下, 如果数据跨越了多个slab, 会先合并成连续内存再返回.
             const char *peek() const
             {
+                if (segmented())
+                {
+                    return peekSegments();
+                }
                 return begin() + readerIndex_;
             }
 
+            // 查找分隔符, 找不到返回NULL. 使用ByteScan中的SIMD实现.
+            // 注意先调用peek(), 分段模式下合并之后再计算结尾.
+
             const char *findCRLF() const
             {
-                const char *crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF + 2);
-                return crlf == beginWrite() ? NULL : crlf;
+                const char *begin = peek();
+                return scan::findCRLF(begin, begin + readableBytes());
             }
 
             const char *findCRLF(const char *start) const
             {
-                assert(peek() <= start);
-                assert(start <= beginWrite());
+                const char *begin = peek();
+                assert(begin <= start);
+                assert(start <= begin + readableBytes());
+                return scan::findCRLF(start, begin + readableBytes());
+            }
+
+            // 查找'\n'
+            const char *findEOL() const
+            {
+                const char *begin = peek();
+                return scan::findEOL(begin, begin + readableBytes());
+            }
 
-                const char *crlf = std::search(start, beginWrite(), kCRLF, kCRLF + 2);
-                return crlf == beginWrite() ? NULL : crlf;
+            const char *findEOL(const char *start) const
+            {
+                const char *begin = peek();
+                assert(begin <= start);
+                assert(start <= begin + readableBytes());
+                return scan::findEOL(start, begin + readableBytes());
+            }
+
+            // 查找chars[0, n)中任意一个字节, n <= scan::kMaxAnyChars
+            const char *findAny(const char *chars, size_t n) const
+            {
+                const char *begin = peek();
+                return scan::findAny(begin, begin + readableBytes(), chars, n);
+            }
+
+            const char *findAny(const char *start, const char *chars, size_t n) const
+            {
+                const char *begin = peek();
+                assert(begin <= start);
+                assert(start <= begin + readableBytes());
+                return scan::findAny(start, begin + readableBytes(), chars, n);
             }
 
             // retrieve returns void, to prevent string str(retrieve(readableBytes()), readableBytes());
@@ -94,7 +181,11 @@ namespace muduo
             {
                 assert(len <= readableBytes());
 
-                if (len < readableBytes())
+                if (segmented())
+                {
+                    retrieveSegments(len);
+                }
+                else if (len < readableBytes())
                 {
                     readerIndex_ += len;
                 }
@@ -104,12 +195,14 @@ namespace muduo
                 }
             }
 
+            // 分段模式下beginWrite()是最后一个slab的, 可能是readFd()留下的空slab, 所以用peek() + readableBytes()检查
             void retrieveUntil(const char *end)
             {
-                assert(peek() <= end);
-                assert(end <= beginWrite());
+                const char *begin = peek();
+                assert(begin <= end);
+                assert(end <= begin + readableBytes());
 
-                retrieve(end - peek());
+                retrieve(end - begin);
             }
 
             void retrieveInt32()
@@ -129,6 +222,11 @@ namespace muduo
 
             void retrieveAll()
             {
+                if (segmented())
+                {
+                    retrieveSegments(chainBytes_);
+                    return;
+                }
                 readerIndex_ = kCheapPrepend;
                 writerIndex_ = kCheapPrepend;
             }
@@ -142,7 +240,16 @@ namespace muduo
             {
                 assert(len <= readableBytes());
 
-                string result(peek(), len);
+                string result;
+                if (segmented())
+                {
+                    result.resize(len);
+                    copyOut(&*result.begin(), len); // 直接从各个slab拷贝, 不需要先合并.
+                }
+                else
+                {
+                    result.assign(peek(), len);
+                }
                 retrieve(len);
                 return result;
             }
@@ -159,6 +266,11 @@ namespace muduo
 
             void append(const char * /*restrict*/ data, size_t len)
             {
+                if (segmented())
+                {
+                    appendSegments(data, len);
+                    return;
+                }
                 ensureWritableBytes(len);
                 std::copy(data, data + len, beginWrite());
                 hasWritten(len);
@@ -170,27 +282,50 @@ namespace muduo
             }
 
             // 确保缓冲区可写空间>=len，如果不足则扩充
+            // 分段模式下不足时追加一个新的slab, 已有数据不会移动.
             void ensureWritableBytes(size_t len)
             {
                 if (writableBytes() < len)
                 {
-                    makeSpace(len);
+                    if (segmented())
+                    {
+                        addSlab(len);
+                    }
+                    else
+                    {
+                        makeSpace(len);
+                    }
                 }
                 assert(writableBytes() >= len);
             }
 
             char *beginWrite()
             {
+                if (segmented())
+                {
+                    return slabs_.empty() ? NULL : slabs_.back().beginWrite();
+                }
                 return begin() + writerIndex_;
             }
 
             const char *beginWrite() const
             {
+                if (segmented())
+                {
+                    return slabs_.empty() ? NULL : slabs_.back().beginWrite();
+                }
                 return begin() + writerIndex_;
             }
 
             void hasWritten(size_t len)
             {
+                if (segmented())
+                {
+                    assert(len <= writableBytes());
+                    slabs_.back().writerIndex += len;
+                    chainBytes_ += len;
+                    return;
+                }
                 writerIndex_ += len;
             }
 
@@ -247,7 +382,7 @@ namespace muduo
             {
                 assert(readableBytes() >= sizeof(int32_t));
                 int32_t be32 = 0;
-                ::memcpy(&be32, peek(), sizeof be32);
+                copyOut(&be32, sizeof be32);
                 return sockets::networkToHost32(be32);
             }
 
@@ -255,7 +390,7 @@ namespace muduo
             {
                 assert(readableBytes() >= sizeof(int16_t));
                 int16_t be16 = 0;
-                ::memcpy(&be16, peek(), sizeof be16);
+                copyOut(&be16, sizeof be16);
                 return sockets::networkToHost16(be16);
             }
 
@@ -289,7 +424,17 @@ namespace muduo
             void prepend(const void * /*restrict*/ data, size_t len)
             {
                 assert(len <= prependableBytes());
-                
+
+                if (segmented())
+                {
+                    Slab &head = slabs_.front();
+                    head.readerIndex -= len;
+                    chainBytes_ += len;
+                    const char *d = static_cast<const char *>(data);
+                    std::copy(d, d + len, head.begin() + head.readerIndex);
+                    return;
+                }
+
                 readerIndex_ -= len;
                 const char *d = static_cast<const char *>(data);
                 std::copy(d, d + len, begin() + readerIndex_);
@@ -298,6 +443,11 @@ namespace muduo
             // 收缩, 保留reserve个字节
             void shrink(size_t reserve)
             {
+                if (segmented())
+                {
+                    shrinkSegments(reserve);
+                    return;
+                }
                 // FIXME: use vector::shrink_to_fit() in C++ 11 if possible.
                 Buffer other;
                 other.ensureWritableBytes(readableBytes() + reserve);
@@ -305,13 +455,61 @@ namespace muduo
                 swap(other);
             }
 
+            // 当前占用的内存大小(分段模式下是所有slab之和)
+            size_t internalCapacity() const;
+
             /// Read data directly into buffer.
             ///
             /// It may implement with readv(2)
+            /// @param hint 先保证有这么多可写空间, 超出部分读进每个线程的溢出区再append.
+            /// @param maxBytes 最多读这么多字节, 0表示不限制.
             /// @return result of read(2), @c errno is saved
-            ssize_t readFd(int fd, int *savedErrno);
+            ssize_t readFd(int fd, int *savedErrno, size_t hint = 0, size_t maxBytes = 0);
+
+            /// Write readable data to fd with writev(2), and retrieve what has been written.
+            /// @return result of writev(2), @c errno is saved
+            ssize_t writeFd(int fd, int *savedErrno);
+
+            // 把可读数据中[offset, offset + len)这一段描述为iovec, 最多填充maxIov个, 返回实际使用的个数.
+            // 分段模式下每个slab对应一个iovec, 不会合并数据.
+            int readableIovecs(size_t offset, size_t len, struct iovec *iov, int maxIov) const;
 
         private:
+            // 分段模式下的一个slab, 布局和连续模式下的buffer_相同.
+            struct Slab
+            {
+                std::vector<char> data;
+                size_t readerIndex;
+                size_t writerIndex;
+
+                explicit Slab(size_t size, size_t prepend)
+                    : data(size),
+                      readerIndex(prepend),
+                      writerIndex(prepend)
+                {
+                }
+
+                char *begin() { return &*data.begin(); }
+                const char *begin() const { return &*data.begin(); }
+                char *beginWrite() { return begin() + writerIndex; }
+                const char *beginWrite() const { return begin() + writerIndex; }
+                const char *peek() const { return begin() + readerIndex; }
+                size_t readableBytes() const { return writerIndex - readerIndex; }
+                size_t writableBytes() const { return data.size() - writerIndex; }
+            };
+
+            Slab newSlab(size_t size, size_t prepend) const;
+            void releaseSlab(Slab &slab) const; // 把slab的内存还给pool_(如果是从pool_借来的)
+            void clearSlabs() const;
+
+            const char *peekSegments() const;
+            void retrieveSegments(size_t len);
+            void appendSegments(const char *data, size_t len);
+            void addSlab(size_t minWritable);
+            void shrinkSegments(size_t reserve);
+            void mergeInto(size_t size) const;
+            void copyOut(void *dst, size_t len) const; // 从头部拷贝len个字节到dst, 不取走数据.
+
             char *begin()
             {
                 return &*buffer_.begin();
@@ -349,6 +547,13 @@ namespace muduo
             size_t readerIndex_;       // 读位置
             size_t writerIndex_;       // 写位置
 
+            // 分段模式, 此时buffer_不再使用.
+            // slabs_是mutable的, 因为peek()可能需要合并数据, 但可读内容不变.
+            mutable std::deque<Slab> slabs_;
+            size_t slabSize_;   // slab大小, 0表示连续模式
+            size_t chainBytes_; // 所有slab中可读数据之和
+            BufferPool *pool_;  // 池化模式下slab的来源, 不拥有
+
             static const char kCRLF[];
         };
 
@@ -0,0 +1,70 @@
+#include <muduo/net/BufferPool.h>
+
+#include <assert.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t BufferPool::kDefaultChunkSize;
+
+BufferPool::BufferPool(size_t chunkSize)
+    : chunkSize_(chunkSize),
+      lowFree_(0),
+      hits_(0),
+      misses_(0),
+      reclaimed_(0),
+      inUse_(0),
+      highWater_(0)
+{
+    assert(chunkSize_ > 0);
+}
+
+BufferPool::~BufferPool()
+{
+}
+
+void BufferPool::get(std::vector<char> *chunk)
+{
+    if (freeList_.empty())
+    {
+        ++misses_;
+        std::vector<char>(chunkSize_).swap(*chunk);
+    }
+    else
+    {
+        ++hits_;
+        chunk->swap(freeList_.back());
+        freeList_.pop_back();
+        if (freeList_.size() < lowFree_)
+        {
+            lowFree_ = freeList_.size();
+        }
+    }
+    assert(chunk->size() == chunkSize_);
+
+    ++inUse_;
+    if (inUse_ > highWater_)
+    {
+        highWater_ = inUse_;
+    }
+}
+
+void BufferPool::put(std::vector<char> *chunk)
+{
+    assert(chunk->size() == chunkSize_);
+    assert(inUse_ > 0);
+    --inUse_;
+
+    freeList_.push_back(std::vector<char>());
+    freeList_.back().swap(*chunk);
+}
+
+void BufferPool::trim()
+{
+    // 最近一个周期内都没有被借出过的chunk, 说明负载已经下降, 释放掉. 剩下的留给突发流量.
+    size_t n = lowFree_;
+    assert(n <= freeList_.size());
+    freeList_.resize(freeList_.size() - n);
+    reclaimed_ += static_cast<int64_t>(n);
+    lowFree_ = freeList_.size();
+}
@@ -0,0 +1,63 @@
+#ifndef MUDUO_NET_BUFFERPOOL_H
+#define MUDUO_NET_BUFFERPOOL_H
+
+#include <muduo/base/Types.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <vector>
+
+namespace muduo
+{
+    namespace net
+    {
+        // 固定大小内存块(chunk)的池子, 每个EventLoop一个, 给分段模式的Buffer借用slab.
+        // Buffer中的数据被取空时, 就把chunk还回池子, 所以空闲的连接不占用缓冲区内存.
+        // 只能在所属的IO线程中使用, 不是线程安全的.
+        class BufferPool : boost::noncopyable
+        {
+        public:
+            static const size_t kDefaultChunkSize = 16 * 1024;
+
+            explicit BufferPool(size_t chunkSize = kDefaultChunkSize);
+            ~BufferPool();
+
+            size_t chunkSize() const { return chunkSize_; }
+
+            // 借出一个chunk, 和*chunk交换, 调用之后chunk->size() == chunkSize().
+            void get(std::vector<char> *chunk);
+
+            // 归还一个由get()借出的chunk, 调用之后*chunk为空.
+            void put(std::vector<char> *chunk);
+
+            // 回收空闲内存: 释放自上次trim()以来一直没有被借出的chunk. 由EventLoop定时调用.
+            void trim();
+
+            // 统计信息
+
+            int64_t hits() const { return hits_; }         // get()时池子里有空闲chunk的次数
+            int64_t misses() const { return misses_; }     // get()时需要新分配chunk的次数
+            int64_t reclaimed() const { return reclaimed_; } // trim()释放的chunk总数
+            size_t inUse() const { return inUse_; }         // 当前借出的chunk数量
+            size_t highWater() const { return highWater_; } // inUse()的历史最大值
+            size_t freeChunks() const { return freeList_.size(); }
+
+            // 当前池子占用的内存(借出的+空闲的)
+            size_t memoryBytes() const { return (inUse_ + freeList_.size()) * chunkSize_; }
+
+        private:
+            const size_t chunkSize_;
+            std::vector<std::vector<char> > freeList_;
+            size_t lowFree_; // 自上次trim()以来freeList_的最小长度, 这么多chunk在这段时间内没有被用到过.
+
+            int64_t hits_;
+            int64_t misses_;
+            int64_t reclaimed_;
+            size_t inUse_;
+            size_t highWater_;
+        };
+
+    } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_BUFFERPOOL_H
@@ -0,0 +1,259 @@
+#include <muduo/net/ByteScan.h>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MUDUO_SCAN_X86 1
+#endif
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+    // ---------
+    // 逐字节实现, 也用来处理SIMD剩下的尾巴
+    // ---------
+
+    const char *findByteGeneric(const char *begin, const char *end, char c)
+    {
+        if (begin == end)
+        {
+            return NULL;
+        }
+        return static_cast<const char *>(::memchr(begin, c, end - begin));
+    }
+
+    const char *findCRLFGeneric(const char *begin, const char *end)
+    {
+        for (const char *p = begin; p + 1 < end; ++p)
+        {
+            if (p[0] == '\r' && p[1] == '\n')
+            {
+                return p;
+            }
+        }
+        return NULL;
+    }
+
+    const char *findAnyGeneric(const char *begin, const char *end, const char *chars, size_t n)
+    {
+        const char *p = std::find_first_of(begin, end, chars, chars + n);
+        return p == end ? NULL : p;
+    }
+
+#if defined(MUDUO_SCAN_X86) && defined(__SSE2__)
+
+    // ---------
+    // SSE2, 一次16字节. x86_64上总是可用.
+    // ---------
+
+    inline __m128i load16(const char *p)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    }
+
+    inline const char *firstMatch(const char *p, int mask)
+    {
+        return p + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+
+    const char *findByteSse2(const char *begin, const char *end, char c)
+    {
+        const __m128i needle = _mm_set1_epi8(c);
+        const char *p = begin;
+        for (; p + 16 <= end; p += 16)
+        {
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(load16(p), needle));
+            if (mask)
+            {
+                return firstMatch(p, mask);
+            }
+        }
+        return findByteGeneric(p, end, c);
+    }
+
+    // 同时比较p和p+1开始的16个字节, 两个条件都满足的位置就是"\r\n"
+    const char *findCRLFSse2(const char *begin, const char *end)
+    {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        const char *p = begin;
+        for (; p + 17 <= end; p += 16)
+        {
+            __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(load16(p), cr),
+                                       _mm_cmpeq_epi8(load16(p + 1), lf));
+            int mask = _mm_movemask_epi8(eq);
+            if (mask)
+            {
+                return firstMatch(p, mask);
+            }
+        }
+        return findCRLFGeneric(p, end);
+    }
+
+    const char *findAnySse2(const char *begin, const char *end, const char *chars, size_t n)
+    {
+        __m128i needles[scan::kMaxAnyChars];
+        for (size_t i = 0; i < n; ++i)
+        {
+            needles[i] = _mm_set1_epi8(chars[i]);
+        }
+
+        const char *p = begin;
+        for (; p + 16 <= end; p += 16)
+        {
+            const __m128i v = load16(p);
+            __m128i eq = _mm_cmpeq_epi8(v, needles[0]);
+            for (size_t i = 1; i < n; ++i)
+            {
+                eq = _mm_or_si128(eq, _mm_cmpeq_epi8(v, needles[i]));
+            }
+            int mask = _mm_movemask_epi8(eq);
+            if (mask)
+            {
+                return firstMatch(p, mask);
+            }
+        }
+        return findAnyGeneric(p, end, chars, n);
+    }
+
+    // ---------
+    // AVX2, 一次32字节, 剩下不足32字节的交给SSE2.
+    // ---------
+
+    __attribute__((target("avx2"))) inline __m256i load32(const char *p)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+
+    __attribute__((target("avx2")))
+    const char *findByteAvx2(const char *begin, const char *end, char c)
+    {
+        const __m256i needle = _mm256_set1_epi8(c);
+        const char *p = begin;
+        for (; p + 32 <= end; p += 32)
+        {
+            int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(load32(p), needle));
+            if (mask)
+            {
+                return firstMatch(p, mask);
+            }
+        }
+        return findByteSse2(p, end, c);
+    }
+
+    __attribute__((target("avx2")))
+    const char *findCRLFAvx2(const char *begin, const char *end)
+    {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        const char *p = begin;
+        for (; p + 33 <= end; p += 32)
+        {
+            __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(load32(p), cr),
+                                          _mm256_cmpeq_epi8(load32(p + 1), lf));
+            int mask = _mm256_movemask_epi8(eq);
+            if (mask)
+            {
+                return firstMatch(p, mask);
+            }
+        }
+        return findCRLFSse2(p, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char *findAnyAvx2(const char *begin, const char *end, const char *chars, size_t n)
+    {
+        __m256i needles[scan::kMaxAnyChars];
+        for (size_t i = 0; i < n; ++i)
+        {
+            needles[i] = _mm256_set1_epi8(chars[i]);
+        }
+
+        const char *p = begin;
+        for (; p + 32 <= end; p += 32)
+        {
+            const __m256i v = load32(p);
+            __m256i eq = _mm256_cmpeq_epi8(v, needles[0]);
+            for (size_t i = 1; i < n; ++i)
+            {
+                eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(v, needles[i]));
+            }
+            int mask = _mm256_movemask_epi8(eq);
+            if (mask)
+            {
+                return firstMatch(p, mask);
+            }
+        }
+        return findAnySse2(p, end, chars, n);
+    }
+
+#endif
+
+    struct Kernels
+    {
+        const char *(*findByte)(const char *, const char *, char);
+        const char *(*findCRLF)(const char *, const char *);
+        const char *(*findAny)(const char *, const char *, const char *, size_t);
+        const char *name;
+    };
+
+    // 根据CPU选择一次
+    Kernels selectKernels()
+    {
+#if defined(MUDUO_SCAN_X86) && defined(__SSE2__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            Kernels k = {findByteAvx2, findCRLFAvx2, findAnyAvx2, "avx2"};
+            return k;
+        }
+        Kernels k = {findByteSse2, findCRLFSse2, findAnySse2, "sse2"};
+        return k;
+#else
+        Kernels k = {findByteGeneric, findCRLFGeneric, findAnyGeneric, "generic"};
+        return k;
+#endif
+    }
+
+    // 第一次使用时才选择, 其他翻译单元的静态对象在构造时调用也没有问题(static initialization order).
+    // 函数内的静态变量由编译器保证只初始化一次, 之后每次调用只是一次判断.
+    const Kernels &kernels()
+    {
+        static const Kernels k = selectKernels();
+        return k;
+    }
+} // namespace
+
+const char *scan::findByte(const char *begin, const char *end, char c)
+{
+    assert(begin <= end);
+    return kernels().findByte(begin, end, c);
+}
+
+const char *scan::findCRLF(const char *begin, const char *end)
+{
+    assert(begin <= end);
+    return kernels().findCRLF(begin, end);
+}
+
+const char *scan::findAny(const char *begin, const char *end, const char *chars, size_t n)
+{
+    assert(begin <= end);
+    assert(0 < n && n <= kMaxAnyChars);
+    if (n == 1)
+    {
+        return kernels().findByte(begin, end, chars[0]);
+    }
+    return kernels().findAny(begin, end, chars, n);
+}
+
+const char *scan::kernelName()
+{
+    return kernels().name;
+}
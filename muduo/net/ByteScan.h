@@ -0,0 +1,38 @@
+#ifndef MUDUO_NET_BYTESCAN_H
+#define MUDUO_NET_BYTESCAN_H
+
+#include <stddef.h>
+
+namespace muduo
+{
+    namespace net
+    {
+        // 在[begin, end)中查找分隔符, 找不到返回NULL.
+        // 运行时根据CPU选择AVX2/SSE2/逐字节的实现, 一次比较32/16个字节.
+        namespace scan
+        {
+            static const size_t kMaxAnyChars = 8;
+
+            // 第一个c
+            const char *findByte(const char *begin, const char *end, char c);
+
+            // 第一个"\r\n", 返回'\r'的位置
+            const char *findCRLF(const char *begin, const char *end);
+
+            // 第一个'\n'
+            inline const char *findEOL(const char *begin, const char *end)
+            {
+                return findByte(begin, end, '\n');
+            }
+
+            // 第一个属于chars[0, n)的字节, n <= kMaxAnyChars
+            const char *findAny(const char *begin, const char *end, const char *chars, size_t n);
+
+            // 当前使用的实现: "avx2", "sse2" 或 "generic"
+            const char *kernelName();
+
+        } // namespace scan
+    } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_BYTESCAN_H
@@ -37,6 +37,9 @@ namespace muduo
         typedef boost::function<void(const TcpConnectionPtr &)> WriteCompleteCallback;
         typedef boost::function<void(const TcpConnectionPtr &, size_t)> HighWaterMarkCallback;
 
+        // TcpConnection::send(const Slice&, cb)的数据不再被连接引用时回调, zeroCopied表示内核是否真的没有拷贝数据.
+        typedef boost::function<void(const TcpConnectionPtr &, bool zeroCopied)> SendCompleteCallback;
+
         // Timestamp: 是poll返回的时刻, 即消息到达的时刻, 注意和Channel::ReadEventCallback的参数区分.
         typedef boost::function<void(const TcpConnectionPtr &,
                                      Buffer *,
@@ -4,6 +4,7 @@
 
 #include <sstream>
 #include <poll.h>
+#include <sys/epoll.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -11,6 +12,8 @@ using namespace muduo::net;
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = POLLIN | POLLPRI; // POLLPRI: 紧急数据
 const int Channel::kWriteEvent = POLLOUT;
+const int Channel::kEdgeTriggered = static_cast<int>(EPOLLET);
+const int Channel::kExclusive = static_cast<int>(EPOLLEXCLUSIVE);
 
 Channel::Channel(EventLoop *loop, int fd__)
     : loop_(loop),
@@ -19,6 +22,11 @@ Channel::Channel(EventLoop *loop, int fd__)
       revents_(0),
       index_(-1),
       logHup_(true),
+      edgeTriggered_(false),
+      exclusive_(false),
+      writeArmed_(false),
+      registeredEvents_(-1),
+      receiving_(false),
       tied_(false),
       eventHandling_(false)
 {
@@ -35,9 +43,59 @@ void Channel::tie(const boost::shared_ptr<void> &obj)
     tied_ = true;
 }
 
+bool Channel::setEdgeTriggered(bool on)
+{
+    bool edgeTriggered = on && loop_->supportsEdgeTriggered();
+    if (edgeTriggered != edgeTriggered_)
+    {
+        edgeTriggered_ = edgeTriggered;
+        writeArmed_ = edgeTriggered && isWriting();
+        if (registeredEvents_ >= 0) // 已经加入Poller, 马上生效
+        {
+            update();
+        }
+    }
+    return edgeTriggered_ == on;
+}
+
+int Channel::pollEvents() const
+{
+    if (events_ == kNoneEvent)
+    {
+        return kNoneEvent;
+    }
+    int events = events_;
+    if (edgeTriggered_)
+    {
+        events |= kEdgeTriggered;
+        if (writeArmed_)
+        {
+            events |= kWriteEvent;
+        }
+    }
+    if (exclusive_) // EPOLLEXCLUSIVE不能和EPOLLPRI一起用
+    {
+        events = (events & ~POLLPRI) | kExclusive;
+    }
+    return events;
+}
+
 // update() -> EventLoop::updateChannel() -> EPollPoller::updateChannel()
 void Channel::update()
 {
+    if (edgeTriggered_)
+    {
+        if (events_ & kWriteEvent)
+        {
+            writeArmed_ = true;
+        }
+        // 只是切换了events_中的kWriteEvent, epoll中关注的事件没有变化, 不用epoll_ctl
+        if (events_ != kNoneEvent && pollEvents() == registeredEvents_)
+        {
+            return;
+        }
+    }
+    registeredEvents_ = pollEvents();
     loop_->updateChannel(this);
 }
 
@@ -48,6 +106,43 @@ void Channel::remove()
     assert(isNoneEvent());
 
     loop_->removeChannel(this);
+    registeredEvents_ = -1;
+    writeArmed_ = false;
+    receiving_ = false;
+}
+
+void Channel::startRecv()
+{
+    if (!receiving_)
+    {
+        receiving_ = true;
+        loop_->startRecv(this);
+    }
+}
+
+void Channel::stopRecv()
+{
+    if (receiving_)
+    {
+        receiving_ = false;
+        loop_->stopRecv(this);
+    }
+}
+
+void Channel::sendAsync(const struct msghdr *msg)
+{
+    loop_->sendAsync(this, msg);
+}
+
+void Channel::cancelSend()
+{
+    loop_->cancelSend(this);
+}
+
+void Channel::addCompletion(const char *data, ssize_t n, bool send)
+{
+    Completion c = {data, n, send};
+    completions_.push_back(c);
 }
 
 // Channel的核心函数, 根据 revents_ 的值分别调用不同的用户回调(read/write/error/close).
@@ -62,6 +157,10 @@ void Channel::handleEvent(Timestamp receiveTime)
         {
             handleEventWithGuard(receiveTime); // 连接关闭是可读事件
         }
+        else
+        {
+            completions_.clear(); // recv的数据在下一次poll()时就还给内核了
+        }
     }
     else
     {
@@ -75,6 +174,11 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
     eventHandling_ = true;
 
+    if (!completions_.empty())
+    {
+        handleCompletions(receiveTime);
+    }
+
     if ((revents_ & POLLHUP) && !(revents_ & POLLIN)) // 客户端主动关闭连接
     {
         if (logHup_)
@@ -102,7 +206,8 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
             readCallback_(receiveTime);
     }
 
-    if (revents_ & POLLOUT)
+    // 边沿触发时EPOLLOUT一直在epoll中, 没有数据要写时忽略
+    if ((revents_ & POLLOUT) && (!edgeTriggered_ || (events_ & kWriteEvent)))
     {
         if (writeCallback_)
             writeCallback_();
@@ -111,6 +216,36 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
     eventHandling_ = false;
 }
 
+// 完成事件按到达的顺序回调. recv结束(n <= 0)之后Poller不会再提交, receiving_跟着清掉.
+void Channel::handleCompletions(Timestamp receiveTime)
+{
+    std::vector<Completion> completions;
+    completions.swap(completions_);
+    for (size_t i = 0; i < completions.size(); ++i)
+    {
+        const Completion &c = completions[i];
+        if (c.send)
+        {
+            if (sendCallback_)
+                sendCallback_(c.n);
+        }
+        else
+        {
+            if (c.n <= 0)
+            {
+                receiving_ = false;
+            }
+            if (recvCallback_)
+                recvCallback_(c.data, c.n, receiveTime);
+        }
+    }
+    if (completions_.empty()) // 保留容量, 下一轮不用再分配
+    {
+        completions.clear();
+        completions_.swap(completions);
+    }
+}
+
 string Channel::reventsToString() const
 {
     std::ostringstream oss;
@@ -8,6 +8,12 @@
 
 #include <muduo/base/Timestamp.h>
 
+#include <vector>
+
+#include <sys/types.h>
+
+struct msghdr;
+
 namespace muduo
 {
     namespace net
@@ -46,7 +52,12 @@ namespace muduo
                 update();
             }
 
-            // void disableReading() { events_ &= ~kReadEvent; update(); }
+            void disableReading()
+            {
+                events_ &= ~kReadEvent;
+                update();
+            }
+
             void enableWriting()
             {
                 events_ |= kWriteEvent;
@@ -66,6 +77,45 @@ namespace muduo
             }
 
             bool isWriting() const { return events_ & kWriteEvent; }
+            bool isReading() const { return events_ & kReadEvent; }
+
+            // 边沿触发(EPOLLET), 已经加入Poller时马上生效. Poller不支持时(poll)返回false, 仍然是水平触发.
+            // 第一次enableWriting()之后EPOLLOUT就一直留在epoll中, 之后enable/disableWriting()只修改events_, 不再调用epoll_ctl.
+            // 使用者必须读/写到EAGAIN为止, 否则不会再收到通知.
+            bool setEdgeTriggered(bool on);
+            bool edgeTriggered() const { return edgeTriggered_; }
+
+            // EPOLLEXCLUSIVE: 同一个fd(比如共享的监听socket)加入多个EventLoop时, 一个事件只唤醒其中一个, 在enableXXX()之前调用.
+            void setExclusive(bool on) { exclusive_ = on; }
+            bool exclusive() const { return exclusive_; }
+
+            // 交给epoll_ctl的事件: events_加上EPOLLET/EPOLLEXCLUSIVE等标志
+            int pollEvents() const;
+
+            // ---------
+            // 完成式IO(io_uring), 需要EventLoop::supportsCompletionIo(). 见TcpConnection::setCompletionIo()
+            // ---------
+
+            // 收到的数据. n > 0时data指向内核提供的缓冲区, 只在回调中有效; n == 0表示对方关闭, n < 0是-errno.
+            typedef boost::function<void(const char *data, ssize_t n, Timestamp)> RecvCallback;
+            // sendAsync()完成, n是发送的字节数(可能只发送了一部分)或者-errno
+            typedef boost::function<void(ssize_t n)> SendCallback;
+
+            // 开始multishot recv, 直到stopRecv(), 或者收到n <= 0. stopRecv()之前内核已经收下的数据仍然会回调.
+            void startRecv();
+            void stopRecv();
+            bool isReceiving() const { return receiving_; }
+
+            // 发送msg描述的数据, 同一时刻只能有一个. msg和它指向的数据在SendCallback之前必须保持有效且不能修改,
+            // 所以remove()之前要等到SendCallback, 必要时先cancelSend().
+            void sendAsync(const struct msghdr *msg);
+            void cancelSend();
+
+            void setRecvCallback(const RecvCallback &cb) { recvCallback_ = cb; }
+            void setSendCallback(const SendCallback &cb) { sendCallback_ = cb; }
+
+            // Poller使用: 记下本轮的完成事件, 在handleEvent()中按顺序回调. 此时revents可能为0.
+            void addCompletion(const char *data, ssize_t n, bool send);
 
             // ---------
             // 回调函数相关
@@ -111,10 +161,20 @@ namespace muduo
         private:
             void update();
             void handleEventWithGuard(Timestamp receiveTime);
+            void handleCompletions(Timestamp receiveTime);
+
+            struct Completion
+            {
+                const char *data; // recv的数据, send时为NULL
+                ssize_t n;
+                bool send;
+            };
 
             static const int kNoneEvent;
             static const int kReadEvent;
             static const int kWriteEvent;
+            static const int kEdgeTriggered;
+            static const int kExclusive;
 
             EventLoop *loop_; // 所属的EventLoop
             const int fd_;    // 不负责关闭该fd,  有EventLoop::wakeupfd_
@@ -123,6 +183,14 @@ namespace muduo
             int index_;       // 表示在poll的事件数组中序号, 见EpollPoller.cc的25-30行
             bool logHup_;     // for POLLHUP
 
+            bool edgeTriggered_;   // 见setEdgeTriggered()
+            bool exclusive_;       // 见setExclusive()
+            bool writeArmed_;      // 边沿触发时EPOLLOUT已经加入epoll
+            int registeredEvents_; // 上一次交给Poller的pollEvents(), -1表示还没有
+
+            bool receiving_;                      // 见startRecv()
+            std::vector<Completion> completions_; // 本轮poll()收到的完成事件
+
             boost::weak_ptr<void> tie_; // 把 TcpConnection 对象的 this 赋值给 tie_, 见 TcpConnection::connectEstablished(). void可以接受任意类型.
             bool tied_;                 // 这个没有用到.
 
@@ -139,6 +207,8 @@ namespace muduo
             EventCallback writeCallback_;
             EventCallback closeCallback_; //
             EventCallback errorCallback_;
+            RecvCallback recvCallback_;
+            SendCallback sendCallback_;
         };
 
     } // namespace net
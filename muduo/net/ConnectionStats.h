@@ -0,0 +1,81 @@
+#ifndef MUDUO_NET_CONNECTIONSTATS_H
+#define MUDUO_NET_CONNECTIONSTATS_H
+
+#include <muduo/base/copyable.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/Types.h>
+
+#include <algorithm>
+
+namespace muduo
+{
+    namespace net
+    {
+        // 一个TcpConnection的流量和时间统计. 只在连接所属的IO线程中更新, 不加锁.
+        // 其他线程要用EventLoop::getStats()拿一份拷贝.
+        struct ConnectionStats : public muduo::copyable
+        {
+            string name;
+            Timestamp creationTime;
+            Timestamp lastReceiveTime; // 最近一次读到数据, 取自poll返回的时间
+            Timestamp lastSendTime;    // 最近一次写出数据
+            int64_t bytesReceived;
+            int64_t bytesSent;
+            int64_t reads;             // 读到数据的read(2)次数
+            int64_t writes;            // 写出数据的write(2)/writev(2)/sendfile(2)次数
+            size_t peakOutputBytes;    // 待发送数据的最大值
+            int64_t highWaterMarkHits; // 待发送数据超过高水位的次数
+
+            ConnectionStats()
+                : bytesReceived(0),
+                  bytesSent(0),
+                  reads(0),
+                  writes(0),
+                  peakOutputBytes(0),
+                  highWaterMarkHits(0)
+            {
+            }
+
+            Timestamp lastActivity() const
+            {
+                return std::max(std::max(lastReceiveTime, lastSendTime), creationTime);
+            }
+        };
+
+        // 一个EventLoop上所有连接的累计值, 包括已经关闭的连接.
+        struct LoopStats : public muduo::copyable
+        {
+            int64_t connections;      // 当前的连接数, 只在getStats()的结果中有效
+            int64_t totalConnections; // 建立过的连接数
+            int64_t bytesReceived;
+            int64_t bytesSent;
+            int64_t reads;
+            int64_t writes;
+            int64_t highWaterMarkHits;
+
+            // 忙轮询模式下的开销, 见EventLoop::setBusyPoll()
+            int64_t spinPolls;   // 0超时的poll()次数
+            int64_t spinMicros;  // 其中没有事件的poll()空转的时间, 也就是忙轮询额外消耗的CPU
+            int64_t blockPolls;  // 阻塞的poll()次数
+            int64_t blockMicros; // 阻塞在poll()中的时间
+
+            LoopStats()
+                : connections(0),
+                  totalConnections(0),
+                  bytesReceived(0),
+                  bytesSent(0),
+                  reads(0),
+                  writes(0),
+                  highWaterMarkHits(0),
+                  spinPolls(0),
+                  spinMicros(0),
+                  blockPolls(0),
+                  blockMicros(0)
+            {
+            }
+        };
+
+    } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_CONNECTIONSTATS_H
@@ -1,11 +1,15 @@
+#include <algorithm>
 #include <signal.h>
 #include <sys/eventfd.h>
+#include <utility>
 #include <boost/bind.hpp>
 
+#include <muduo/base/CountDownLatch.h>
 #include <muduo/base/Logging.h>
 #include <muduo/base/Mutex.h>
 #include <muduo/base/Singleton.h>
 #include <muduo/net/EventLoop.h>
+#include <muduo/net/BufferPool.h>
 #include <muduo/net/Channel.h>
 #include <muduo/net/Poller.h>
 #include <muduo/net/SocketsOps.h>
@@ -22,6 +26,9 @@ namespace
     // 单位毫秒, epoll_wait()等待的使用.
     const int kPollTimeMs = 10000;
 
+    // 负载统计窗口, 见EventLoop::busyPermille()
+    const int64_t kLoadWindowMicros = 100 * 1000;
+
     // 创建EventPool::wakeupFd_, 仅在EventPool构造函数中被调用
     int createEventfd()
     {
@@ -51,6 +58,27 @@ namespace
     IgnoreSigPipe initObj;
 } // namespace
 
+// queueInLoop()的队列节点, 每个functor一个
+struct EventLoop::FunctorNode
+{
+    explicit FunctorNode(const Functor &cb)
+        : functor(cb),
+          next(NULL)
+    {
+    }
+
+#ifdef __GXX_EXPERIMENTAL_CXX0X__
+    explicit FunctorNode(Functor &&cb)
+        : functor(std::move(cb)),
+          next(NULL)
+    {
+    }
+#endif
+
+    Functor functor;
+    FunctorNode *next;
+};
+
 // 返回当前线程的EventLoop对象指针, 如果当前线程没有EventLoop, 就返回nullptr.
 EventLoop *EventLoop::getEventLoopOfCurrentThread()
 {
@@ -61,11 +89,23 @@ EventLoop::EventLoop()
     : looping_(false), 
       quit_(false),
       eventHandling_(false),
-      callingPendingFunctors_(false),
+      coarseClock_(false),
+      busyPollMicros_(0),
+      socketBusyPollUs_(0),
       iteration_(0),
       threadId_(CurrentThread::tid()),
       poller_(Poller::newDefaultPoller(this)),
       timerQueue_(new TimerQueue(this)),
+      loadTracking_(false),
+      busyMicros_(0),
+      connectionCount_(0),
+      connectionsAdded_(0),
+      busyPermille_(0),
+      loadPublishedAt_(0),
+      inPoll_(0),
+      callingPendingFunctors_(false),
+      pendingFunctors_(NULL),
+      wakeupPending_(0),
       wakeupFd_(createEventfd()),
       wakeupChannel_(new Channel(this, wakeupFd_)),
       currentActiveChannel_(NULL)
@@ -87,6 +127,14 @@ EventLoop::EventLoop()
 
 EventLoop::~EventLoop()
 {
+    // 没来得及执行的functor
+    FunctorNode *node = pendingFunctors_;
+    while (node)
+    {
+        FunctorNode *next = node->next;
+        delete node;
+        node = next;
+    }
     ::close(wakeupFd_);
     t_loopInThisThread = NULL;
 }
@@ -103,10 +151,22 @@ void EventLoop::loop()
 
     looping_ = true;
     quit_ = false;
+    if (coarseClock_)
+    {
+        Logger::setThreadClock(&pollReturnTime_);
+    }
     while (!quit_)
     {
         activeChannels_.clear();
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_); // IO线程平时就阻塞在这里
+        if (loadTracking_)
+        {
+            beginPoll();
+        }
+        poll(); // IO线程平时就阻塞在这里
+        if (loadTracking_)
+        {
+            endPoll();
+        }
         ++iteration_;
         if (Logger::logLevel() <= Logger::TRACE)
         {
@@ -123,9 +183,12 @@ void EventLoop::loop()
         currentActiveChannel_ = NULL;
         eventHandling_ = false;
 
+        doFlushes();         // 事件回调中延迟的发送, 在执行其他任务之前发出去
         doPendingFunctors(); // 当IO线程也能执行一些计算任务.
+        doFlushes();         // 跨线程send()是在doPendingFunctors()中执行的
     }
 
+    Logger::setThreadClock(NULL);
     LOG_TRACE << "EventLoop " << this << " stop looping";
     looping_ = false;
 }
@@ -158,21 +221,242 @@ void EventLoop::runInLoop(const Functor &cb)
 // 将回调函数cb添加到队列pendingFunctors_, 实现异步调用cb.
 void EventLoop::queueInLoop(const Functor &cb)
 {
+    pushFunctor(new FunctorNode(cb));
+}
+
+#ifdef __GXX_EXPERIMENTAL_CXX0X__
+void EventLoop::runInLoop(Functor &&cb)
+{
+    if (isInLoopThread())
     {
-        MutexLockGuard lock(mutex_);
-        pendingFunctors_.push_back(cb);
+        cb();
+    }
+    else
+    {
+        queueInLoop(std::move(cb));
     }
+}
+
+void EventLoop::queueInLoop(Functor &&cb)
+{
+    pushFunctor(new FunctorNode(std::move(cb)));
+}
+#endif
+
+// 把node压入pendingFunctors_栈顶, 不加锁, 多个线程竞争时CAS失败重试.
+// 只有IO线程会取走节点, 而且总是一次取走整个链表, 所以不存在ABA问题.
+void EventLoop::pushFunctor(FunctorNode *node)
+{
+    FunctorNode *head = __atomic_load_n(&pendingFunctors_, __ATOMIC_RELAXED);
+    do
+    {
+        node->next = head;
+    } while (!__atomic_compare_exchange_n(&pendingFunctors_, &head, node, true,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
 
     // 需要唤醒:
     //   1) 调用 queueInLoop() 的线程不是IO线程
     //   2) doPendingFunctors()中的函数调用了queueInLoop()函数, 唤醒之后, 这样新增的cb就能及时调用.
     // 不需要唤醒: 只有当前IO线程的事件回调中调用queueInLoop.
-    if (!isInLoopThread() || callingPendingFunctors_) // callingPendingFunctors_ 在doPendingFunctors()中设置为true.
+    // 上一次唤醒之后IO线程还没有取走队列, 它一定会看到这个节点, 不用再写eventfd.
+    if ((!isInLoopThread() || callingPendingFunctors_) &&
+        __atomic_exchange_n(&wakeupPending_, 1, __ATOMIC_SEQ_CST) == 0)
     {
         wakeup();
     }
 }
 
+void EventLoop::addConnectionStats(const ConnectionStats *stats)
+{
+    assertInLoopThread();
+    connectionStats_.insert(stats);
+    ++loopStats_.totalConnections;
+    __atomic_store_n(&connectionCount_, static_cast<int>(connectionStats_.size()), __ATOMIC_RELAXED);
+    __atomic_store_n(&connectionsAdded_, loopStats_.totalConnections, __ATOMIC_RELAXED);
+}
+
+void EventLoop::removeConnectionStats(const ConnectionStats *stats)
+{
+    assertInLoopThread();
+    connectionStats_.erase(stats);
+    __atomic_store_n(&connectionCount_, static_cast<int>(connectionStats_.size()), __ATOMIC_RELAXED);
+}
+
+void EventLoop::setLoadTracking(bool on)
+{
+    assertInLoopThread();
+    loadTracking_ = on;
+    loadWindowStart_ = Timestamp::invalid();
+    lastWakeTime_ = Timestamp::invalid();
+    busyMicros_ = 0;
+    __atomic_store_n(&busyPermille_, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&loadPublishedAt_, Timestamp::now().microSecondsSinceEpoch(), __ATOMIC_RELAXED);
+}
+
+int EventLoop::busyPermille() const
+{
+    int permille = __atomic_load_n(&busyPermille_, __ATOMIC_RELAXED);
+    int64_t stale = Timestamp::now().microSecondsSinceEpoch() - __atomic_load_n(&loadPublishedAt_, __ATOMIC_RELAXED);
+    if (stale > 2 * kLoadWindowMicros)
+    {
+        // 没有醒来发布: 阻塞在poll()中说明这段时间都是空闲的, 否则是卡在某个回调里
+        permille = __atomic_load_n(&inPoll_, __ATOMIC_RELAXED) ? static_cast<int>(permille * kLoadWindowMicros / stale) : 1000;
+    }
+    return permille;
+}
+
+// 上一次poll()返回到这一次poll()之前的时间都算忙.
+// 进入poll()之前也检查窗口, 这样一段长时间的处理之后马上阻塞, 这段时间也会发布出去.
+void EventLoop::beginPoll()
+{
+    if (lastWakeTime_.valid())
+    {
+        Timestamp now(Timestamp::now());
+        busyMicros_ += now.microSecondsSinceEpoch() - lastWakeTime_.microSecondsSinceEpoch();
+        publishLoad(now);
+    }
+    __atomic_store_n(&inPoll_, 1, __ATOMIC_RELAXED);
+}
+
+void EventLoop::endPoll()
+{
+    __atomic_store_n(&inPoll_, 0, __ATOMIC_RELAXED);
+    lastWakeTime_ = coarseClock_ ? Timestamp::now() : pollReturnTime_; // 粗粒度时钟的精度不够
+    if (!loadWindowStart_.valid())
+    {
+        loadWindowStart_ = lastWakeTime_;
+        return;
+    }
+    publishLoad(lastWakeTime_);
+}
+
+// 每过kLoadWindowMicros发布一次这个窗口的忙碌比例
+void EventLoop::publishLoad(Timestamp now)
+{
+    int64_t elapsed = now.microSecondsSinceEpoch() - loadWindowStart_.microSecondsSinceEpoch();
+    if (elapsed >= kLoadWindowMicros)
+    {
+        int64_t permille = std::min<int64_t>(busyMicros_ * 1000 / elapsed, 1000);
+        __atomic_store_n(&busyPermille_, static_cast<int>(permille), __ATOMIC_RELAXED);
+        __atomic_store_n(&loadPublishedAt_, now.microSecondsSinceEpoch(), __ATOMIC_RELAXED);
+        busyMicros_ = 0;
+        loadWindowStart_ = now;
+    }
+}
+
+void EventLoop::getStats(LoopStats *loopStats, std::vector<ConnectionStats> *connections)
+{
+    if (isInLoopThread())
+    {
+        collectStats(loopStats, connections, NULL);
+    }
+    else
+    {
+        CountDownLatch latch(1);
+        runInLoop(boost::bind(&EventLoop::collectStats, this, loopStats, connections, &latch));
+        latch.wait();
+    }
+}
+
+void EventLoop::collectStats(LoopStats *loopStats, std::vector<ConnectionStats> *connections, CountDownLatch *latch)
+{
+    assertInLoopThread();
+    if (loopStats)
+    {
+        *loopStats = loopStats_;
+        loopStats->connections = static_cast<int64_t>(connectionStats_.size());
+    }
+    if (connections)
+    {
+        connections->clear();
+        connections->reserve(connectionStats_.size());
+        for (std::set<const ConnectionStats *>::const_iterator it = connectionStats_.begin();
+             it != connectionStats_.end(); ++it)
+        {
+            connections->push_back(**it);
+        }
+    }
+    if (latch)
+    {
+        latch->countDown();
+    }
+}
+
+void EventLoop::queueFlush(const Functor &cb)
+{
+    assertInLoopThread();
+    flushFunctors_.push_back(cb);
+}
+
+void EventLoop::doFlushes()
+{
+    if (flushFunctors_.empty())
+    {
+        return;
+    }
+    std::vector<Functor> functors;
+    functors.swap(flushFunctors_); // flush的过程中可能又会queueFlush(), 留到下一次
+    for (size_t i = 0; i < functors.size(); ++i)
+    {
+        functors[i]();
+    }
+}
+
+void EventLoop::setCoarseClock(bool on)
+{
+    assert(!looping_);
+    coarseClock_ = on;
+    poller_->setCoarseClock(on);
+}
+
+void EventLoop::setBusyPoll(double spinSeconds, int socketBusyPollUs)
+{
+    assertInLoopThread();
+    busyPollMicros_ = static_cast<int64_t>(spinSeconds * Timestamp::kMicroSecondsPerSecond);
+    socketBusyPollUs_ = socketBusyPollUs;
+}
+
+// 调用poller_->poll(), 结果放在activeChannels_和pollReturnTime_中
+void EventLoop::poll()
+{
+    if (busyPollMicros_ <= 0)
+    {
+        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        return;
+    }
+
+    // 忙轮询: 距离最后一次有事件还在窗口内, 就不阻塞.
+    // 用上一次poll()返回的时刻判断, 这样空转时每次只读一次时钟.
+    Timestamp last = pollReturnTime_;
+    if (last.valid() && last.microSecondsSinceEpoch() - lastActiveTime_.microSecondsSinceEpoch() < busyPollMicros_)
+    {
+        pollReturnTime_ = poller_->poll(0, &activeChannels_);
+        ++loopStats_.spinPolls;
+        if (activeChannels_.empty())
+        {
+            loopStats_.spinMicros += pollReturnTime_.microSecondsSinceEpoch() - last.microSecondsSinceEpoch();
+        }
+    }
+    else
+    {
+        Timestamp start(Timestamp::now());
+        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        ++loopStats_.blockPolls;
+        loopStats_.blockMicros += pollReturnTime_.microSecondsSinceEpoch() - start.microSecondsSinceEpoch();
+    }
+
+    if (!activeChannels_.empty())
+    {
+        lastActiveTime_ = pollReturnTime_;
+    }
+}
+
+// runAfter()/runEvery()计算到期时刻的起点, 粗粒度时钟模式下在IO线程中用缓存的时刻
+Timestamp EventLoop::timerBase() const
+{
+    return coarseClock_ && isInLoopThread() ? now() : Timestamp::now();
+}
+
 TimerId EventLoop::runAt(const Timestamp &time, const TimerCallback &cb)
 {
     return timerQueue_->addTimer(cb, time, 0.0); // 一次性定时器
@@ -180,21 +464,45 @@ TimerId EventLoop::runAt(const Timestamp &time, const TimerCallback &cb)
 
 TimerId EventLoop::runAfter(double delay, const TimerCallback &cb)
 {
-    Timestamp time(addTime(Timestamp::now(), delay)); // 一次性定时器
+    Timestamp time(addTime(timerBase(), delay)); // 一次性定时器
     return runAt(time, cb);
 }
 
 TimerId EventLoop::runEvery(double interval, const TimerCallback &cb)
 {
-    Timestamp time(addTime(Timestamp::now(), interval)); // 持续性定时器
+    Timestamp time(addTime(timerBase(), interval)); // 持续性定时器
     return timerQueue_->addTimer(cb, time, interval);
 }
 
+TimerId EventLoop::runAfter(double delay, double slack, const TimerCallback &cb)
+{
+    Timestamp time(addTime(timerBase(), delay));
+    return timerQueue_->addTimer(cb, time, 0.0, slack);
+}
+
+TimerId EventLoop::runEvery(double interval, double slack, const TimerCallback &cb)
+{
+    Timestamp time(addTime(timerBase(), interval));
+    return timerQueue_->addTimer(cb, time, interval, slack);
+}
+
 void EventLoop::cancel(TimerId timerId)
 {
     return timerQueue_->cancel(timerId);
 }
 
+void EventLoop::enableBufferPool(size_t chunkSize, double reclaimInterval)
+{
+    assertInLoopThread();
+    assert(!bufferPool_);
+
+    bufferPool_.reset(new BufferPool(chunkSize));
+    if (reclaimInterval > 0)
+    {
+        runEvery(reclaimInterval, boost::bind(&BufferPool::trim, get_pointer(bufferPool_)));
+    }
+}
+
 // 从Poller中添加/更新通道
 // Channel中保存了EventLoop对象loop_, 该函数在Channel中通过loop_调用的.
 void EventLoop::updateChannel(Channel *channel)
@@ -205,6 +513,44 @@ void EventLoop::updateChannel(Channel *channel)
     poller_->updateChannel(channel);
 }
 
+bool EventLoop::supportsEdgeTriggered() const
+{
+    return poller_->supportsEdgeTriggered();
+}
+
+bool EventLoop::supportsCompletionIo() const
+{
+    return poller_->supportsCompletionIo();
+}
+
+void EventLoop::startRecv(Channel *channel)
+{
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    poller_->startRecv(channel);
+}
+
+void EventLoop::stopRecv(Channel *channel)
+{
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    poller_->stopRecv(channel);
+}
+
+void EventLoop::sendAsync(Channel *channel, const struct msghdr *msg)
+{
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    poller_->sendAsync(channel, msg);
+}
+
+void EventLoop::cancelSend(Channel *channel)
+{
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    poller_->cancelSend(channel);
+}
+
 // 从Poller中移除通道
 void EventLoop::removeChannel(Channel *channel)
 {
@@ -251,23 +597,33 @@ void EventLoop::handleRead()
 // 调用 pendingFunctors_ 中的函数
 void EventLoop::doPendingFunctors()
 {
-    // 不是简单地在临界区内依次调用Functor, 而是swap到functors中调用:
-    //   1) 减小临界区的大小.
-    //   2) 避免死锁, 因为functor可能再次调用queueInLoop(), 对mutex_再次加锁.
-    std::vector<Functor> functors;
+    // 不是在队列上依次调用Functor, 而是一次取走整个链表再调用, functor可能再次调用queueInLoop().
     callingPendingFunctors_ = true;
+
+    // 先清除wakeupPending_再取链表: 在此之后压入的节点, 一定会有人重新写eventfd.
+    __atomic_store_n(&wakeupPending_, 0, __ATOMIC_SEQ_CST);
+    FunctorNode *node = __atomic_exchange_n(&pendingFunctors_, static_cast<FunctorNode *>(NULL), __ATOMIC_SEQ_CST);
+
+    // 栈是后进先出的, 反转成投递的顺序
+    FunctorNode *functors = NULL;
+    while (node)
     {
-        MutexLockGuard lock(mutex_);
-        functors.swap(pendingFunctors_);
+        FunctorNode *next = node->next;
+        node->next = functors;
+        functors = node;
+        node = next;
     }
 
-    // 有可能上面刚刚 swap pendingFunctors_ 之后, pendingFunctors_ 中又添加了cb.
+    // 有可能上面刚刚取走链表之后, pendingFunctors_ 中又添加了cb.
     // 即使这样也不要反复执行 doPendingFunctors() 直到pendingFunctors 为空, 否则IO线程可能陷入死循环, 无法处理IO事件.
 
-    for (size_t i = 0; i < functors.size(); ++i)
+    while (functors)
     {
-        functors[i]();
-        // functors[i]()可能调用queueInLoop(), 这时queueInLoop()就必须wakeup(), 否则新增的cb可能就不能及时调用了 .
+        FunctorNode *next = functors->next;
+        functors->functor();
+        // functor()可能调用queueInLoop(), 这时queueInLoop()就必须wakeup(), 否则新增的cb可能就不能及时调用了 .
+        delete functors;
+        functors = next;
     }
     callingPendingFunctors_ = false;
 }
@@ -1,6 +1,7 @@
 #ifndef MUDUO_NET_EVENTLOOP_H
 #define MUDUO_NET_EVENTLOOP_H
 
+#include <set>
 #include <vector>
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
@@ -10,12 +11,18 @@
 #include <muduo/base/Thread.h>
 #include <muduo/base/Timestamp.h>
 #include <muduo/net/Callbacks.h>
+#include <muduo/net/ConnectionStats.h>
 #include <muduo/net/TimerId.h>
 
+struct msghdr;
+
 namespace muduo
 {
+    class CountDownLatch;
+
     namespace net
     {
+        class BufferPool;
         class Channel;
         class Poller;
         class TimerQueue;
@@ -40,12 +47,42 @@ namespace muduo
             ///
             Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+            // 本轮poll()返回时缓存的时刻, 不读时钟. 只能在IO线程中调用.
+            // 在一轮事件处理中不会前进, 只适合能容忍这个误差的地方(定时器到期判断, 日志, 统计等).
+            // 第一次poll()之前返回Timestamp::now().
+            Timestamp now() const
+            {
+                return pollReturnTime_.valid() ? pollReturnTime_ : Timestamp::now();
+            }
+
+            // 粗粒度时钟模式, 在loop()之前调用:
+            // 1. poll()返回时改读CLOCK_REALTIME_COARSE;
+            // 2. IO线程中的runAfter()/runEvery()以now()为起点计算到期时刻;
+            // 3. IO线程的日志使用now(), 不再每条日志读一次时钟.
+            // 时间精度降到毫秒级(一个时钟tick加上一轮事件处理的耗时), 定时器可能提前这么多触发.
+            void setCoarseClock(bool on);
+
+            // 忙轮询模式: 最后一次有事件之后的spinSeconds秒内, 用0超时的poll()空转而不是阻塞, 省掉唤醒的延迟; 之后再退回阻塞.
+            // socketBusyPollUs > 0时, 本loop上新建的TcpConnection设置SO_BUSY_POLL, 让内核在设备队列上忙等这么多微秒.
+            // 空转和阻塞的时间记在LoopStats中, 用来评估消耗的CPU. spinSeconds为0时关闭. 只能在IO线程中调用.
+            void setBusyPoll(double spinSeconds, int socketBusyPollUs = 0);
+            int socketBusyPoll() const { return socketBusyPollUs_; }
+
             int64_t iteration() const { return iteration_; }
 
             // 函数调用
 
             void runInLoop(const Functor &cb);
             void queueInLoop(const Functor &cb);
+#ifdef __GXX_EXPERIMENTAL_CXX0X__
+            // 临时的boost::bind()结果会匹配这两个重载, 直接移动进队列, 不再复制一遍绑定的参数.
+            void runInLoop(Functor &&cb);
+            void queueInLoop(Functor &&cb);
+#endif
+
+            // 只能在IO线程中调用. 本轮的事件处理(以及doPendingFunctors())结束之后调用一次cb,
+            // 用于把一轮中多次send()的数据合并成一次writev, 见TcpConnection::setDeferredFlush().
+            void queueFlush(const Functor &cb);
 
             // 定时器
 
@@ -58,9 +95,47 @@ namespace muduo
             // 每隔一段时间运行定时器, 线程安全.
             TimerId runEvery(double interval, const TimerCallback &cb);
 
+            // 同上, 但允许最多推迟slack秒. 到期时刻相近的定时器会合并到同一次唤醒, 适合大量不要求精确的超时(比如RPC deadline).
+            TimerId runAfter(double delay, double slack, const TimerCallback &cb);
+            TimerId runEvery(double interval, double slack, const TimerCallback &cb);
+
             // 取消定时器, 线程安全.
             void cancel(TimerId timerId);
 
+            // 缓冲区池
+
+            // 创建本loop的BufferPool, 之后在这个loop上建立的TcpConnection从中借用缓冲区.
+            // 每隔reclaimInterval秒回收一次长时间空闲的chunk. 必须在IO线程中调用.
+            void enableBufferPool(size_t chunkSize, double reclaimInterval = 10.0);
+
+            // 没有调用过enableBufferPool()时返回NULL
+            BufferPool *bufferPool() const { return get_pointer(bufferPool_); }
+
+            // 连接统计
+
+            // 本loop上所有连接的累计值, 由TcpConnection更新. 只能在IO线程中使用.
+            LoopStats *loopStats() { return &loopStats_; }
+
+            // TcpConnection建立/销毁时登记自己的统计, 只能在IO线程中调用.
+            void addConnectionStats(const ConnectionStats *stats);
+            void removeConnectionStats(const ConnectionStats *stats);
+
+            // 线程安全. 在IO线程中拷贝一份累计值和当前每个连接的统计, 不是IO线程时会阻塞到IO线程执行完, 所以loop必须在运行.
+            void getStats(LoopStats *loopStats, std::vector<ConnectionStats> *connections);
+
+            // 负载信号, IO线程发布, 任何线程都可以无锁读取, 用于EventLoopThreadPool选择新连接的loop.
+
+            // 当前的连接数, 以及建立过的连接数
+            int connectionCount() const { return __atomic_load_n(&connectionCount_, __ATOMIC_RELAXED); }
+            int64_t connectionsAdded() const { return __atomic_load_n(&connectionsAdded_, __ATOMIC_RELAXED); }
+
+            // 开启之后每轮poll()前后各读一次时钟, 统计不在poll()中的时间. 只能在IO线程中调用.
+            void setLoadTracking(bool on);
+
+            // 最近一个统计窗口(100ms)内不在poll()中的时间比例, 千分比. 需要先setLoadTracking(true).
+            // 很久没有发布时: 阻塞在poll()中按空闲的时间衰减, 卡在回调中就是1000.
+            int busyPermille() const;
+
             // internal usage
             void wakeup();
 
@@ -68,6 +143,12 @@ namespace muduo
 
             void updateChannel(Channel *channel);
             void removeChannel(Channel *channel);
+            bool supportsEdgeTriggered() const; // Poller是否支持EPOLLET, 见Channel::setEdgeTriggered()
+            bool supportsCompletionIo() const;  // Poller是否支持完成式IO(io_uring), 见Channel::startRecv()
+            void startRecv(Channel *channel);
+            void stopRecv(Channel *channel);
+            void sendAsync(Channel *channel, const struct msghdr *msg);
+            void cancelSend(Channel *channel);
 
             // pid_t threadId() const { return threadId_; }
 
@@ -89,8 +170,18 @@ namespace muduo
             static EventLoop *getEventLoopOfCurrentThread();
 
         private:
+            struct FunctorNode; // 见EventLoop.cc
+
             void abortNotInLoopThread();
+            void poll();
+            void pushFunctor(FunctorNode *node);
+            Timestamp timerBase() const;
             void doPendingFunctors();
+            void doFlushes();
+            void collectStats(LoopStats *loopStats, std::vector<ConnectionStats> *connections, CountDownLatch *latch);
+            void beginPoll();
+            void endPoll();
+            void publishLoad(Timestamp now);
 
             void printActiveChannels() const; // DEBUG
 
@@ -104,17 +195,40 @@ namespace muduo
             bool quit_;          // 是否退出标志
             bool eventHandling_; // 是否事件处理的状态
 
+            bool coarseClock_;   // 见setCoarseClock()
+
+            int64_t busyPollMicros_;     // 忙轮询的时间窗口, 0表示不使用
+            int socketBusyPollUs_;       // 新连接的SO_BUSY_POLL
+            Timestamp lastActiveTime_;   // 最后一次poll()返回事件的时刻
+
             int64_t iteration_;        // 记录poll()调用了多少次
             const pid_t threadId_;     // 当前对象所属线程ID
             Timestamp pollReturnTime_; // 调用poll()所返回的时间戳, 只是在loop函数中使用, 感觉没必要做数据成员.
 
             boost::scoped_ptr<TimerQueue> timerQueue_; // 定时器
 
+            boost::scoped_ptr<BufferPool> bufferPool_; // TcpConnection的缓冲区池, 可以为空
+
+            LoopStats loopStats_;
+            std::set<const ConnectionStats *> connectionStats_; // 本loop上当前的连接
+
+            // 负载信号, 见busyPermille(). 最后几个由IO线程写, 其他线程读
+            bool loadTracking_;
+            Timestamp loadWindowStart_;
+            Timestamp lastWakeTime_; // 最近一次poll()返回的精确时刻
+            int64_t busyMicros_;     // 本窗口内不在poll()中的时间
+            int connectionCount_;
+            int64_t connectionsAdded_;
+            int busyPermille_;
+            int64_t loadPublishedAt_; // 最近一次发布busyPermille_的时刻, 微秒
+            int inPoll_;
+
             // IO线程自己的任务
 
-            bool callingPendingFunctors_;          // 状态变量, 是否正在执行doPendingFunctors(), 仅仅在该函数中设置.
-            std::vector<Functor> pendingFunctors_; // 回调函数队列, 会被暴露给其他线程, 所以需要mutex_
-            MutexLock mutex_;                      // 用于对pendingFunctors_加锁, 在 doPendingFunctors()和 queueInLoop()中被使用, 注意避免死锁.
+            bool callingPendingFunctors_;        // 状态变量, 是否正在执行doPendingFunctors(), 仅仅在该函数中设置.
+            FunctorNode *pendingFunctors_;       // 无锁的多生产者单消费者队列: 其他线程CAS压入栈顶, IO线程一次取走整个链表再反转成FIFO
+            int wakeupPending_;                  // 已经写过wakeupFd_但doPendingFunctors()还没有取走队列, 这期间的queueInLoop()不用再写
+            std::vector<Functor> flushFunctors_; // queueFlush()添加的, 只在IO线程中访问, 不用加锁
 
             // Wake Up 机制
 
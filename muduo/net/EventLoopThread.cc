@@ -6,13 +6,14 @@
 using namespace muduo;
 using namespace muduo::net;
 
-EventLoopThread::EventLoopThread(const ThreadInitCallback &cb)
+EventLoopThread::EventLoopThread(const ThreadInitCallback &cb, const string &name, const ThreadPlacement &placement)
     : loop_(NULL),
       exiting_(false),
-      thread_(boost::bind(&EventLoopThread::threadFunc, this)),
+      thread_(boost::bind(&EventLoopThread::threadFunc, this), name),
       mutex_(),
       cond_(mutex_),
-      callback_(cb)
+      callback_(cb),
+      placement_(placement)
 {
 }
 
@@ -43,6 +44,9 @@ EventLoop *EventLoopThread::startLoop()
 // 先调用callbak_ -> 赋值loop_(EventLoop), 并通知loop已经创建 -> 进入loop().
 void EventLoopThread::threadFunc()
 {
+    placement_.apply();
+    placementReport_ = ThreadPlacement::current(); // 在通知startLoop()之前写, 由mutex_保证可见
+
     EventLoop loop;
 
     if (callback_)
@@ -4,6 +4,7 @@
 #include <muduo/base/Condition.h>
 #include <muduo/base/Mutex.h>
 #include <muduo/base/Thread.h>
+#include <muduo/base/ThreadPlacement.h>
 
 #include <boost/noncopyable.hpp>
 
@@ -19,11 +20,17 @@ namespace muduo
         public:
             typedef boost::function<void(EventLoop *)> ThreadInitCallback;
 
-            EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback());
+            // placement在创建EventLoop之前生效, 这样EventLoop和它上面的连接分配的内存都在本地NUMA节点上
+            EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(),
+                            const string &name = string(),
+                            const ThreadPlacement &placement = ThreadPlacement());
             ~EventLoopThread();
             
             EventLoop *startLoop(); 
 
+            // IO线程实际的放置, 见ThreadPlacement::current(). startLoop()之后有效.
+            const string &placementReport() const { return placementReport_; }
+
         private:
             void threadFunc();
 
@@ -33,6 +40,8 @@ namespace muduo
             MutexLock mutex_;
             Condition cond_;
             ThreadInitCallback callback_; // 回调函数在 EventLoop::loop()之前被调用
+            ThreadPlacement placement_;
+            string placementReport_;
         };
 
     } // namespace net
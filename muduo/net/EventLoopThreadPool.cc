@@ -1,17 +1,39 @@
 #include <muduo/net/EventLoopThreadPool.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/EventLoopThread.h>
+#include <muduo/net/InetAddress.h>
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+#include <stdio.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+    // 一致性哈希中每个loop的虚拟节点数
+    const int kVirtualNodes = 64;
+
+    // murmur3的fmix32, 把IP地址和虚拟节点编号打散
+    uint32_t mix(uint32_t h)
+    {
+        h ^= h >> 16;
+        h *= 0x85ebca6b;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35;
+        h ^= h >> 16;
+        return h;
+    }
+}
+
 EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop)
     : baseLoop_(baseLoop),
       started_(false),
       numThreads_(0),
-      next_(0)
+      next_(0),
+      placement_(kRoundRobin)
 {
 }
 
@@ -28,9 +50,13 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
 
     started_ = true;
 
+    bool loadTracking = placement_ == kLeastBusy || placementCallback_;
     for (int i = 0; i < numThreads_; ++i)
     {
-        EventLoopThread *t = new EventLoopThread(cb);
+        char name[32];
+        snprintf(name, sizeof name, "io%d", i);
+        ThreadPlacement placement(threadPlacements_.empty() ? ThreadPlacement() : threadPlacements_[i % threadPlacements_.size()]);
+        EventLoopThread *t = new EventLoopThread(boost::bind(&EventLoopThreadPool::threadInit, loadTracking, cb, _1), name, placement);
         threads_.push_back(t);
         loops_.push_back(t->startLoop()); // 启动 EventLoopThread线程, 在进入事件循环之前, 会调用cb
     }
@@ -39,6 +65,53 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
     {
         cb(baseLoop_);
     }
+
+    placed_.assign(loops_.size(), 0);
+    if (placement_ == kPeerHash)
+    {
+        for (size_t i = 0; i < loops_.size(); ++i)
+        {
+            for (int v = 0; v < kVirtualNodes; ++v)
+            {
+                ring_.push_back(std::make_pair(mix(static_cast<uint32_t>(i * kVirtualNodes + v) + 1), static_cast<int>(i)));
+            }
+        }
+        std::sort(ring_.begin(), ring_.end());
+    }
+}
+
+void EventLoopThreadPool::threadInit(bool loadTracking, const ThreadInitCallback &cb, EventLoop *loop)
+{
+    if (loadTracking)
+    {
+        loop->setLoadTracking(true);
+    }
+    if (cb)
+    {
+        cb(loop);
+    }
+}
+
+std::vector<string> EventLoopThreadPool::threadPlacementReports() const
+{
+    assert(started_);
+    std::vector<string> reports;
+    for (size_t i = 0; i < threads_.size(); ++i)
+    {
+        reports.push_back(threads_[i].placementReport());
+    }
+    return reports;
+}
+
+std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
+{
+    baseLoop_->assertInLoopThread();
+    assert(started_);
+    if (loops_.empty())
+    {
+        return std::vector<EventLoop *>(1, baseLoop_);
+    }
+    return loops_;
 }
 
 EventLoop *EventLoopThreadPool::getNextLoop()
@@ -63,3 +136,64 @@ EventLoop *EventLoopThreadPool::getNextLoop()
 
     return loop;
 }
+
+// 已经分配给loops_[i], 但是还没有在它的IO线程中建立的连接数
+int EventLoopThreadPool::pendingConnections(size_t i) const
+{
+    int64_t pending = placed_[i] - loops_[i]->connectionsAdded();
+    return pending > 0 ? static_cast<int>(pending) : 0;
+}
+
+EventLoop *EventLoopThreadPool::getLoopForPeer(const InetAddress &peerAddr)
+{
+    baseLoop_->assertInLoopThread();
+    if (loops_.empty())
+    {
+        return baseLoop_;
+    }
+    if (placementCallback_)
+    {
+        return placementCallback_(loops_, peerAddr);
+    }
+
+    size_t chosen = 0;
+    switch (placement_)
+    {
+    case kRoundRobin:
+        return getNextLoop();
+
+    case kPeerHash:
+    {
+        std::vector<std::pair<uint32_t, int> >::const_iterator it =
+            std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(mix(peerAddr.ipNetEndian()), 0));
+        chosen = it == ring_.end() ? ring_.front().second : it->second;
+        break;
+    }
+
+    case kLeastConnections:
+    case kLeastBusy:
+    {
+        // 一批连接在建立之前loop的连接数不会变, 所以要算上已经分配的, 否则会全部分到同一个loop.
+        // 从next_开始找, 负载相同时轮流分配
+        int bestBusy = 0;
+        int bestConnections = 0;
+        for (size_t n = 0; n < loops_.size(); ++n)
+        {
+            size_t i = (static_cast<size_t>(next_) + n) % loops_.size();
+            int busy = placement_ == kLeastBusy ? loops_[i]->busyPermille() / 100 : 0;
+            int connections = loops_[i]->connectionCount() + pendingConnections(i);
+            if (n == 0 || busy < bestBusy || (busy == bestBusy && connections < bestConnections))
+            {
+                chosen = i;
+                bestBusy = busy;
+                bestConnections = connections;
+            }
+        }
+        next_ = static_cast<int>((chosen + 1) % loops_.size());
+        break;
+    }
+    }
+
+    ++placed_[chosen];
+    return loops_[chosen];
+}
@@ -3,7 +3,9 @@
 
 #include <muduo/base/Condition.h>
 #include <muduo/base/Mutex.h>
+#include <muduo/base/ThreadPlacement.h>
 
+#include <utility>
 #include <vector>
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
@@ -15,20 +17,53 @@ namespace muduo
     {
         class EventLoop;
         class EventLoopThread;
+        class InetAddress;
 
         class EventLoopThreadPool : boost::noncopyable
         {
         public:
             typedef boost::function<void(EventLoop *)> ThreadInitCallback;
 
+            // 新连接放到哪个IO线程, 见getLoopForPeer()
+            enum Placement
+            {
+                kRoundRobin,       // 轮询(默认)
+                kLeastConnections, // 连接数最少的loop, 包括已经分配还没有建立的
+                kLeastBusy,        // 最近不在poll()中的时间比例最小的loop(按10%分档), 同一档中连接数最少的
+                kPeerHash,         // 按客户端IP一致性哈希, 同一个客户端的连接总是在同一个loop上
+            };
+
+            // 自定义策略, 从所有IO线程的loop中选一个. 可以读EventLoop::connectionCount()/busyPermille()等负载信号.
+            typedef boost::function<EventLoop *(const std::vector<EventLoop *> &, const InetAddress &)> PlacementCallback;
+
             EventLoopThreadPool(EventLoop *baseLoop);
             ~EventLoopThreadPool();
 
             void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+
+            // 必须在start()之前调用. kLeastBusy和自定义策略会开启每个IO线程的EventLoop::setLoadTracking().
+            void setPlacement(Placement placement) { placement_ = placement; }
+            void setPlacementCallback(const PlacementCallback &cb) { placementCallback_ = cb; }
+
+            // 第i个IO线程按placements[i % placements.size()]放置(绑定CPU, 内存策略绑定到本地NUMA节点). 必须在start()之前调用.
+            void setThreadPlacements(const std::vector<ThreadPlacement> &placements) { threadPlacements_ = placements; }
+
+            // 每个IO线程实际的放置, 见ThreadPlacement::current(). 必须在start()之后调用.
+            std::vector<string> threadPlacementReports() const;
+
             void start(const ThreadInitCallback &cb = ThreadInitCallback());
-            EventLoop *getNextLoop();
+            EventLoop *getNextLoop(); // 轮询
+
+            // 按放置策略为客户端peerAddr的新连接选择loop. 只能在baseLoop_中调用, 读各个loop的负载信号不加锁.
+            EventLoop *getLoopForPeer(const InetAddress &peerAddr);
+
+            // 所有IO线程的EventLoop, 没有IO线程时就是baseLoop_. 必须在start()之后调用.
+            std::vector<EventLoop *> getAllLoops();
 
         private:
+            static void threadInit(bool loadTracking, const ThreadInitCallback &cb, EventLoop *loop);
+            int pendingConnections(size_t i) const;
+
             EventLoop *baseLoop_; // 与Acceptor所属EventLoop相同, 见TcpServer::TcpServer()
             bool started_;        // 是否已经启动, 见 start()
             int numThreads_;      // 线程数
@@ -36,6 +71,12 @@ namespace muduo
 
             boost::ptr_vector<EventLoopThread> threads_; // IO线程列表, IO线程都是子线程.
             std::vector<EventLoop *> loops_;             // IO线程列表中的EventLoop对象, 都是栈上的对象, 见 EventLoopThread::threadFunc()
+
+            Placement placement_;
+            PlacementCallback placementCallback_;
+            std::vector<ThreadPlacement> threadPlacements_;
+            std::vector<int64_t> placed_;                // 分配给每个loop的连接数, 减去loop的connectionsAdded()就是还没有建立的
+            std::vector<std::pair<uint32_t, int> > ring_; // 一致性哈希环: 虚拟节点的哈希值 -> loops_的下标, 按哈希值排序
         };
 
     } // namespace net
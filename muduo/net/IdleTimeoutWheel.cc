@@ -0,0 +1,107 @@
+#include <muduo/net/IdleTimeoutWheel.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/TcpConnection.h>
+
+#include <boost/bind.hpp>
+
+#include <assert.h>
+#include <math.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+IdleTimeoutWheel::IdleTimeoutWheel(EventLoop *loop, double timeout, double tick, Action action)
+    : loop_(loop),
+      timeout_(timeout),
+      tick_(tick),
+      action_(action),
+      buckets_(static_cast<size_t>(ceil(timeout / tick)) + 1),
+      current_(0),
+      size_(0),
+      expired_(0)
+{
+    assert(timeout > 0 && tick > 0);
+}
+
+IdleTimeoutWheel::~IdleTimeoutWheel()
+{
+}
+
+void IdleTimeoutWheel::start()
+{
+    timer_ = loop_->runEvery(tick_, boost::bind(&IdleTimeoutWheel::onTick, shared_from_this()));
+}
+
+void IdleTimeoutWheel::stop()
+{
+    loop_->cancel(timer_);
+}
+
+void IdleTimeoutWheel::add(const TcpConnectionPtr &conn)
+{
+    loop_->assertInLoopThread();
+    assert(conn->getLoop() == loop_);
+    buckets_[(current_ + buckets_.size() - 1) % buckets_.size()].push_back(conn); // 最远的一格
+    ++size_;
+}
+
+// deadline在now之后的第几格, 至少是下一格, 最多转一圈
+size_t IdleTimeoutWheel::slotFor(Timestamp deadline, Timestamp now) const
+{
+    double ticks = ceil(timeDifference(deadline, now) / tick_);
+    size_t ahead = ticks < 1 ? 1 : std::min(static_cast<size_t>(ticks), buckets_.size() - 1);
+    return (current_ + ahead) % buckets_.size();
+}
+
+void IdleTimeoutWheel::onTick()
+{
+    current_ = (current_ + 1) % buckets_.size();
+    Bucket due;
+    due.swap(buckets_[current_]);
+
+    Timestamp now(loop_->now());
+    std::vector<TcpConnectionPtr> idle;
+    for (Bucket::iterator it = due.begin(); it != due.end(); ++it)
+    {
+        TcpConnectionPtr conn(it->lock());
+        if (!conn || conn->disconnected()) // 已经关闭了, 不再跟踪
+        {
+            --size_;
+            continue;
+        }
+
+        Timestamp deadline(addTime(conn->stats().lastActivity(), timeout_));
+        if (now < deadline) // 期间有过活动, 挂到新的到期时间上
+        {
+            buckets_[slotFor(deadline, now)].push_back(*it);
+        }
+        else
+        {
+            idle.push_back(conn);
+        }
+    }
+
+    // 一批一起关闭
+    for (size_t i = 0; i < idle.size(); ++i)
+    {
+        const TcpConnectionPtr &conn = idle[i];
+        LOG_DEBUG << "IdleTimeoutWheel close idle connection " << conn->name();
+        if (conn->connected())
+        {
+            ++expired_;
+        }
+        if (action_ == kShutdown && conn->connected())
+        {
+            conn->shutdown();
+            // 给对端一个timeout的时间关闭连接
+            buckets_[(current_ + buckets_.size() - 1) % buckets_.size()].push_back(conn);
+        }
+        else
+        {
+            --size_;
+            conn->forceClose();
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef MUDUO_NET_IDLETIMEOUTWHEEL_H
+#define MUDUO_NET_IDLETIMEOUTWHEEL_H
+
+#include <muduo/base/Types.h>
+#include <muduo/net/Callbacks.h>
+#include <muduo/net/TimerId.h>
+
+#include <vector>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace muduo
+{
+    namespace net
+    {
+        class EventLoop;
+        class TcpConnection;
+
+        // 关闭空闲连接的时间轮, 每个IO线程一个, 只在所属的loop中使用.
+        //
+        // 每tick秒转一格, 一圈覆盖timeout秒. 连接挂在预计到期的那一格上, 只保存weak_ptr.
+        // 收发数据时不操作时间轮: 连接的ConnectionStats本来就记录了最近的活动时间, 到期的那一格被检查时,
+        // 期间有过活动的连接按新的到期时间挂到后面的格子里, 真正空闲的连接攒成一批一起关闭.
+        // 所以刷新的开销是O(1)(就是统计里的一次赋值), 每个连接每个timeout周期只被检查一次, 不需要每连接一个定时器.
+        class IdleTimeoutWheel : boost::noncopyable,
+                                 public boost::enable_shared_from_this<IdleTimeoutWheel>
+        {
+        public:
+            enum Action
+            {
+                kShutdown,  // 先关闭写端, 对端再空闲一个timeout还不关闭就强制关闭
+                kForceClose // 直接关闭
+            };
+
+            IdleTimeoutWheel(EventLoop *loop, double timeout, double tick, Action action);
+            ~IdleTimeoutWheel();
+
+            // 开始转动. 定时器持有shared_ptr, stop()之后才会释放.
+            void start();
+            // 线程安全.
+            void stop();
+
+            // 开始跟踪一个已经建立的连接, 必须在loop线程中调用.
+            void add(const TcpConnectionPtr &conn);
+
+            size_t size() const { return size_; } // 跟踪中的连接数(包括已经关闭还没有被检查到的)
+            int64_t expired() const { return expired_; }         // 因为空闲被关闭的连接数
+
+        private:
+            typedef boost::weak_ptr<TcpConnection> WeakTcpConnectionPtr;
+            typedef std::vector<WeakTcpConnectionPtr> Bucket;
+
+            void onTick();
+            size_t slotFor(Timestamp deadline, Timestamp now) const;
+
+            EventLoop *loop_;
+            const double timeout_;
+            const double tick_;
+            const Action action_;
+            std::vector<Bucket> buckets_;
+            size_t current_; // 当前指向的格子
+            size_t size_;
+            int64_t expired_;
+            TimerId timer_;
+        };
+
+    } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_IDLETIMEOUTWHEEL_H
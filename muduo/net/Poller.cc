@@ -1,10 +1,13 @@
 #include <muduo/net/Poller.h>
 
+#include <muduo/base/Logging.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
 Poller::Poller(EventLoop* loop)
-  : ownerLoop_(loop)
+  : ownerLoop_(loop),
+    coarseClock_(false)
 {
 }
 
@@ -12,3 +15,23 @@ Poller::~Poller()
 {
 }
 
+
+void Poller::startRecv(Channel*)
+{
+  LOG_FATAL << "Poller::startRecv() completion I/O not supported";
+}
+
+void Poller::stopRecv(Channel*)
+{
+  LOG_FATAL << "Poller::stopRecv() completion I/O not supported";
+}
+
+void Poller::sendAsync(Channel*, const struct msghdr*)
+{
+  LOG_FATAL << "Poller::sendAsync() completion I/O not supported";
+}
+
+void Poller::cancelSend(Channel*)
+{
+  LOG_FATAL << "Poller::cancelSend() completion I/O not supported";
+}
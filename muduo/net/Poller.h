@@ -7,6 +7,8 @@
 #include <muduo/base/Timestamp.h>
 #include <muduo/net/EventLoop.h>
 
+struct msghdr;
+
 namespace muduo
 {
     namespace net
@@ -35,13 +37,35 @@ namespace muduo
 
             static Poller *newDefaultPoller(EventLoop *loop);
 
+            /// Whether Channel::pollEvents() flags like EPOLLET are honored.
+            virtual bool supportsEdgeTriggered() const { return false; }
+
+            /// Completion-based socket I/O, see Channel::startRecv(). Only IoUringPoller supports it,
+            /// the others abort.
+            virtual bool supportsCompletionIo() const { return false; }
+            virtual void startRecv(Channel *channel);
+            virtual void stopRecv(Channel *channel);
+            virtual void sendAsync(Channel *channel, const struct msghdr *msg);
+            virtual void cancelSend(Channel *channel);
+
             void assertInLoopThread()
             {
                 ownerLoop_->assertInLoopThread();
             }
 
+            // poll()返回的时刻改用Timestamp::nowCoarse(), 见EventLoop::setCoarseClock()
+            void setCoarseClock(bool on) { coarseClock_ = on; }
+
+        protected:
+            // poll()返回之后读一次时钟, EventLoop把它缓存为本轮的now()
+            Timestamp currentTime() const
+            {
+                return coarseClock_ ? Timestamp::nowCoarse() : Timestamp::now();
+            }
+
         private:
             EventLoop *ownerLoop_; // Poller所属的EventLoop
+            bool coarseClock_;
         };
 
     } // namespace net
@@ -0,0 +1,63 @@
+#ifndef MUDUO_NET_SLICE_H
+#define MUDUO_NET_SLICE_H
+
+#include <muduo/base/copyable.h>
+#include <muduo/base/Types.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <assert.h>
+
+namespace muduo
+{
+    namespace net
+    {
+        // 一段不可变内存的引用, 通过引用计数(owner_)保证内存在发送完之前有效.
+        // 同一块数据可以send()给很多连接而不用拷贝到各自的outputBuffer_中, 适合广播和重复的大响应.
+        // 发送期间不能修改底层的数据.
+        class Slice : public muduo::copyable
+        {
+        public:
+            Slice()
+                : data_(NULL),
+                  len_(0)
+            {
+            }
+
+            // 引用整个字符串
+            explicit Slice(const boost::shared_ptr<const string> &str)
+                : owner_(str),
+                  data_(str->data()),
+                  len_(str->size())
+            {
+            }
+
+            // owner负责[data, data + len)的生命周期
+            Slice(const boost::shared_ptr<const void> &owner, const char *data, size_t len)
+                : owner_(owner),
+                  data_(data),
+                  len_(len)
+            {
+            }
+
+            const char *data() const { return data_; }
+            size_t size() const { return len_; }
+            bool empty() const { return len_ == 0; }
+
+            // 共享同一个owner的一段子区间
+            Slice slice(size_t offset, size_t len) const
+            {
+                assert(offset + len <= len_);
+                return Slice(owner_, data_ + offset, len);
+            }
+
+        private:
+            boost::shared_ptr<const void> owner_;
+            const char *data_;
+            size_t len_;
+        };
+
+    } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_SLICE_H
@@ -48,6 +48,13 @@ void Socket::setTcpNoDelay(bool on)
     // FIXME CHECK
 }
 
+void Socket::setTcpCork(bool on)
+{
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, IPPROTO_TCP, TCP_CORK, &optval, sizeof optval);
+    // FIXME CHECK
+}
+
 void Socket::setReuseAddr(bool on)
 {
     int optval = on ? 1 : 0;
@@ -55,9 +62,26 @@ void Socket::setReuseAddr(bool on)
     // FIXME CHECK
 }
 
+bool Socket::setReusePort(bool on)
+{
+    int optval = on ? 1 : 0;
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof optval) == 0;
+}
+
 void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
     // FIXME CHECK
 }
+
+bool Socket::setBusyPoll(int usec)
+{
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof usec) == 0;
+}
+
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on ? 1 : 0;
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof optval) == 0;
+}
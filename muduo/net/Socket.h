@@ -47,12 +47,36 @@ namespace muduo
             ///
             void setReuseAddr(bool on);
 
+            ///
+            /// Enable/disable SO_REUSEPORT, returns false on failure (errno is set)
+            ///
+            // 多个socket可以bind同一个地址, 内核按四元组的哈希把新连接分给其中一个listen的socket.
+            bool setReusePort(bool on);
+
             ///
             /// Enable/disable SO_KEEPALIVE
             ///
             // TCP keepalive是指定期探测连接是否存在, 如果应用层有心跳的话, 这个选项不是必需要设置的.
             void setKeepAlive(bool on);
 
+            ///
+            /// Enable/disable SO_ZEROCOPY, returns false on failure (errno is set)
+            ///
+            // 开启之后才能用MSG_ZEROCOPY发送, 见TcpConnection::setZeroCopy().
+            bool setZeroCopy(bool on);
+
+            ///
+            /// Enable/disable TCP_CORK
+            ///
+            // 开启之后内核只发送满的报文段, 关闭时把剩下的一次发出去.
+            void setTcpCork(bool on);
+
+            ///
+            /// Set SO_BUSY_POLL, returns false on failure (errno is set)
+            ///
+            // 阻塞读和poll时, 没有数据的情况下内核在设备队列上忙等usec微秒. 超过net.core.busy_read需要CAP_NET_ADMIN.
+            bool setBusyPoll(int usec);
+
         private:
             const int sockfd_;
         };
@@ -9,9 +9,11 @@
 #include <fcntl.h>
 #include <stdio.h>   // snprintf
 #include <strings.h> // bzero
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <sys/uio.h> // readv
+#include <linux/errqueue.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -101,7 +103,10 @@ int sockets::accept(int sockfd, struct sockaddr_in *addr)
     if (connfd < 0)
     {
         int savedErrno = errno;
-        LOG_SYSERR << "Socket::accept"; // 可能会改变errno的值, 所以上一行先保存了.
+        if (savedErrno != EAGAIN) // Acceptor一直accept到EAGAIN为止, 这是正常的结束
+        {
+            LOG_SYSERR << "Socket::accept"; // 可能会改变errno的值, 所以上一行先保存了.
+        }
         switch (savedErrno)
         {
         case EAGAIN:
@@ -155,6 +160,58 @@ ssize_t sockets::write(int sockfd, const void *buf, size_t count)
     return ::write(sockfd, buf, count);
 }
 
+// 把多个缓冲区的数据一次写出, 用于Buffer::writeFd()
+ssize_t sockets::writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+    return ::writev(sockfd, iov, iovcnt);
+}
+
+// 内核直接引用buf所在的页面发送, 发送完成之后通过错误队列通知, 在此之前buf不能修改或释放.
+ssize_t sockets::sendZeroCopy(int sockfd, const void *buf, size_t count)
+{
+    return ::send(sockfd, buf, count, MSG_ZEROCOPY);
+}
+
+// 完成通知中的[ee_info, ee_data]是完成的send调用的序号区间, 每个socket上成功的MSG_ZEROCOPY调用从0开始编号.
+// 内核退化成拷贝时(比如loopback)会设置SO_EE_CODE_ZEROCOPY_COPIED.
+int sockets::readZeroCopyCompletion(int sockfd, uint32_t *lo, uint32_t *hi, bool *copied)
+{
+    char control[128];
+    struct msghdr msg;
+    bzero(&msg, sizeof msg);
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    if (::recvmsg(sockfd, &msg, MSG_ERRQUEUE) < 0)
+    {
+        return -1;
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+    {
+        if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+        {
+            struct sock_extended_err serr;
+            ::memcpy(&serr, CMSG_DATA(cm), sizeof serr);
+            if (serr.ee_errno == 0 && serr.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+            {
+                *lo = serr.ee_info;
+                *hi = serr.ee_data;
+                *copied = (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// 文件内容直接在内核中拷贝到socket, 不经过用户态, 用于TcpConnection::sendFile()
+ssize_t sockets::sendfile(int sockfd, int fileFd, off_t *offset, size_t count)
+{
+    return ::sendfile(sockfd, fileFd, offset, count);
+}
+
 void sockets::close(int sockfd)
 {
     if (::close(sockfd) < 0)
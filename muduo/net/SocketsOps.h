@@ -21,6 +21,15 @@ namespace muduo
             ssize_t read(int sockfd, void *buf, size_t count);
             ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
             ssize_t write(int sockfd, const void *buf, size_t count);
+            ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt);
+            ssize_t sendfile(int sockfd, int fileFd, off_t *offset, size_t count);
+            ssize_t sendZeroCopy(int sockfd, const void *buf, size_t count);
+
+            ///
+            /// Reads one message from the error queue (MSG_ERRQUEUE).
+            /// @return 1 for a MSG_ZEROCOPY completion of sends [*lo, *hi],
+            ///         0 for other messages, -1 if the queue is empty or on error.
+            int readZeroCopyCompletion(int sockfd, uint32_t *lo, uint32_t *hi, bool *copied);
             void close(int sockfd);
             void shutdownWrite(int sockfd);
 
@@ -8,11 +8,51 @@
 #include <boost/bind.hpp>
 
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
+#include <strings.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+    // 连续模式的缓冲区长大之后不会自己变小. 数据取空时, 如果占用的内存超过这个值(以及2倍的keep), 就收缩回初始大小.
+    // 池化模式下数据取空时chunk已经还给了pool, 不需要收缩.
+    const size_t kShrinkThreshold = 64 * 1024;
+
+    void shrinkIfDrained(Buffer *buf, size_t keep = 0)
+    {
+        if (!buf->segmented() && buf->readableBytes() == 0 &&
+            buf->internalCapacity() > std::max(kShrinkThreshold, 2 * keep))
+        {
+            buf->shrink(0);
+        }
+    }
+
+    // handleRead()直接读进inputBuffer_的字节数(readHint_)的范围
+    const size_t kMinReadHint = Buffer::kInitialSize;
+    const size_t kMaxReadHint = 256 * 1024;
+
+    // 边沿触发时没有设置readBudget_, 每个事件最多读/写这么多字节, 剩下的排到本轮事件之后, 免得饿死同一个loop上的其他连接
+    const size_t kEdgeTriggeredBudget = 1024 * 1024;
+
+    // Slice没发送完的部分小于这个值时直接拷贝进outputBuffer_, 免得iovec太碎
+    const size_t kMinQueuedSlice = 1024;
+
+    // 完成式IO没有sendfile, 每次send之前最多从文件读这么多字节到outputBuffer_
+    const size_t kFileCopyChunk = 64 * 1024;
+
+    // sendFile()中dup出来的fd, 不再被outputQueue_引用时关闭
+    void closeFile(const int *fd)
+    {
+        sockets::close(*fd);
+        delete fd;
+    }
+} // namespace
+
 // 在TcpServer的构造函数中使用
 void muduo::net::defaultConnectionCallback(const TcpConnectionPtr &conn)
 {
@@ -41,8 +81,33 @@ TcpConnection::TcpConnection(EventLoop *loop,
       channel_(new Channel(loop, sockfd)),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024)
+      highWaterMark_(64 * 1024 * 1024),
+      readHint_(kMinReadHint),
+      readBudget_(0),
+      deferFlush_(false),
+      corkOnFlush_(false),
+      flushQueued_(false),
+      corked_(false),
+      readPauses_(0),
+      inputHighWaterMark_(0),
+      upstreamPaused_(false),
+      inputBuffer_(loop->bufferPool()), // 没有开启BufferPool时就是普通的Buffer
+      outputBuffer_(loop->bufferPool()),
+      queuedBytes_(0),
+      completionIo_(false),
+      sendInFlight_(false),
+      pausedInput_(false),
+      inflightBuffer_(loop->bufferPool()),
+      zeroCopyMinBytes_(0),
+      socketZeroCopy_(false),
+      zeroCopySeq_(0)
 {
+    bzero(&sendMsg_, sizeof sendMsg_);
+    sendMsg_.msg_iov = sendIov_;
+
+    stats_.name = name_;
+    stats_.creationTime = Timestamp::now();
+
     // channel可读事件到来的时候, 回调TcpConnection::handleRead, _1是事件发生时间
     channel_->setReadCallback(boost::bind(&TcpConnection::handleRead, this, _1));
 
@@ -54,10 +119,18 @@ TcpConnection::TcpConnection(EventLoop *loop,
     // 发生错误, 回调TcpConnection::handleError
     channel_->setErrorCallback(boost::bind(&TcpConnection::handleError, this));
 
+    // 完成式IO的recv/send完成, 见setCompletionIo()
+    channel_->setRecvCallback(boost::bind(&TcpConnection::handleRecv, this, _1, _2, _3));
+    channel_->setSendCallback(boost::bind(&TcpConnection::handleSendComplete, this, _1));
+
     LOG_DEBUG << "TcpConnection::ctor[" << name_ << "] at " << this
               << " fd=" << sockfd;
 
     socket_->setKeepAlive(true);
+    if (loop->socketBusyPoll() > 0 && !socket_->setBusyPoll(loop->socketBusyPoll()))
+    {
+        LOG_SYSERR << "TcpConnection::ctor[" << name_ << "] setBusyPoll";
+    }
 }
 
 TcpConnection::~TcpConnection()
@@ -77,7 +150,7 @@ void TcpConnection::send(const void *data, size_t len)
         else
         {
             string message(static_cast<const char *>(data), len);
-            loop_->runInLoop(boost::bind(&TcpConnection::sendInLoop, this, message));
+            sendOwnedString(&message);
         }
     }
 }
@@ -92,11 +165,8 @@ void TcpConnection::send(const StringPiece &message)
         }
         else
         {
-            loop_->runInLoop(
-                boost::bind(&TcpConnection::sendInLoop,
-                            this,                  // FIXME
-                            message.as_string())); // 把message这块内存复制到IO线程, 有开销.
-            // std::forward<string>(message)));
+            string copy(message.as_string()); // 调用者还持有message, 只能复制一次
+            sendOwnedString(&copy);
         }
     }
 }
@@ -113,11 +183,129 @@ void TcpConnection::send(Buffer *buf)
         }
         else
         {
-            loop_->runInLoop(
-                boost::bind(&TcpConnection::sendInLoop,
-                            this, // FIXME
-                            buf->retrieveAllAsString()));
-            // std::forward<string>(message)));
+            sendOwnedBuffer(buf);
+        }
+    }
+}
+
+#ifdef __GXX_EXPERIMENTAL_CXX0X__
+void TcpConnection::send(string &&message)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(message);
+            message.clear();
+        }
+        else
+        {
+            sendOwnedString(&message);
+        }
+    }
+}
+
+void TcpConnection::send(Buffer &&message)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(message.peek(), message.readableBytes());
+            message.retrieveAll();
+        }
+        else
+        {
+            sendOwnedBuffer(&message);
+        }
+    }
+}
+#endif
+
+// 跨线程发送: 把*message的内容swap到堆上, 作为Slice交给IO线程.
+// 绑定进functor的只是引用计数, 数据本身不会在functor的复制中被拷贝, 没发送完的部分也不用再拷贝进outputBuffer_.
+void TcpConnection::sendOwnedString(string *message)
+{
+    boost::shared_ptr<string> owned(new string);
+    owned->swap(*message);
+    loop_->runInLoop(boost::bind(&TcpConnection::sendSliceInLoop, this, // FIXME
+                                 Slice(owned), SendCompleteCallback()));
+}
+
+void TcpConnection::sendOwnedBuffer(Buffer *message)
+{
+    if (message->pool() != NULL) // 池化的chunk只能在所属的IO线程中归还, 不能swap走
+    {
+        string copy(message->retrieveAllAsString());
+        sendOwnedString(&copy);
+        return;
+    }
+
+    boost::shared_ptr<Buffer> owned(new Buffer);
+    owned->swap(*message);
+    const char *data = owned->peek(); // 分段模式下会合并成连续内存, 之后不再修改owned
+    Slice slice(owned, data, owned->readableBytes());
+    loop_->runInLoop(boost::bind(&TcpConnection::sendSliceInLoop, this, // FIXME
+                                 slice, SendCompleteCallback()));
+}
+
+// 线程安全, 跨线程时只拷贝Slice本身(引用计数), 不拷贝数据.
+void TcpConnection::send(const Slice &message)
+{
+    send(message, SendCompleteCallback());
+}
+
+void TcpConnection::send(const Slice &message, const SendCompleteCallback &cb)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendSliceInLoop(message, cb);
+        }
+        else
+        {
+            loop_->runInLoop(boost::bind(&TcpConnection::sendSliceInLoop, this, message, cb)); // FIXME
+        }
+    }
+}
+
+bool TcpConnection::setZeroCopy(size_t minBytes)
+{
+    assert(state_ == kConnecting || loop_->isInLoopThread());
+    if (minBytes > 0 && !socketZeroCopy_)
+    {
+        if (!socket_->setZeroCopy(true))
+        {
+            LOG_SYSERR << "TcpConnection::setZeroCopy [" << name_ << "]";
+            return false;
+        }
+        socketZeroCopy_ = true;
+    }
+    zeroCopyMinBytes_ = minBytes;
+    return true;
+}
+
+// dup()在调用者的线程中完成, 调用返回之后fd就可以关闭了.
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+    if (state_ == kConnected && length > 0)
+    {
+        int fileFd = ::dup(fd);
+        if (fileFd < 0)
+        {
+            LOG_SYSERR << "TcpConnection::sendFile";
+            return;
+        }
+        boost::shared_ptr<const int> file(new int(fileFd), closeFile);
+
+        if (loop_->isInLoopThread())
+        {
+            sendFileInLoop(file, offset, length);
+        }
+        else
+        {
+            loop_->runInLoop(boost::bind(&TcpConnection::sendFileInLoop, this, file, offset, length)); // FIXME
         }
     }
 }
@@ -138,186 +326,1064 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
     }
 
     ssize_t nwrote = 0;
-    size_t remaining = len;
     bool error = false;
 
-    // channel_没有关注可写事件, 并且outputBuffer_没有数据, 直接write
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // channel_没有关注可写事件, 并且没有待发送的数据, 直接write. 延迟发送时先攒起来, 完成式IO总是交给submitOutput().
+    if (!deferFlush_ && !completionIo_ && !channel_->isWriting() && outputBytes() == 0)
+    {
+        nwrote = writeDirectly(data, len, &error);
+    }
+
+    // 还有未写完的数据, 说明内核发送缓冲区满了, 要将未写完的数据添加到outputBuffer_中.
+    size_t remaining = len - nwrote;
+    if (!error && remaining > 0)
     {
-        nwrote = sockets::write(channel_->fd(), data, len);
-        if (nwrote >= 0)
+        LOG_TRACE << "I am going to write more data";
+        checkHighWaterMark(remaining);
+
+        if (completionIo_ && !outputQueue_.empty()) // 排在还没读完的文件后面, 见refillOutput()
         {
-            remaining = len - nwrote;
-            // 写完了, 回调writeCompleteCallback_
-            if (remaining == 0 && writeCompleteCallback_)
-            {
-                loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
-            }
+            boost::shared_ptr<string> copy(new string(static_cast<const char *>(data) + nwrote, remaining));
+            outputQueue_.push_back(OutputChunk(Slice(copy), false, SendCompleteCallback()));
+            queuedBytes_ += remaining;
         }
-        else // 报错
+        else
         {
-            nwrote = 0;
-            if (errno != EWOULDBLOCK)
+            outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining);
+            if (!outputQueue_.empty())
             {
-                LOG_SYSERR << "TcpConnection::sendInLoop";
-                if (errno == EPIPE) // FIXME: any others?
-                {
-                    error = true;
-                }
+                queueBuffered(remaining);
             }
         }
+        if (deferFlush_)
+        {
+            scheduleFlush();
+        }
+        else if (completionIo_)
+        {
+            submitOutput();
+        }
+        else if (!channel_->isWriting())
+        {
+            channel_->enableWriting(); // 关注POLLOUT事件
+        }
     }
+}
 
-    // 还有未写完的数据, 说明内核发送缓冲区满了, 要将未写完的数据添加到outputBuffer_中.
-    assert(remaining <= len);
-    if (!error && remaining > 0)
+// 和sendInLoop()一样, 只是剩余的部分以Slice的形式排进outputQueue_, 不拷贝.
+// 开启了零拷贝时, 足够大的Slice总是排进outputQueue_, 由handleWrite()用MSG_ZEROCOPY发送.
+void TcpConnection::sendSliceInLoop(const Slice &message, const SendCompleteCallback &cb)
+{
+    loop_->assertInLoopThread();
+    if (state_ == kDisconnected)
     {
-        LOG_TRACE << "I am going to write more data";
-        size_t oldLen = outputBuffer_.readableBytes();
-        // 如果超过highWaterMark_(高水位标), 回调highWaterMarkCallback_
-        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+
+    if (completionIo_) // 只从outputBuffer_发送, Slice也拷贝进去
+    {
+        sendInLoop(message.data(), message.size());
+        if (cb)
         {
-            loop_->queueInLoop(boost::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+            loop_->queueInLoop(boost::bind(cb, shared_from_this(), false));
         }
+        return;
+    }
 
-        outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining);
-        if (!channel_->isWriting())
+    bool zeroCopy = zeroCopyMinBytes_ > 0 && message.size() >= zeroCopyMinBytes_;
+    if (zeroCopy || deferFlush_)
+    {
+        checkHighWaterMark(message.size());
+        if (outputQueue_.empty() && outputBuffer_.readableBytes() > 0)
         {
-            channel_->enableWriting(); // 关注POLLOUT事件
+            queueBuffered(outputBuffer_.readableBytes());
+        }
+        outputQueue_.push_back(OutputChunk(message, zeroCopy, cb));
+        queuedBytes_ += message.size();
+        if (deferFlush_)
+        {
+            scheduleFlush();
         }
+        else if (!channel_->isWriting())
+        {
+            channel_->enableWriting();
+            handleWrite();
+        }
+        return;
     }
-}
 
-// 1. outputBuffer_ 中没有数据等待发送, 直接关闭写端.
-// 2. outputBuffer_ 中有数据等待发送, 则设置状态为 kDisconnecting, 并没有关闭. 当 outputBuffer_ 中的数据发送完毕, 就会调用shutdownInLoop()来关闭, 见 handleWrite().
-// 3. 关闭写端后, 客户端read()就返回0, 客户端一般都会close(cfd), 此时服务端的cfd可读(POLLIN | POLLHUP), 就会触发channel的可读事件, 调用Channel的closeCallback_关闭连接. 见Channel::handleEventWithGuard().
-void TcpConnection::shutdown()
-{
-    // FIXME: use compare and swap
-    if (state_ == kConnected)
+    ssize_t nwrote = 0;
+    bool error = false;
+
+    if (!channel_->isWriting() && outputBytes() == 0)
     {
-        setState(kDisconnecting);
-        // FIXME: shared_from_this()
-        loop_->runInLoop(boost::bind(&TcpConnection::shutdownInLoop, this));
+        nwrote = writeDirectly(message.data(), message.size(), &error);
+    }
+
+    size_t remaining = message.size() - nwrote;
+    if (!error && remaining > 0)
+    {
+        if (remaining < kMinQueuedSlice)
+        {
+            sendInLoop(message.data() + nwrote, remaining);
+        }
+        else
+        {
+            LOG_TRACE << "I am going to write more data";
+            checkHighWaterMark(remaining);
+
+            if (outputQueue_.empty() && outputBuffer_.readableBytes() > 0)
+            {
+                queueBuffered(outputBuffer_.readableBytes()); // 之前拷贝的数据排在前面
+            }
+            outputQueue_.push_back(OutputChunk(message.slice(nwrote, remaining), false, cb));
+            queuedBytes_ += remaining;
+            if (!channel_->isWriting())
+            {
+                channel_->enableWriting();
+            }
+            return; // 发送完毕时由retrieveOutput()回调cb
+        }
+    }
+
+    if (!error && cb) // 数据已经写进内核或者拷贝进了outputBuffer_
+    {
+        loop_->queueInLoop(boost::bind(cb, shared_from_this(), false));
     }
 }
 
-void TcpConnection::shutdownInLoop()
+// 文件总是排进outputQueue_, 由handleWrite()调用sendfile发送. 延迟发送时和其他数据一样等到本轮事件处理结束.
+void TcpConnection::sendFileInLoop(const boost::shared_ptr<const int> &file, off_t offset, size_t length)
 {
     loop_->assertInLoopThread();
+    if (state_ == kDisconnected)
+    {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
 
-    if (!channel_->isWriting()) // 正在发送数据, 即channel关注了write事件, output buffer中有数据没有发送完毕.
+    checkHighWaterMark(length);
+    if (!completionIo_ && outputQueue_.empty() && outputBuffer_.readableBytes() > 0)
     {
-        socket_->shutdownWrite();
+        queueBuffered(outputBuffer_.readableBytes());
+    }
+    outputQueue_.push_back(OutputChunk(file, offset, length));
+    queuedBytes_ += length;
+
+    if (deferFlush_)
+    {
+        scheduleFlush();
+    }
+    else if (completionIo_) // outputBuffer_中的数据都在文件前面, 由refillOutput()一块一块地读
+    {
+        submitOutput();
+    }
+    else if (!channel_->isWriting())
+    {
+        channel_->enableWriting();
+        handleWrite(); // 前面没有待发送的数据, 马上发送, 不必等下一次poll
     }
 }
 
-void TcpConnection::setTcpNoDelay(bool on)
+// 没有待发送的数据时直接write, 返回写出的字节数. 出错返回0, 对方已经关闭时设置*error.
+ssize_t TcpConnection::writeDirectly(const void *data, size_t len, bool *error)
 {
-    socket_->setTcpNoDelay(on);
+    ssize_t nwrote = sockets::write(channel_->fd(), data, len);
+    if (nwrote >= 0)
+    {
+        countWrite(nwrote);
+        // 写完了, 回调writeCompleteCallback_
+        if (implicit_cast<size_t>(nwrote) == len && writeCompleteCallback_)
+        {
+            loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+        }
+    }
+    else // 报错
+    {
+        nwrote = 0;
+        if (errno != EWOULDBLOCK)
+        {
+            LOG_SYSERR << "TcpConnection::sendInLoop";
+            if (errno == EPIPE) // FIXME: any others?
+            {
+                *error = true;
+            }
+        }
+    }
+    return nwrote;
 }
 
-// 关注channel的写事件, 并执行用户的回调函数
-// 调用: TcpServer/TcpClient的newConnection()
-void TcpConnection::connectEstablished()
+// 统计一次读, 同时计入连接和所属loop的统计
+void TcpConnection::countRead(size_t n, Timestamp receiveTime)
 {
-    loop_->assertInLoopThread();
-    assert(state_ == kConnecting);
-
-    setState(kConnected);
-    channel_->tie(shared_from_this());
-    channel_->enableReading(); // TcpConnection所对应的channel加入到Poller关注
-
-    connectionCallback_(shared_from_this()); // connectionCallback_: 用户的回调函数
+    LoopStats *loopStats = loop_->loopStats();
+    ++stats_.reads;
+    ++loopStats->reads;
+    stats_.bytesReceived += n;
+    loopStats->bytesReceived += n;
+    stats_.lastReceiveTime = receiveTime;
 }
 
-// 销毁一个TcpConnection最后要调用的函数.
-// 在TcpServer::removeConnectionInLoop()中被调用
-void TcpConnection::connectDestroyed()
+// 统计一次写, 同上. n为0时不算
+void TcpConnection::countWrite(size_t n)
 {
-    loop_->assertInLoopThread();
-
-    if (state_ == kConnected) // 不会成立, 因为在 handleClose()中已经设置为kDisconnected, 而该函数的触发肯定要调用 handleClose()的.
+    if (n == 0)
     {
-        setState(kDisconnected);
-        channel_->disableAll();
-
-        connectionCallback_(shared_from_this());
+        return;
     }
-
-    channel_->remove(); // // 从 loop_中移除该 channel
+    LoopStats *loopStats = loop_->loopStats();
+    ++stats_.writes;
+    ++loopStats->writes;
+    stats_.bytesSent += n;
+    loopStats->bytesSent += n;
+    stats_.lastSendTime = loop_->pollReturnTime(); // 不为了统计再调用一次gettimeofday
 }
 
-// 内部会检查read()的返回值, 并根据返回值分别调用messageCallback_(), handleClose(), handleError().
-void TcpConnection::handleRead(Timestamp receiveTime)
+// 如果待发送的数据超过highWaterMark_(高水位标), 回调highWaterMarkCallback_
+void TcpConnection::checkHighWaterMark(size_t remaining)
 {
-    loop_->assertInLoopThread();
-
-    int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-    if (n > 0)
+    size_t oldLen = outputBytes();
+    stats_.peakOutputBytes = std::max(stats_.peakOutputBytes, oldLen + remaining);
+    if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_)
     {
-        // shared_from_this(): 把this转化为share_prt
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        ++stats_.highWaterMarkHits;
+        ++loop_->loopStats()->highWaterMarkHits;
+        if (highWaterMarkCallback_)
+        {
+            loop_->queueInLoop(boost::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+        }
+        if (!upstreamPaused_)
+        {
+            throttleUpstream(true);
+        }
     }
-    else if (n == 0)
+}
+
+// outputBuffer_中新追加了len个字节, 记到outputQueue_的末尾
+void TcpConnection::queueBuffered(size_t len)
+{
+    if (!outputQueue_.empty() && outputQueue_.back().type == OutputChunk::kBuffered)
     {
-        handleClose(); // 处理连接断开
+        outputQueue_.back().len += len;
     }
     else
     {
-        errno = savedErrno;
-        LOG_SYSERR << "TcpConnection::handleRead";
-        handleError();
+        outputQueue_.push_back(OutputChunk(len));
     }
 }
 
-// 内核发送缓冲区有空间了, 回调该函数
-void TcpConnection::handleWrite()
+// 把outputQueue_中的数据用一次writev()写出, 最多IOV_MAX段, 遇到文件为止.
+// 队列头部是文件时, 用sendfile发送这个文件.
+ssize_t TcpConnection::writeOutputQueue(int *savedErrno)
 {
-    loop_->assertInLoopThread();
+    if (outputQueue_.front().type == OutputChunk::kFile)
+    {
+        return sendFileChunk(savedErrno);
+    }
+    if (outputQueue_.front().zeroCopy)
+    {
+        return sendZeroCopyChunk(savedErrno);
+    }
 
-    if (channel_->isWriting())
+    struct iovec vec[IOV_MAX];
+    int cnt = 0;
+    size_t bufferOffset = 0; // kBuffered在outputBuffer_中的位置
+    for (std::deque<OutputChunk>::const_iterator it = outputQueue_.begin();
+         it != outputQueue_.end() && it->type != OutputChunk::kFile && !it->zeroCopy && cnt < IOV_MAX; ++it)
     {
-        ssize_t n = sockets::write(channel_->fd(), outputBuffer_.peek(), outputBuffer_.readableBytes());
-        if (n > 0)
+        if (it->type == OutputChunk::kBuffered)
         {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0) // outputBuffer_中数据全部发送完毕: 1) channel取消EPOLLOUT事件; 2) 调用writeCompleteCallback_.
-            {
-                channel_->disableWriting(); //  1) channel取消EPOLLOUT事件, 以免出现 busy loop
-                if (writeCompleteCallback_)
-                {
-                    // 应用层发送缓冲区被清空, 就回调用writeCompleteCallback_
-                    loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
-                }
-
-                if (state_ == kDisconnecting) // 在send()时调用过shutdown().
-                {
-                    shutdownInLoop();
-                }
-            }
-            else // 还有数据没有发送完
-            {
-                LOG_TRACE << "I am going to write more data";
-            }
+            cnt += outputBuffer_.readableIovecs(bufferOffset, it->len, vec + cnt, IOV_MAX - cnt);
+            bufferOffset += it->len;
         }
         else
         {
-            LOG_SYSERR << "TcpConnection::handleWrite";
-            // if (state_ == kDisconnecting)
-            // {
-            //   shutdownInLoop();
-            // }
+            vec[cnt].iov_base = const_cast<char *>(it->slice.data() + it->offset);
+            vec[cnt].iov_len = it->len;
+            ++cnt;
         }
     }
-    else
+
+    ssize_t n = sockets::writev(channel_->fd(), vec, cnt);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    else
+    {
+        retrieveOutput(n);
+    }
+    return n;
+}
+
+ssize_t TcpConnection::sendFileChunk(int *savedErrno)
+{
+    OutputChunk &chunk = outputQueue_.front();
+    off_t offset = static_cast<off_t>(chunk.offset);
+    ssize_t n = sockets::sendfile(channel_->fd(), *chunk.file, &offset, chunk.len);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    else if (n == 0) // 文件比预期的短, 剩下的部分无法发送了, 丢掉
+    {
+        LOG_ERROR << "TcpConnection::sendFileChunk [" << name_ << "] - file truncated, "
+                  << chunk.len << " bytes dropped";
+        queuedBytes_ -= chunk.len;
+        outputQueue_.pop_front();
+    }
+    else
+    {
+        retrieveOutput(n);
+    }
+    return n;
+}
+
+// 用MSG_ZEROCOPY发送队列头部的Slice, 发送出去的部分在zeroCopyPending_中等待完成通知.
+ssize_t TcpConnection::sendZeroCopyChunk(int *savedErrno)
+{
+    OutputChunk &chunk = outputQueue_.front();
+    const char *data = chunk.slice.data() + chunk.offset;
+    bool copied = false;
+    ssize_t n = sockets::sendZeroCopy(channel_->fd(), data, chunk.len);
+    if (n < 0 && errno == ENOBUFS) // 超出了optmem的限制, 这一次退回普通的write
+    {
+        n = sockets::write(channel_->fd(), data, chunk.len);
+        copied = true;
+    }
+
+    if (n < 0)
+    {
+        *savedErrno = errno;
+        return n;
+    }
+
+    ZeroCopyPending pending;
+    pending.seq = copied ? 0 : zeroCopySeq_++;
+    pending.pin = chunk.slice;
+    pending.completed = copied;
+    pending.copied = copied;
+    if (implicit_cast<size_t>(n) == chunk.len) // 整个Slice都发送出去了, 回调跟着最后一次send()
+    {
+        pending.done.swap(chunk.done);
+    }
+    zeroCopyPending_.push_back(pending);
+
+    retrieveOutput(n);
+    if (copied)
+    {
+        reapZeroCopy();
+    }
+    return n;
+}
+
+// 读取错误队列中所有的零拷贝完成通知. 错误队列不为空时poller会一直报告EPOLLERR, 所以要读到EAGAIN为止.
+void TcpConnection::handleZeroCopyCompletions()
+{
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+    bool copied = false;
+    int ret;
+    while ((ret = sockets::readZeroCopyCompletion(channel_->fd(), &lo, &hi, &copied)) >= 0)
+    {
+        if (ret == 0)
+        {
+            continue;
+        }
+        for (std::deque<ZeroCopyPending>::iterator it = zeroCopyPending_.begin();
+             it != zeroCopyPending_.end(); ++it)
+        {
+            if (!it->completed && it->seq - lo <= hi - lo) // 编号会回绕, 用无符号减法判断区间
+            {
+                it->completed = true;
+                it->copied = copied;
+            }
+        }
+    }
+    reapZeroCopy();
+}
+
+// 按发送顺序释放已经完成的Slice, 回调SendCompleteCallback
+void TcpConnection::reapZeroCopy()
+{
+    while (!zeroCopyPending_.empty() && zeroCopyPending_.front().completed)
+    {
+        ZeroCopyPending &pending = zeroCopyPending_.front();
+        if (pending.done)
+        {
+            loop_->queueInLoop(boost::bind(pending.done, shared_from_this(), !pending.copied));
+        }
+        zeroCopyPending_.pop_front();
+    }
+}
+
+// 从outputQueue_的头部取走len个已经发送的字节, 发送完的Slice和文件就此释放.
+void TcpConnection::retrieveOutput(size_t len)
+{
+    while (len > 0)
+    {
+        assert(!outputQueue_.empty());
+        OutputChunk &chunk = outputQueue_.front();
+        size_t n = std::min(len, chunk.len);
+        if (chunk.type == OutputChunk::kBuffered)
+        {
+            outputBuffer_.retrieve(n);
+        }
+        else
+        {
+            chunk.offset += n;
+            queuedBytes_ -= n;
+        }
+        chunk.len -= n;
+        len -= n;
+        if (chunk.len == 0)
+        {
+            if (chunk.done)
+            {
+                loop_->queueInLoop(boost::bind(chunk.done, shared_from_this(), false));
+            }
+            outputQueue_.pop_front();
+        }
+    }
+}
+
+// 1. outputBuffer_ 中没有数据等待发送, 直接关闭写端.
+// 2. outputBuffer_ 中有数据等待发送, 则设置状态为 kDisconnecting, 并没有关闭. 当 outputBuffer_ 中的数据发送完毕, 就会调用shutdownInLoop()来关闭, 见 handleWrite().
+// 3. 关闭写端后, 客户端read()就返回0, 客户端一般都会close(cfd), 此时服务端的cfd可读(POLLIN | POLLHUP), 就会触发channel的可读事件, 调用Channel的closeCallback_关闭连接. 见Channel::handleEventWithGuard().
+void TcpConnection::shutdown()
+{
+    // FIXME: use compare and swap
+    if (state_ == kConnected)
+    {
+        setState(kDisconnecting);
+        // FIXME: shared_from_this()
+        loop_->runInLoop(boost::bind(&TcpConnection::shutdownInLoop, this));
+    }
+}
+
+void TcpConnection::setDeferredFlush(bool on, bool cork)
+{
+    assert(state_ == kConnecting || loop_->isInLoopThread());
+    deferFlush_ = on;
+    corkOnFlush_ = on && cork;
+}
+
+// 每轮事件循环只queueFlush()一次
+void TcpConnection::scheduleFlush()
+{
+    if (corkOnFlush_ && !corked_)
+    {
+        socket_->setTcpCork(true);
+        corked_ = true;
+    }
+    if (!flushQueued_)
+    {
+        flushQueued_ = true;
+        loop_->queueFlush(boost::bind(&TcpConnection::flush, shared_from_this()));
+    }
+}
+
+// 本轮攒下的数据一次性写出去, 写不完的等POLLOUT
+void TcpConnection::flush()
+{
+    loop_->assertInLoopThread();
+    flushQueued_ = false;
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    if (!writing() && outputBytes() > 0)
+    {
+        if (completionIo_)
+        {
+            submitOutput();
+        }
+        else
+        {
+            channel_->enableWriting();
+            handleWrite();
+        }
+    }
+    else if (state_ == kDisconnecting && outputBytes() == 0) // 等flush的时候调用了shutdown()
+    {
+        shutdownInLoop();
+    }
+}
+
+void TcpConnection::forceClose()
+{
+    // FIXME: use compare and swap
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(boost::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    loop_->assertInLoopThread();
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        // as if we received 0 byte in handleRead();
+        handleClose();
+    }
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(boost::bind(&TcpConnection::pauseRead, this, kPausedByUser)); // FIXME
+}
+
+void TcpConnection::startRead()
+{
+    loop_->runInLoop(boost::bind(&TcpConnection::resumeRead, this, kPausedByUser)); // FIXME
+}
+
+void TcpConnection::setUpstream(const TcpConnectionPtr &upstream)
+{
+    loop_->assertInLoopThread();
+    if (upstreamPaused_) // 换了上游, 先放开原来的
+    {
+        throttleUpstream(false);
+    }
+    upstream_ = upstream;
+    if (outputBytes() >= highWaterMark_)
+    {
+        throttleUpstream(true);
+    }
+}
+
+void TcpConnection::pauseRead(int reason)
+{
+    loop_->assertInLoopThread();
+    readPauses_ |= reason;
+    if (completionIo_)
+    {
+        channel_->stopRecv(); // 已经收到的数据还会回调handleRecv(), 先攒在inputBuffer_中
+    }
+    else if (channel_->isReading())
+    {
+        channel_->disableReading();
+    }
+}
+
+void TcpConnection::resumeRead(int reason)
+{
+    loop_->assertInLoopThread();
+    readPauses_ &= ~reason;
+    // 连接建立之前不能加入poller, 由connectEstablished()负责
+    if (readPauses_ == 0 && (state_ == kConnected || state_ == kDisconnecting))
+    {
+        if (completionIo_)
+        {
+            channel_->startRecv();
+            if (pausedInput_)
+            {
+                pausedInput_ = false;
+                loop_->queueInLoop(boost::bind(&TcpConnection::deliverPausedInput, shared_from_this()));
+            }
+        }
+        else if (!channel_->isReading())
+        {
+            channel_->enableReading();
+        }
+    }
+}
+
+// 暂停期间每轮事件循环检查一次inputBuffer_, 用户在IO线程中取走数据之后就能在同一轮恢复读
+void TcpConnection::watchInput()
+{
+    if (!(readPauses_ & kPausedByInput) || state_ == kDisconnected)
+    {
+        return;
+    }
+    if (inputBuffer_.readableBytes() < inputHighWaterMark_ / 2)
+    {
+        resumeRead(kPausedByInput);
+    }
+    else
+    {
+        loop_->queueFlush(boost::bind(&TcpConnection::watchInput, shared_from_this()));
+    }
+}
+
+// upstream可能属于别的EventLoop
+void TcpConnection::throttleUpstream(bool pause)
+{
+    upstreamPaused_ = pause;
+    TcpConnectionPtr upstream(upstream_.lock());
+    if (upstream)
+    {
+        upstream->getLoop()->runInLoop(
+            boost::bind(pause ? &TcpConnection::pauseRead : &TcpConnection::resumeRead, upstream, kPausedByPeer));
+    }
+}
+
+void TcpConnection::shutdownInLoop()
+{
+    loop_->assertInLoopThread();
+
+    if (!writing() && !flushQueued_) // 正在发送数据, 即channel关注了write事件, output buffer中有数据没有发送完毕.
+    {
+        socket_->shutdownWrite();
+    }
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    socket_->setTcpNoDelay(on);
+}
+
+void TcpConnection::setSegmentedBuffers(size_t slabSize)
+{
+    assert(state_ == kConnecting || loop_->isInLoopThread());
+    inputBuffer_.enableSegments(slabSize);
+    outputBuffer_.enableSegments(slabSize);
+    inflightBuffer_.enableSegments(slabSize); // 和outputBuffer_交换, 模式要相同
+}
+
+bool TcpConnection::setCompletionIo(bool on)
+{
+    assert(state_ == kConnecting);
+    completionIo_ = on && loop_->supportsCompletionIo();
+    return completionIo_ == on;
+}
+
+bool TcpConnection::writing() const
+{
+    return completionIo_ ? sendInFlight_ : channel_->isWriting();
+}
+
+// 关注channel的写事件, 并执行用户的回调函数
+// 调用: TcpServer/TcpClient的newConnection()
+void TcpConnection::connectEstablished()
+{
+    loop_->assertInLoopThread();
+    assert(state_ == kConnecting);
+
+    setState(kConnected);
+    channel_->tie(shared_from_this());
+    loop_->addConnectionStats(&stats_);
+    if (completionIo_)
+    {
+        channel_->startRecv();
+        if (readPauses_ != 0)
+        {
+            channel_->stopRecv();
+        }
+    }
+    else
+    {
+        channel_->enableReading(); // TcpConnection所对应的channel加入到Poller关注
+        if (readPauses_ != 0)      // 建立之前就stopRead()了. 先加入poller, 以便connectDestroyed()时remove()
+        {
+            channel_->disableReading();
+        }
+    }
+
+    connectionCallback_(shared_from_this()); // connectionCallback_: 用户的回调函数
+}
+
+// 销毁一个TcpConnection最后要调用的函数.
+// 在TcpServer::removeConnectionInLoop()中被调用
+void TcpConnection::connectDestroyed()
+{
+    loop_->assertInLoopThread();
+
+    if (state_ == kConnected) // 不会成立, 因为在 handleClose()中已经设置为kDisconnected, 而该函数的触发肯定要调用 handleClose()的.
+    {
+        setState(kDisconnected);
+        channel_->disableAll();
+        channel_->stopRecv();
+
+        connectionCallback_(shared_from_this());
+    }
+
+    if (sendInFlight_) // 内核可能还在读inflightBuffer_, 取消之后等send完成再移除channel, 见handleSendComplete()
+    {
+        channel_->cancelSend();
+        self_ = shared_from_this();
+    }
+    else
+    {
+        channel_->remove(); // // 从 loop_中移除该 channel
+        inflightBuffer_.detachPool();
+    }
+    loop_->removeConnectionStats(&stats_);
+
+    outputQueue_.clear(); // 尽早释放没发送出去的Slice
+    queuedBytes_ = 0;
+    zeroCopyPending_.clear();
+
+    // TcpConnection可能在其他线程析构, 要在IO线程中把借用的chunk还给BufferPool.
+    inputBuffer_.detachPool();
+    outputBuffer_.detachPool();
+}
+
+bool TcpConnection::setEdgeTriggered(bool on)
+{
+    return channel_->setEdgeTriggered(on);
+}
+
+bool TcpConnection::edgeTriggered() const
+{
+    return channel_->edgeTriggered();
+}
+
+size_t TcpConnection::ioBudget() const
+{
+    if (readBudget_ > 0 || !channel_->edgeTriggered())
+    {
+        return readBudget_;
+    }
+    return kEdgeTriggeredBudget;
+}
+
+// 内部会检查read()的返回值, 并根据返回值分别调用messageCallback_(), handleClose(), handleError().
+// 默认每个可读事件只读一次. 设置了readBudget_时, 一直读到内核缓冲区读空或者读满readBudget_字节,
+// 然后只回调一次messageCallback_, 大流量的连接可以少几次epoll_wait, 又不会饿死同一个loop上的其他连接.
+// 边沿触发时必须读空, 读满预算还没读空的话排到本轮事件之后继续读.
+void TcpConnection::handleRead(Timestamp receiveTime)
+{
+    loop_->assertInLoopThread();
+
+    const size_t budget = ioBudget();
+    int savedErrno = 0;
+    ssize_t n = 0;
+    size_t total = 0;
+    bool drained = false;
+    do
+    {
+        const size_t hint = readHint_;
+        size_t limit = 0; // 有输入上限时不要一次读超过上限太多
+        if (inputHighWaterMark_ > 0)
+        {
+            size_t readable = inputBuffer_.readableBytes();
+            limit = readable < inputHighWaterMark_ ? inputHighWaterMark_ - readable : kMinReadHint;
+        }
+        n = inputBuffer_.readFd(channel_->fd(), &savedErrno, hint, limit);
+        if (n <= 0)
+        {
+            drained = true;
+            break;
+        }
+        total += n;
+        countRead(n, receiveTime);
+
+        // 根据最近的读取量调整readHint_: 直接读的空间被填满就加倍, 连1/4都用不到就减半.
+        if (implicit_cast<size_t>(n) >= hint)
+        {
+            readHint_ = std::min(2 * hint, kMaxReadHint);
+        }
+        else
+        {
+            if (4 * implicit_cast<size_t>(n) < hint)
+            {
+                readHint_ = std::max(hint / 2, kMinReadHint);
+            }
+            drained = true;
+            break; // 没读满, 内核缓冲区已经空了, 不必再读一次EAGAIN
+        }
+    } while (total < budget &&
+             (inputHighWaterMark_ == 0 || inputBuffer_.readableBytes() < inputHighWaterMark_));
+
+    if (total > 0)
+    {
+        deliverInput(receiveTime);
+    }
+
+    if (n == 0)
+    {
+        handleClose(); // 处理连接断开
+    }
+    // 循环读的时候以EAGAIN结束是正常的. 边沿触发时排队的handleReadAgain()可能已经把数据读走了, 第一次就EAGAIN也正常.
+    else if (n < 0 && (savedErrno != EAGAIN || (total == 0 && !channel_->edgeTriggered())))
+    {
+        errno = savedErrno;
+        LOG_SYSERR << "TcpConnection::handleRead";
+        handleError();
+    }
+    else if (!drained && channel_->edgeTriggered() && state_ == kConnected && readPauses_ == 0)
+    {
+        // 边沿触发不会再通知剩下的数据
+        loop_->queueInLoop(boost::bind(&TcpConnection::handleReadAgain, shared_from_this()));
+    }
+}
+
+void TcpConnection::deliverInput(Timestamp receiveTime)
+{
+    // shared_from_this(): 把this转化为share_prt
+    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    shrinkIfDrained(&inputBuffer_, readHint_);
+
+    // 处理不过来, 先不读了, 等inputBuffer_被取走
+    if (inputHighWaterMark_ > 0 && inputBuffer_.readableBytes() >= inputHighWaterMark_ &&
+        !(readPauses_ & kPausedByInput))
+    {
+        pauseRead(kPausedByInput);
+        watchInput();
+    }
+}
+
+void TcpConnection::deliverPausedInput()
+{
+    if ((state_ == kConnected || state_ == kDisconnecting) && readPauses_ == 0 && inputBuffer_.readableBytes() > 0)
+    {
+        deliverInput(loop_->pollReturnTime());
+    }
+}
+
+void TcpConnection::handleReadAgain()
+{
+    if (state_ == kConnected && channel_->isReading())
+    {
+        handleRead(loop_->pollReturnTime());
+    }
+}
+
+ssize_t TcpConnection::writeOutput(int *savedErrno)
+{
+    return outputQueue_.empty()
+               ? outputBuffer_.writeFd(channel_->fd(), savedErrno) // 分段模式下是writev, 一次写出多个slab
+               : writeOutputQueue(savedErrno);
+}
+
+// 边沿触发时一直写到发完或者EAGAIN, 否则不会再有可写事件. 写满预算还没写完就排到本轮事件之后继续写.
+void TcpConnection::drainOutput(size_t written)
+{
+    const size_t budget = ioBudget();
+    while (outputBytes() > 0)
+    {
+        if (written >= budget)
+        {
+            loop_->queueInLoop(boost::bind(&TcpConnection::handleWrite, shared_from_this()));
+            return;
+        }
+        int savedErrno = 0;
+        ssize_t n = writeOutput(&savedErrno);
+        if (n <= 0) // 0: sendfile遇到文件截断
+        {
+            if (n < 0 && savedErrno != EAGAIN)
+            {
+                errno = savedErrno;
+                LOG_SYSERR << "TcpConnection::drainOutput";
+            }
+            return;
+        }
+        countWrite(n);
+        written += n;
+    }
+}
+
+// 内核发送缓冲区有空间了, 回调该函数
+void TcpConnection::handleWrite()
+{
+    loop_->assertInLoopThread();
+
+    if (channel_->isWriting())
+    {
+        int savedErrno = 0;
+        ssize_t n = writeOutput(&savedErrno);
+        if (n >= 0) // sendfile遇到文件截断时返回0
+        {
+            countWrite(n);
+            if (n > 0 && channel_->edgeTriggered())
+            {
+                drainOutput(n);
+            }
+            if (upstreamPaused_ && outputBytes() < highWaterMark_ / 2) // 积压的数据发得差不多了, 上游可以继续读
+            {
+                throttleUpstream(false);
+            }
+            if (outputBytes() == 0) // 数据全部发送完毕: 1) channel取消EPOLLOUT事件; 2) 调用writeCompleteCallback_.
+            {
+                channel_->disableWriting(); //  1) channel取消EPOLLOUT事件, 以免出现 busy loop. 边沿触发时不调用epoll_ctl
+                outputDrained();
+            }
+            else // 还有数据没有发送完
+            {
+                LOG_TRACE << "I am going to write more data";
+            }
+        }
+        else if (savedErrno != EAGAIN) // sendFileInLoop()等主动调用handleWrite()时内核缓冲区可能已经满了
+        {
+            errno = savedErrno;
+            LOG_SYSERR << "TcpConnection::handleWrite";
+            // if (state_ == kDisconnecting)
+            // {
+            //   shutdownInLoop();
+            // }
+        }
+    }
+    else
     {
         LOG_TRACE << "Connection fd = " << channel_->fd()
                   << " is down, no more writing";
     }
 }
 
+// 待发送的数据全部发送完毕
+void TcpConnection::outputDrained()
+{
+    shrinkIfDrained(&outputBuffer_);
+    shrinkIfDrained(&inflightBuffer_);
+    if (corked_) // 把最后不满一个报文段的数据发出去
+    {
+        socket_->setTcpCork(false);
+        corked_ = false;
+    }
+    if (writeCompleteCallback_)
+    {
+        // 应用层发送缓冲区被清空, 就回调用writeCompleteCallback_
+        loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+    }
+
+    if (state_ == kDisconnecting) // 在send()时调用过shutdown().
+    {
+        shutdownInLoop();
+    }
+}
+
+// 完成式IO收到数据. 连接关闭之后, 本轮剩下的完成事件直接丢掉.
+void TcpConnection::handleRecv(const char *data, ssize_t n, Timestamp receiveTime)
+{
+    loop_->assertInLoopThread();
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    if (n > 0)
+    {
+        inputBuffer_.append(data, n);
+        countRead(n, receiveTime);
+        if (readPauses_ == 0)
+        {
+            deliverInput(receiveTime);
+        }
+        else
+        {
+            pausedInput_ = true;
+        }
+    }
+    else if (n == 0)
+    {
+        handleClose();
+    }
+    else // recv出错就结束了, 不会再有别的通知
+    {
+        errno = static_cast<int>(-n);
+        LOG_SYSERR << "TcpConnection::handleRecv [" << name_ << "]";
+        handleClose();
+    }
+}
+
+// 完成式IO的send完成, 发出去的部分从inflightBuffer_中取走, 接着发送剩下的和期间新追加的数据
+void TcpConnection::handleSendComplete(ssize_t n)
+{
+    loop_->assertInLoopThread();
+    sendInFlight_ = false;
+    if (self_) // connectDestroyed()在等这个send
+    {
+        channel_->remove();
+        inflightBuffer_.detachPool();
+        self_.reset(); // Channel::handleEvent()还持有一个引用
+        return;
+    }
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    if (n < 0) // 对方关闭了连接, recv会报告
+    {
+        errno = static_cast<int>(-n);
+        LOG_SYSERR << "TcpConnection::handleSendComplete [" << name_ << "]";
+        return;
+    }
+
+    countWrite(n);
+    inflightBuffer_.retrieve(n);
+    submitOutput();
+    if (upstreamPaused_ && outputBytes() < highWaterMark_ / 2)
+    {
+        throttleUpstream(false);
+    }
+    if (outputBytes() == 0)
+    {
+        outputDrained();
+    }
+}
+
+// 没有send在内核中时, 把outputBuffer_换到inflightBuffer_发送. 之后追加的数据不会挪动内核正在读的内存.
+void TcpConnection::submitOutput()
+{
+    if (sendInFlight_)
+    {
+        return;
+    }
+    if (inflightBuffer_.readableBytes() == 0)
+    {
+        refillOutput();
+        if (outputBuffer_.readableBytes() == 0)
+        {
+            return;
+        }
+        inflightBuffer_.swap(outputBuffer_);
+    }
+    sendMsg_.msg_iovlen = static_cast<size_t>(
+        inflightBuffer_.readableIovecs(0, inflightBuffer_.readableBytes(), sendIov_, kMaxSendIovecs));
+    channel_->sendAsync(&sendMsg_);
+    sendInFlight_ = true;
+}
+
+// 完成式IO没有sendfile: 把outputQueue_中排队的文件和数据按顺序拷贝进outputBuffer_, 文件每次最多读kFileCopyChunk字节,
+// 剩下的等这个send完成后再读. 大文件不会阻塞IO线程读完整个文件, 也不会整个放进内存.
+void TcpConnection::refillOutput()
+{
+    size_t fileBytes = 0;
+    while (!outputQueue_.empty() && fileBytes < kFileCopyChunk)
+    {
+        OutputChunk &chunk = outputQueue_.front();
+        if (chunk.type == OutputChunk::kFile)
+        {
+            size_t len = std::min(chunk.len, kFileCopyChunk - fileBytes);
+            outputBuffer_.ensureWritableBytes(len);
+            ssize_t n = ::pread(*chunk.file, outputBuffer_.beginWrite(), len, chunk.offset);
+            if (n <= 0)
+            {
+                if (n < 0)
+                {
+                    LOG_SYSERR << "TcpConnection::refillOutput";
+                }
+                else
+                {
+                    LOG_ERROR << "TcpConnection::refillOutput [" << name_ << "] - file truncated, "
+                              << chunk.len << " bytes dropped";
+                }
+                queuedBytes_ -= chunk.len;
+                outputQueue_.pop_front();
+                continue;
+            }
+            outputBuffer_.hasWritten(n);
+            fileBytes += n;
+            chunk.offset += n;
+            chunk.len -= n;
+            queuedBytes_ -= n;
+        }
+        else // sendInLoop()排在文件后面的数据
+        {
+            outputBuffer_.append(chunk.slice.data() + chunk.offset, chunk.len);
+            queuedBytes_ -= chunk.len;
+            chunk.len = 0;
+        }
+        if (chunk.len == 0)
+        {
+            outputQueue_.pop_front();
+        }
+    }
+}
+
 // 处理连接断开, 内部调用 closeCallbackk_
 void TcpConnection::handleClose()
 {
@@ -327,6 +1393,11 @@ void TcpConnection::handleClose()
 
     setState(kDisconnected);
     channel_->disableAll();
+    channel_->stopRecv();
+    if (upstreamPaused_) // 不要让上游一直停着
+    {
+        throttleUpstream(false);
+    }
 
     TcpConnectionPtr guardThis(shared_from_this()); // TcpConnectionPtr guardThis(this); 不能这么用,
     connectionCallback_(guardThis);                 // 用户的回调函数
@@ -334,10 +1405,19 @@ void TcpConnection::handleClose()
     closeCallback_(guardThis);
 }
 
-// 仅仅是记录日志
+// 仅仅是记录日志. 开启了零拷贝时, 完成通知也是以EPOLLERR的形式报告的.
 void TcpConnection::handleError()
 {
+    if (socketZeroCopy_)
+    {
+        handleZeroCopyCompletions();
+    }
+
     int err = sockets::getSocketError(channel_->fd());
+    if (err == 0 && socketZeroCopy_) // 只是零拷贝的完成通知
+    {
+        return;
+    }
     LOG_ERROR << "TcpConnection::handleError [" << name_
               << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
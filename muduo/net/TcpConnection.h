@@ -5,14 +5,21 @@
 #include <muduo/base/StringPiece.h>
 #include <muduo/base/Types.h>
 #include <muduo/net/Callbacks.h>
+#include <muduo/net/ConnectionStats.h>
 #include <muduo/net/Buffer.h>
 #include <muduo/net/InetAddress.h>
+#include <muduo/net/Slice.h>
 
 #include <boost/any.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <deque>
+
+#include <sys/socket.h>
 
 namespace muduo
 {
@@ -36,6 +43,43 @@ namespace muduo
 
             void setTcpNoDelay(bool on);
 
+            // 每个可读事件最多读多少字节, 0表示只读一次(默认). 必须在IO线程中调用(或者连接建立之前).
+            void setReadBudget(size_t bytes) { readBudget_ = bytes; }
+
+            // 边沿触发: 每个事件都读/写到EAGAIN为止(最多readBudget_字节, 没有设置时用默认的上限, 读不完的排到本轮事件之后继续),
+            // 部分写之后也不再用epoll_ctl反复开关EPOLLOUT. Poller不支持时返回false. 必须在IO线程中调用(或者连接建立之前).
+            bool setEdgeTriggered(bool on);
+            bool edgeTriggered() const;
+
+            // 完成式IO(io_uring, 见MUDUO_USE_URING): multishot recv收到的数据从内核提供的缓冲区拷贝进inputBuffer_,
+            // outputBuffer_用IORING_OP_SEND/SENDMSG发送, 同时只有一个send在内核中. 收发的SQE都在下一次poll()时一起提交,
+            // 一轮事件循环不管多少个连接在收发都只进一次内核. 这种模式下Slice和文件也拷贝进outputBuffer_发送(没有零拷贝),
+            // 文件每个send完成后才读下一块, 不会一次读进内存.
+            // setReadBudget()/setEdgeTriggered()不起作用. Poller不支持时返回false. 必须在连接建立之前调用.
+            bool setCompletionIo(bool on);
+            bool completionIo() const { return completionIo_; }
+
+            // inputBuffer_/outputBuffer_切换到分段模式, 适用于大流量的连接, 必须在IO线程中调用(或者连接建立之前).
+            void setSegmentedBuffers(size_t slabSize = Buffer::kDefaultSlabSize);
+
+            // 延迟发送: 一轮事件循环中的send()只追加到发送队列, 在本轮事件处理结束后用一次writev发出去.
+            // 适合一条消息回复很多小帧的协议. cork为true时, 从第一次延迟的send()到数据发完之间开启TCP_CORK.
+            // 必须在IO线程中调用(或者连接建立之前).
+            void setDeferredFlush(bool on, bool cork = false);
+
+            // 暂停/恢复读, 线程安全. 暂停期间数据留在内核缓冲区中, 由TCP流控让对端慢下来.
+            void stopRead();
+            void startRead();
+            bool isReading() const { return readPauses_ == 0; } // NOT thread safe
+
+            // inputBuffer_中的数据达到bytes时自动暂停读, 被取走到一半以下时自动恢复, 0表示不限制(默认).
+            // bytes要大于一条完整消息的长度, 否则凑不齐消息的连接会一直暂停. 必须在IO线程中调用(或者连接建立之前).
+            void setInputHighWaterMark(size_t bytes) { inputHighWaterMark_ = bytes; }
+
+            // upstream读到的数据会转发给本连接(代理). 本连接待发送的数据超过高水位(见setHighWaterMarkCallback())时
+            // upstream暂停读, 降到一半以下时恢复读. upstream可以属于别的EventLoop. 必须在本连接的IO线程中调用.
+            void setUpstream(const TcpConnectionPtr &upstream);
+
             // 在非阻塞网络编程中, 发送消息通常是由网络库完成的, 用户不会直接调用write或send系统调用.
             /* 
             TcpConnection::send()
@@ -46,8 +90,24 @@ namespace muduo
             void send(const void *message, size_t len);
             void send(const StringPiece &message);
             void send(Buffer *message); // this one will swap data
-            // void send(string&& message); // C++11
-            // void send(Buffer&& message); // C++11
+#ifdef __GXX_EXPERIMENTAL_CXX0X__
+            // 接管message的内存, 跨线程时不拷贝数据. 调用之后message为空.
+            void send(string &&message);
+            void send(Buffer &&message); // 池化的Buffer跨线程时还是要拷贝一次
+            // 字面值既能转换成StringPiece也能转换成string, 用这个重载消除歧义
+            void send(const char *message) { send(StringPiece(message)); }
+#endif
+            void send(const Slice &message); // 不拷贝数据, 只持有引用计数, 发送完毕后释放
+            // 同上, message的内存不再被引用(可以修改)时回调cb. 连接断开时没有发送完的不会回调.
+            void send(const Slice &message, const SendCompleteCallback &cb);
+
+            // 开启MSG_ZEROCOPY: 不小于minBytes的Slice用零拷贝发送, 内核发送完成之前一直持有Slice, 0表示关闭.
+            // 返回false表示内核不支持SO_ZEROCOPY. 必须在IO线程中调用(或者连接建立之前).
+            bool setZeroCopy(size_t minBytes);
+
+            // 发送文件fd中[offset, offset + length)的内容, 排在之前send()的数据之后, 用sendfile(2)发送.
+            // 内部会dup(fd), 调用返回后就可以关闭fd. 发送期间不要截断文件. 线程安全.
+            void sendFile(int fd, off_t offset, size_t length);
 
             // -----------
             // context_ 相关
@@ -73,6 +133,8 @@ namespace muduo
 
             // 关闭写端, 不是线程安全.
             void shutdown();
+            // 不管有没有数据没发完, 直接关闭连接. 线程安全.
+            void forceClose();
 
             // called when TcpServer accepts a new connection
             void connectEstablished();
@@ -84,7 +146,12 @@ namespace muduo
             const InetAddress &localAddress() { return localAddr_; }
             const InetAddress &peerAddress() { return peerAddr_; }
             bool connected() const { return state_ == kConnected; }
+            bool disconnected() const { return state_ == kDisconnected; }
             Buffer *inputBuffer() { return &inputBuffer_; }
+            Buffer *outputBuffer() { return &outputBuffer_; }
+
+            // 流量和时间统计, 只能在IO线程中读. 其他线程用EventLoop::getStats().
+            const ConnectionStats &stats() const { return stats_; }
 
         private:
             // -------
@@ -105,7 +172,10 @@ namespace muduo
             // ----------
 
             void handleRead(Timestamp receiveTime);
+            void handleReadAgain();
             void handleWrite();
+            void handleRecv(const char *data, ssize_t n, Timestamp receiveTime);
+            void handleSendComplete(ssize_t n);
             void handleClose(); // 由Channel的CloseCallback调用.
             void handleError();
             boost::scoped_ptr<Channel> channel_;
@@ -120,9 +190,39 @@ namespace muduo
 
             void sendInLoop(const StringPiece &message);
             void sendInLoop(const void *message, size_t len);
-            // void sendInLoop(string&& message);
+            void sendSliceInLoop(const Slice &message, const SendCompleteCallback &cb);
+            void sendFileInLoop(const boost::shared_ptr<const int> &file, off_t offset, size_t length);
+            void refillOutput();
+            void sendOwnedString(string *message);
+            void sendOwnedBuffer(Buffer *message);
+            ssize_t writeDirectly(const void *data, size_t len, bool *error);
+            ssize_t writeOutput(int *savedErrno);
+            void drainOutput(size_t written);
+            size_t ioBudget() const;
+            void checkHighWaterMark(size_t remaining);
+            void deliverInput(Timestamp receiveTime);
+            void deliverPausedInput();
+            void outputDrained();
+            void submitOutput();
+            // 还有数据在等待发送: 关注了POLLOUT, 或者完成式IO有send在内核中
+            bool writing() const;
 
             void shutdownInLoop();
+            void forceCloseInLoop();
+            void scheduleFlush();
+            void flush();
+
+            // 暂停读的原因, 全部解除之后才恢复读
+            enum ReadPauseReason
+            {
+                kPausedByUser = 1,  // stopRead()
+                kPausedByInput = 2, // inputBuffer_超过了inputHighWaterMark_
+                kPausedByPeer = 4   // 下游连接的输出超过了高水位
+            };
+            void pauseRead(int reason);
+            void resumeRead(int reason);
+            void watchInput();
+            void throttleUpstream(bool pause);
 
             EventLoop *loop_; // 所属EventLoop
             string name_;
@@ -139,6 +239,19 @@ namespace muduo
 
             HighWaterMarkCallback highWaterMarkCallback_; // "高水位" 标回调函数
 
+            size_t readHint_;   // 下一次readFd()希望直接读进inputBuffer_的字节数, 随最近的流量自适应
+            size_t readBudget_; // handleRead()每次最多读的字节数, 0表示只读一次
+
+            bool deferFlush_;  // send()时不直接write, 等到本轮事件处理结束再flush()
+            bool corkOnFlush_; // 延迟发送期间开启TCP_CORK
+            bool flushQueued_; // 已经queueFlush(), 还没有执行
+            bool corked_;      // 当前开启了TCP_CORK
+
+            int readPauses_;                         // ReadPauseReason的组合, 0表示正在读
+            size_t inputHighWaterMark_;              // 0表示不限制
+            boost::weak_ptr<TcpConnection> upstream_; // 本连接输出积压时要暂停读的连接
+            bool upstreamPaused_;
+
             // input/output是针对程序员而言的, 对TcpConnection而言相反.
             // TcpConnection会从cfd读取数据, 然后写入inputBuffer_, 这一步是由Buffer::readfd()完成的, 程序员从inputBuffer_中读取数据.
             // 程序员应该在onMessage()完成对inputBuffer_的操作.
@@ -146,11 +259,91 @@ namespace muduo
 
             Buffer outputBuffer_; // 程序员把数据写入outputBuffer, 这一步是由TcpConnection::send()完成的, TcpConnection从outputBuffer中读取数据并写入cfd.
 
+            // 输出队列: 有Slice或文件等待发送时, 按顺序记录每一段数据, 拷贝的数据在outputBuffer_中, Slice和文件的数据在原处.
+            // 队列为空时所有待发送的数据都在outputBuffer_中. 队列不为空时, kBuffered的len之和等于outputBuffer_.readableBytes().
+            struct OutputChunk
+            {
+                enum Type
+                {
+                    kBuffered, // outputBuffer_中的len个字节
+                    kSlice,    // slice中[offset, offset + len)
+                    kFile      // 文件*file中[offset, offset + len), 用sendfile发送
+                };
+
+                Type type;
+                size_t len; // 还没有发送的字节数
+                Slice slice;
+                boost::shared_ptr<const int> file; // dup出来的fd, 最后一个引用释放时close
+                size_t offset;
+                bool zeroCopy;             // kSlice用MSG_ZEROCOPY发送
+                SendCompleteCallback done; // kSlice发送完毕的回调
+
+                explicit OutputChunk(size_t n)
+                    : type(kBuffered), len(n), offset(0), zeroCopy(false)
+                {
+                }
+
+                OutputChunk(const Slice &s, bool zc, const SendCompleteCallback &cb)
+                    : type(kSlice), len(s.size()), slice(s), offset(0), zeroCopy(zc), done(cb)
+                {
+                }
+
+                OutputChunk(const boost::shared_ptr<const int> &f, off_t off, size_t n)
+                    : type(kFile), len(n), file(f), offset(off), zeroCopy(false)
+                {
+                }
+            };
+            std::deque<OutputChunk> outputQueue_;
+            size_t queuedBytes_; // outputQueue_中Slice和文件的待发送字节数
+
+            // 完成式IO, 见setCompletionIo(). 正在发送的数据在inflightBuffer_中, 内核读完之前不能移动,
+            // 之后send()的数据追加到outputBuffer_, 这个send完成后再换过去.
+            // 还没读完的文件和排在它后面的数据留在outputQueue_中, 由refillOutput()按顺序读进outputBuffer_.
+            static const int kMaxSendIovecs = 64;
+            bool completionIo_;
+            bool sendInFlight_;
+            bool pausedInput_; // 暂停读之后才到达的recv数据已经在inputBuffer_中, 恢复读时再回调messageCallback_
+            Buffer inflightBuffer_;
+            struct iovec sendIov_[kMaxSendIovecs];
+            struct msghdr sendMsg_;
+            boost::shared_ptr<TcpConnection> self_; // connectDestroyed()时还有send在内核中, 等它完成再移除channel
+
+            // 所有待发送的字节数
+            size_t outputBytes() const
+            {
+                return outputBuffer_.readableBytes() + queuedBytes_ + inflightBuffer_.readableBytes();
+            }
+            void queueBuffered(size_t len);
+            ssize_t writeOutputQueue(int *savedErrno);
+            ssize_t sendFileChunk(int *savedErrno);
+            void retrieveOutput(size_t len);
+
+            // MSG_ZEROCOPY: 每次成功的零拷贝send()对应一项, 持有Slice直到错误队列中的完成通知到达.
+            struct ZeroCopyPending
+            {
+                uint32_t seq; // 内核给send()调用的编号
+                Slice pin;
+                SendCompleteCallback done; // 一个Slice的最后一次send()才有
+                bool completed;
+                bool copied; // 内核退化成了拷贝
+            };
+            std::deque<ZeroCopyPending> zeroCopyPending_;
+            size_t zeroCopyMinBytes_; // 0表示不使用零拷贝
+            bool socketZeroCopy_;     // socket上已经开启了SO_ZEROCOPY, 需要处理错误队列
+            uint32_t zeroCopySeq_;    // 下一次零拷贝send()的编号
+
+            ssize_t sendZeroCopyChunk(int *savedErrno);
+            void handleZeroCopyCompletions();
+            void reapZeroCopy();
+
             // 可变类型解决方案: 1) void*, 但不是类型安全的; 2) boost::any.
             // boost::any: 任意类型的安全存储, 以及安全取. 还可以这么使用: std::vector<boost::any>, 以存放任意类型数据.
             boost::any context_; // 绑定一个未知类型的上下文对象, 给上层应用预留一个成员.
 
-            // FIXME: creationTime_, lastReceiveTime_, bytesReceived_, bytesSent_
+            ConnectionStats stats_; // 建立之后登记到loop_, 销毁时注销
+
+            void countRead(size_t n, Timestamp receiveTime);
+            void countWrite(size_t n);
         };
 
         typedef boost::shared_ptr<TcpConnection> TcpConnectionPtr;
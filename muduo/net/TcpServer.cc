@@ -1,3 +1,4 @@
+#include <muduo/base/CountDownLatch.h>
 #include <muduo/base/Logging.h>
 #include <muduo/net/TcpServer.h>
 #include <muduo/net/Acceptor.h>
@@ -17,15 +18,31 @@ TcpServer::TcpServer(EventLoop *loop,
     : loop_(CHECK_NOTNULL(loop)),
       hostport_(listenAddr.toIpPort()),
       name_(nameArg),
+      listenAddr_(listenAddr),
       acceptor_(new Acceptor(loop, listenAddr)),
+      acceptPerLoop_(false),
+      maxAcceptsPerWakeup_(Acceptor::kDefaultMaxAcceptsPerWakeup),
       threadPool_(new EventLoopThreadPool(loop)), // loop就是mainReadtor
       connectionCallback_(defaultConnectionCallback),
       messageCallback_(defaultMessageCallback),
       started_(false),
+      slabSize_(0),
+      poolChunkSize_(0),
+      poolReclaimInterval_(0.0),
+      readBudget_(0),
+      edgeTriggered_(false),
+      completionIo_(false),
+      deferredFlush_(false),
+      corkOnFlush_(false),
+      idleTimeout_(0.0),
+      idleTick_(1.0),
+      idleAction_(IdleTimeoutWheel::kForceClose),
+      busyPollSpin_(0.0),
+      socketBusyPollUs_(0),
       nextConnId_(1)
 {
-    // Acceptor::handleRead()中会回调用TcpServer::newConnection. _1: cfd, _2: 客户端的地址
-    acceptor_->setNewConnectionCallback(boost::bind(&TcpServer::newConnection, this, _1, _2));
+    // Acceptor::handleRead()中会回调用TcpServer::newConnections. _1: 本次accept到的连接
+    acceptor_->setNewConnectionsCallback(boost::bind(&TcpServer::newConnections, this, static_cast<EventLoop *>(NULL), _1));
 }
 
 TcpServer::~TcpServer()
@@ -33,7 +50,29 @@ TcpServer::~TcpServer()
     loop_->assertInLoopThread();
     LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
 
-    for (auto it = connections_.begin(); it != connections_.end(); ++it)
+    // 先停止各个loop的accept, 之后不会再有新连接
+    if (!loopAcceptors_.empty())
+    {
+        CountDownLatch latch(static_cast<int>(loopAcceptors_.size()));
+        for (size_t i = 0; i < loopAcceptors_.size(); ++i)
+        {
+            loopAcceptors_[i]->loop()->runInLoop(boost::bind(&TcpServer::destroyAcceptor, loopAcceptors_[i], &latch));
+        }
+        latch.wait();
+        loopAcceptors_.clear();
+    }
+
+    for (IdleWheelMap::iterator it = idleWheels_.begin(); it != idleWheels_.end(); ++it)
+    {
+        it->second->stop(); // 定时器在IO线程中被删除时释放时间轮
+    }
+
+    ConnectionMap connections;
+    {
+        MutexLockGuard lock(mutex_);
+        connections.swap(connections_);
+    }
+    for (auto it = connections.begin(); it != connections.end(); ++it)
     {
         TcpConnectionPtr conn = it->second;
         it->second.reset();
@@ -53,41 +92,170 @@ void TcpServer::setThreadNum(int numThreads)
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setMaxAcceptsPerWakeup(int n)
+{
+    assert(!started_);
+    maxAcceptsPerWakeup_ = n;
+    acceptor_->setMaxAcceptsPerWakeup(n);
+}
+
+void TcpServer::setAcceptPerLoop(bool on)
+{
+    assert(!started_);
+    if (on && listenAddr_.portNetEndian() == 0)
+    {
+        LOG_ERROR << "TcpServer::setAcceptPerLoop [" << name_
+                  << "] - per-loop accept needs a fixed port, accepting in baseloop";
+        return;
+    }
+    acceptPerLoop_ = on;
+}
+
 // 开始listen事件
 void TcpServer::start()
 {
     if (!started_)
     {
         started_ = true;
-        threadPool_->start(threadInitCallback_);
+        threadPool_->start(boost::bind(&TcpServer::threadInit, this, _1));
+        if (acceptPerLoop_)
+        {
+            loop_->runInLoop(boost::bind(&TcpServer::listenPerLoop, this));
+        }
     }
 
-    if (!acceptor_->listenning())
+    if (!acceptPerLoop_ && !acceptor_->listenning())
     {
         // get_pointer返回原生指针
         loop_->runInLoop(boost::bind(&Acceptor::listen, get_pointer(acceptor_)));
     }
 }
 
-// Acceptor中的newConnectionCallback_, 创建一个TcpConnection对象, 并设置4个回调函数.
-// 参数sockfd: cfd
-// 参数peerAddr: 客户端的地址
-void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
+// 构造函数中的acceptor_没有开启SO_REUSEPORT, 先关掉它, 再给每个loop建一个
+void TcpServer::listenPerLoop()
 {
     loop_->assertInLoopThread();
+    acceptor_.reset();
+
+    std::vector<EventLoop *> loops(threadPool_->getAllLoops());
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        Acceptor *acceptor = new Acceptor(loops[i], listenAddr_, true);
+        acceptor->setNewConnectionsCallback(boost::bind(&TcpServer::newConnections, this, loops[i], _1));
+        acceptor->setMaxAcceptsPerWakeup(maxAcceptsPerWakeup_);
+        loopAcceptors_.push_back(acceptor);
+        loops[i]->runInLoop(boost::bind(&Acceptor::listen, acceptor));
+    }
+}
+
+void TcpServer::destroyAcceptor(Acceptor *acceptor, CountDownLatch *latch)
+{
+    delete acceptor;
+    latch->countDown();
+}
+
+// 每个IO线程进入事件循环之前调用, 先做TcpServer自己的初始化, 再调用用户的threadInitCallback_
+void TcpServer::threadInit(EventLoop *loop)
+{
+    if (poolChunkSize_ > 0)
+    {
+        loop->enableBufferPool(poolChunkSize_, poolReclaimInterval_);
+    }
+
+    if (busyPollSpin_ > 0)
+    {
+        loop->setBusyPoll(busyPollSpin_, socketBusyPollUs_);
+    }
+
+    if (idleTimeout_ > 0)
+    {
+        boost::shared_ptr<IdleTimeoutWheel> wheel(new IdleTimeoutWheel(loop, idleTimeout_, idleTick_, idleAction_));
+        wheel->start();
+        MutexLockGuard lock(mutex_);
+        idleWheels_[loop] = wheel;
+    }
+
+    if (threadInitCallback_)
+    {
+        threadInitCallback_(loop);
+    }
+}
+
+// Acceptor中的newConnectionsCallback_, 为一次accept到的所有连接创建TcpConnection对象.
+// 参数ioLoop: 每个loop各自accept时是accept它们的loop, 连接就在这个loop上; NULL表示在baseloop中accept, 轮询分配给线程池.
+// 参数accepted: cfd和客户端的地址
+// 一批连接只加两次锁, 分给同一个loop的连接用一个functor交给它, 连接风暴时IO线程不会被每个连接唤醒一次.
+void TcpServer::newConnections(EventLoop *ioLoop, const AcceptedList &accepted)
+{
+    (ioLoop ? ioLoop : loop_)->assertInLoopThread();
+
+    int firstId;
+    {
+        MutexLockGuard lock(mutex_);
+        firstId = nextConnId_;
+        nextConnId_ += static_cast<int>(accepted.size());
+    }
+
+    // 按loop分组, 线程池不大, 线性查找就够了
+    std::vector<std::pair<EventLoop *, std::vector<TcpConnectionPtr> > > groups;
+    std::vector<TcpConnectionPtr> conns;
+    conns.reserve(accepted.size());
+    for (size_t i = 0; i < accepted.size(); ++i)
+    {
+        EventLoop *loop = ioLoop ? ioLoop : threadPool_->getLoopForPeer(accepted[i].second); // 按放置策略从线程池中选择一个线程
+        TcpConnectionPtr conn(createConnection(loop, firstId + static_cast<int>(i), accepted[i].first, accepted[i].second));
+        conns.push_back(conn);
 
-    EventLoop *ioLoop = threadPool_->getNextLoop(); // 从线程池中选择一个线程
+        size_t g = 0;
+        while (g < groups.size() && groups[g].first != loop)
+        {
+            ++g;
+        }
+        if (g == groups.size())
+        {
+            groups.push_back(std::make_pair(loop, std::vector<TcpConnectionPtr>()));
+        }
+        groups[g].second.push_back(conn);
+    }
 
+    std::vector<boost::shared_ptr<IdleTimeoutWheel> > wheels(groups.size());
+    {
+        MutexLockGuard lock(mutex_);
+        for (size_t i = 0; i < conns.size(); ++i)
+        {
+            connections_[conns[i]->name()] = conns[i];
+        }
+        if (idleTimeout_ > 0)
+        {
+            for (size_t g = 0; g < groups.size(); ++g)
+            {
+                wheels[g] = idleWheels_[groups[g].first];
+            }
+        }
+    }
+
+    // 让 TcpConnection所属的 loop调用连接函数(TcpConnection::connectEstablished).
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        groups[g].first->runInLoop(boost::bind(&TcpServer::establishConnections, groups[g].second, wheels[g]));
+    }
+}
+
+// 创建一个TcpConnection对象, 并设置它的回调函数和选项. 还没有加入connections_
+TcpConnectionPtr TcpServer::createConnection(EventLoop *ioLoop, int connId, int sockfd, const InetAddress &peerAddr)
+{
     char buf[32];
-    snprintf(buf, sizeof buf, ":%s#%d", hostport_.c_str(), nextConnId_);
-    ++nextConnId_;
+    snprintf(buf, sizeof buf, ":%s#%d", hostport_.c_str(), connId);
     string connName = name_ + buf;
 
-    LOG_INFO << "TcpServer::newConnection [" << name_
-             << "] - new connection [" << connName
-             << "] from " << peerAddr.toIpPort();
+    // 每个连接一条INFO日志会拖慢连接风暴时的accept, 降为DEBUG
+    LOG_DEBUG << "TcpServer::newConnection [" << name_
+              << "] - new connection [" << connName
+              << "] from " << peerAddr.toIpPort();
 
-    InetAddress localAddr(sockets::getLocalAddr(sockfd));
+    // 监听的是具体的IP和端口时本地地址就是监听地址, 不用getsockname. 端口0要向内核查询实际的端口
+    bool fixedLocal = listenAddr_.ipNetEndian() != htonl(INADDR_ANY) && listenAddr_.portNetEndian() != 0;
+    InetAddress localAddr(fixedLocal ? listenAddr_.getSockAddrInet() : sockets::getLocalAddr(sockfd));
 
     // FIXME poll with zero timeout to double confirm the new connection
     // FIXME use make_shared if necessary
@@ -99,38 +267,65 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
                                             localAddr,
                                             peerAddr));
 
-    // 此时 conn 的引用技术为1
-    // LOG_TRACE << "[1] use_count: " << conn.use_count();
-    connections_[connName] = conn;
-    // 此时 conn的引用技术为2, 上面加入 map了拷贝.
-    // LOG_TRACE << "[2] use_count: " << conn.use_count();
-
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
     conn->setCloseCallback(boost::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
+    conn->setReadBudget(readBudget_);
+    if (edgeTriggered_)
+    {
+        conn->setEdgeTriggered(true);
+    }
+    if (completionIo_)
+    {
+        conn->setCompletionIo(true);
+    }
+    conn->setDeferredFlush(deferredFlush_, corkOnFlush_);
+    if (slabSize_ > 0)
+    {
+        conn->setSegmentedBuffers(slabSize_);
+    }
+    return conn;
+}
 
-    ioLoop->runInLoop(boost::bind(&TcpConnection::connectEstablished, conn)); // 让 TcpConnection所属的 loop调用连接函数(TcpConnection::connectEstablished).
+// 在连接所属的IO线程中调用, wheel为空表示不关闭空闲连接
+void TcpServer::establishConnections(const std::vector<TcpConnectionPtr> &conns,
+                                     const boost::shared_ptr<IdleTimeoutWheel> &wheel)
+{
+    for (size_t i = 0; i < conns.size(); ++i)
+    {
+        conns[i]->connectEstablished();
+        if (wheel)
+        {
+            wheel->add(conns[i]);
+        }
+    }
 }
 
 // 从connections_中移除conn, 在loop_中这注册了removeConnectionInLoop(). 线程安全
+// 每个loop各自accept时连接的整个生命周期都在它自己的loop中.
 void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 {
-    loop_->runInLoop(boost::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    EventLoop *loop = acceptPerLoop_ ? conn->getLoop() : loop_;
+    loop->runInLoop(boost::bind(&TcpServer::removeConnectionInLoop, this, conn));
 }
 
 // 仅仅被上面的TcpServer::removeConnection()调用
 // (1) 从connections_中移除conn -> (2) 把conn的connectDestroyed()放进EventLoop的functors中.
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
 {
-    loop_->assertInLoopThread();
-    LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_
-             << "] - connection " << conn->name();
+    EventLoop *ioLoop = conn->getLoop();
+    (acceptPerLoop_ ? ioLoop : loop_)->assertInLoopThread();
+    LOG_DEBUG << "TcpServer::removeConnectionInLoop [" << name_
+              << "] - connection " << conn->name();
 
-    size_t n = connections_.erase(conn->name());
+    size_t n;
+    {
+        MutexLockGuard lock(mutex_);
+        n = connections_.erase(conn->name());
+    }
     (void)n;
     assert(n == 1);
-    
-    EventLoop *ioLoop = conn->getLoop();
+
     ioLoop->queueInLoop(boost::bind(&TcpConnection::connectDestroyed, conn));
 }
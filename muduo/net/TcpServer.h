@@ -3,19 +3,26 @@
 
 #include <map>
 
+#include <muduo/base/Mutex.h>
 #include <muduo/base/Types.h>
+#include <muduo/net/EventLoopThreadPool.h>
+#include <muduo/net/IdleTimeoutWheel.h>
 #include <muduo/net/TcpConnection.h>
 
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#include <utility>
+#include <vector>
+
 namespace muduo
 {
+    class CountDownLatch;
+
     namespace net
     {
         class Acceptor;
         class EventLoop;
-        class EventLoopThreadPool;
 
         class TcpServer : boost::noncopyable
         {
@@ -39,6 +46,9 @@ namespace muduo
                 threadInitCallback_ = cb;
             }
 
+            // valid after calling start()
+            EventLoopThreadPool *threadPool() const { return get_pointer(threadPool_); }
+
             /// Starts the server if it's not listenning.
             ///
             /// It's harmless to call it multiple times.
@@ -63,11 +73,84 @@ namespace muduo
                 writeCompleteCallback_ = cb;
             }
 
+            // 新连接的inputBuffer/outputBuffer使用分段模式, 0表示使用默认的连续模式. Not thread safe.
+            void setSegmentedBuffers(size_t slabSize = Buffer::kDefaultSlabSize)
+            {
+                slabSize_ = slabSize;
+            }
+
+            // 每个IO线程的EventLoop都开启BufferPool, 新连接的缓冲区从中借用chunk. 0表示不使用. Not thread safe.
+            // 必须在start()之前调用.
+            void setBufferPool(size_t chunkSize, double reclaimInterval = 10.0)
+            {
+                poolChunkSize_ = chunkSize;
+                poolReclaimInterval_ = reclaimInterval;
+            }
+
+            // 新连接每个可读事件最多读多少字节, 见TcpConnection::setReadBudget(). Not thread safe.
+            void setReadBudget(size_t bytes) { readBudget_ = bytes; }
+
+            // 新连接使用边沿触发, 见TcpConnection::setEdgeTriggered(). Not thread safe.
+            void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+            // 新连接使用完成式IO(io_uring), 见TcpConnection::setCompletionIo(). Not thread safe.
+            void setCompletionIo(bool on) { completionIo_ = on; }
+
+            // 新连接使用延迟发送, 见TcpConnection::setDeferredFlush(). Not thread safe.
+            void setDeferredFlush(bool on, bool cork = false)
+            {
+                deferredFlush_ = on;
+                corkOnFlush_ = on && cork;
+            }
+
+            // 每个IO线程用一个时间轮关闭空闲超过timeout秒的连接(收发数据都算活动), 每tick秒检查一次.
+            // 0表示不关闭(默认). 必须在start()之前调用.
+            void setIdleTimeout(double timeout, double tick = 1.0,
+                                IdleTimeoutWheel::Action action = IdleTimeoutWheel::kForceClose)
+            {
+                idleTimeout_ = timeout;
+                idleTick_ = tick;
+                idleAction_ = action;
+            }
+
+            // 每个IO线程使用忙轮询, 见EventLoop::setBusyPoll(). 必须在start()之前调用.
+            void setBusyPoll(double spinSeconds, int socketBusyPollUs = 0)
+            {
+                busyPollSpin_ = spinSeconds;
+                socketBusyPollUs_ = socketBusyPollUs;
+            }
+
+            // 每个IO线程的loop都有自己的SO_REUSEPORT监听socket和Acceptor, 由内核把新连接分给各个loop,
+            // accept和建立连接都在服务它的loop中完成, 不经过baseloop, accept的吞吐量随线程数增加.
+            // 连接不再按轮询分配, 而是取决于内核的哈希. 必须在start()之前调用.
+            // 监听端口0时每个loop会bind到不同的端口, 不支持, 仍然在baseloop中accept.
+            void setAcceptPerLoop(bool on);
+
+            // 新连接分配给哪个IO线程, 见EventLoopThreadPool::setPlacement(), 默认轮询.
+            // 每个loop各自accept时不起作用. 必须在start()之前调用.
+            void setPlacement(EventLoopThreadPool::Placement placement) { threadPool_->setPlacement(placement); }
+            void setPlacementCallback(const EventLoopThreadPool::PlacementCallback &cb) { threadPool_->setPlacementCallback(cb); }
+
+            // IO线程的放置(绑定CPU和本地NUMA节点), 见EventLoopThreadPool::setThreadPlacements(). 必须在start()之前调用.
+            // 启动后用threadPool()->threadPlacementReports()查看每个IO线程实际的放置.
+            void setThreadPlacements(const std::vector<ThreadPlacement> &placements) { threadPool_->setThreadPlacements(placements); }
+
+            // 每次监听socket可读时最多accept多少个连接, 默认Acceptor::kDefaultMaxAcceptsPerWakeup, 1表示每次一个.
+            // 一批连接一起分配给IO线程, 每个IO线程只唤醒一次. 必须在start()之前调用.
+            void setMaxAcceptsPerWakeup(int n);
+
             const string &hostport() const { return hostport_; }
             const string &name() const { return name_; }
 
         private:
-            void newConnection(int sockfd, const InetAddress &peerAddr);
+            void threadInit(EventLoop *loop);
+            typedef std::vector<std::pair<int, InetAddress> > AcceptedList; // 同Acceptor::AcceptedList
+            void newConnections(EventLoop *ioLoop, const AcceptedList &accepted);
+            TcpConnectionPtr createConnection(EventLoop *ioLoop, int connId, int sockfd, const InetAddress &peerAddr);
+            static void establishConnections(const std::vector<TcpConnectionPtr> &conns,
+                                             const boost::shared_ptr<IdleTimeoutWheel> &wheel);
+            void listenPerLoop();
+            static void destroyAcceptor(Acceptor *acceptor, CountDownLatch *latch);
             void removeConnection(const TcpConnectionPtr &conn);
             void removeConnectionInLoop(const TcpConnectionPtr &conn);
 
@@ -75,8 +158,12 @@ namespace muduo
 
             const string hostport_; // IP:port 字符串
             const string name_;     // 服务名
+            const InetAddress listenAddr_;
 
-            boost::scoped_ptr<Acceptor> acceptor_;
+            boost::scoped_ptr<Acceptor> acceptor_;  // baseloop上的Acceptor, 每个loop各自accept时不用
+            bool acceptPerLoop_;
+            std::vector<Acceptor *> loopAcceptors_; // 每个IO线程一个, 在各自的loop中析构
+            int maxAcceptsPerWakeup_;
 
             boost::scoped_ptr<EventLoopThreadPool> threadPool_; // 线程池
 
@@ -86,6 +173,22 @@ namespace muduo
             ThreadInitCallback threadInitCallback_;       // TcpServer::removeConnection
 
             bool started_;
+            size_t slabSize_;           // 连接缓冲区的slab大小, 0表示连续模式
+            size_t poolChunkSize_;      // BufferPool的chunk大小, 0表示不使用BufferPool
+            double poolReclaimInterval_;
+            size_t readBudget_;         // 新连接的readBudget
+            bool edgeTriggered_;        // 新连接使用边沿触发
+            bool completionIo_;         // 新连接使用完成式IO
+            bool deferredFlush_;        // 新连接是否延迟发送
+            bool corkOnFlush_;
+            double idleTimeout_;        // 0表示不关闭空闲连接
+            double idleTick_;
+            IdleTimeoutWheel::Action idleAction_;
+            double busyPollSpin_;       // 0表示不使用忙轮询
+            int socketBusyPollUs_;
+            typedef std::map<EventLoop *, boost::shared_ptr<IdleTimeoutWheel> > IdleWheelMap;
+            MutexLock mutex_;           // 保护idleWheels_, 各个IO线程在threadInit()中插入. 每个loop各自accept时也保护下面两个
+            IdleWheelMap idleWheels_;
             int nextConnId_;            // 下一个连接ID
             ConnectionMap connections_; // TcpConnection列表
         };
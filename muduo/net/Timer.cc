@@ -10,10 +10,21 @@ void Timer::restart(Timestamp now)
 {
     if (repeat_)
     {
-        expiration_ = addTime(now, interval_);
+        expiration_ = roundUp(addTime(now, interval_));
     }
     else
     {
         expiration_ = Timestamp::invalid();
     }
 }
+
+// 向上取整到slack_的整数倍. 所有定时器按同样的边界对齐, slack相同的定时器就会落到同一个时刻.
+Timestamp Timer::roundUp(Timestamp when) const
+{
+    if (slack_ <= 1 || !when.valid())
+    {
+        return when;
+    }
+    int64_t us = when.microSecondsSinceEpoch();
+    return Timestamp((us + slack_ - 1) / slack_ * slack_);
+}
@@ -10,18 +10,47 @@ namespace muduo
 {
     namespace net
     {
+        // Timer对象由TimerQueue的对象池管理, 到期或取消之后放回空闲链表, 下次addTimer时复用, 不会真正delete.
         class Timer : boost::noncopyable
         {
         public:
-            Timer(const TimerCallback &cb, Timestamp when, double interval)
-                : callback_(cb),
-                  expiration_(when),
-                  interval_(interval),
-                  repeat_(interval > 0.0),
-                  sequence_(s_numCreated_.incrementAndGet()) // s_numCreated_是原子类型, 多线程时可以保证sequence_是唯一的.
+            Timer()
+                : interval_(0.0),
+                  slack_(0),
+                  repeat_(false),
+                  sequence_(0),
+                  heapIndex_(-1),
+                  canceled_(false)
             {
             }
 
+            // 从空闲链表中取出时调用, 重新初始化
+            // 参数slack: 允许推迟的秒数, 到期时刻向上取整到slack的整数倍, 相近的定时器落在同一时刻, 一次唤醒处理完.
+            void reset(const TimerCallback &cb, Timestamp when, double interval, double slack)
+            {
+                callback_ = cb;
+                slack_ = static_cast<int64_t>(slack * Timestamp::kMicroSecondsPerSecond);
+                expiration_ = roundUp(when);
+                interval_ = interval;
+                repeat_ = interval > 0.0;
+                sequence_ = s_numCreated_.incrementAndGet(); // s_numCreated_是原子类型, 多线程时可以保证sequence_是唯一的.
+                heapIndex_ = -1;
+                canceled_ = false;
+            }
+
+            // 放回空闲链表时调用. sequence_清零, 过期的TimerId不会再匹配上.
+            void release()
+            {
+                sequence_ = 0;
+                heapIndex_ = -1;
+            }
+
+            // 取走回调函数, 尽早释放它绑定的资源(比如shared_ptr)
+            void swapCallback(TimerCallback *cb)
+            {
+                callback_.swap(*cb);
+            }
+
             void run() const
             {
                 callback_();
@@ -31,17 +60,30 @@ namespace muduo
             bool repeat() const { return repeat_; }
             int64_t sequence() const { return sequence_; }
 
+            // 在TimerQueue的堆中的下标, -1表示不在堆中
+            int heapIndex() const { return heapIndex_; }
+            void setHeapIndex(int index) { heapIndex_ = index; }
+
+            bool canceled() const { return canceled_; }
+            void setCanceled() { canceled_ = true; }
+
             void restart(Timestamp now);
 
             static int64_t numCreated() { return s_numCreated_.get(); }
 
         private:
-            const TimerCallback callback_; // 定时器回调函数
-            Timestamp expiration_;         // 下一次的超时时刻
-            const double interval_;        // 超时时间间隔, 如果是一次性定时器, 该值为0
-            const bool repeat_;            // 是否重复
+            Timestamp roundUp(Timestamp when) const;
+
+            TimerCallback callback_; // 定时器回调函数
+            Timestamp expiration_;   // 下一次的超时时刻
+            double interval_;        // 超时时间间隔, 如果是一次性定时器, 该值为0
+            int64_t slack_;          // 允许推迟的微秒数, 0表示不推迟
+            bool repeat_;            // 是否重复
+
+            int64_t sequence_; // 定时器序号, 每次复用都会变化
+            int heapIndex_;    // 在堆中的位置, 用于O(1)定位要取消的定时器
+            bool canceled_;    // 在回调过程中(不在堆中)被取消
 
-            const int64_t sequence_;          // 定时器序号
             static AtomicInt64 s_numCreated_; // 定时器计数, 当前已经创建的定时器数量
         };
     } // namespace net
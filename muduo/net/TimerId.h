@@ -27,7 +27,7 @@ namespace muduo
             friend class TimerQueue;
 
         private:
-            Timer *timer_;     // 不负责Timer的声明周期, timer_也可能是失效的.
+            Timer *timer_;     // 不负责Timer的声明周期, timer_可能已经被放回对象池或者复用了.
             int64_t sequence_; // 仅仅包含*timer_是不够的, 这样无法区分地址相同的前后两个Timer对象, 因此每一个Timer对象都由一个全局的sequence_序列号.
         };
 
@@ -1,5 +1,3 @@
-#define __STDC_LIMIT_MACROS
-
 #include <boost/bind.hpp>
 #include <sys/timerfd.h>
 
@@ -9,6 +7,8 @@
 #include <muduo/net/Timer.h>
 #include <muduo/net/TimerId.h>
 
+#include <algorithm>
+
 namespace muduo
 {
     namespace net
@@ -78,12 +78,14 @@ using namespace muduo;
 using namespace muduo::net;
 using namespace muduo::net::detail;
 
+const size_t TimerQueue::kHeapArity;
+const size_t TimerQueue::kTimersPerBlock;
+
 TimerQueue::TimerQueue(EventLoop *loop)
     : loop_(loop),
       timerfd_(createTimerfd()),
       timerfdChannel_(loop, timerfd_),
-      timers_(),
-      callingExpiredTimers_(false)
+      armedExpiration_(0)
 {
     timerfdChannel_.setReadCallback(boost::bind(&TimerQueue::handleRead, this));
 
@@ -95,10 +97,10 @@ TimerQueue::~TimerQueue()
 {
     ::close(timerfd_);
     // do not remove channel, since we're in EventLoop::dtor();
-    for (TimerList::iterator it = timers_.begin();
-         it != timers_.end(); ++it)
+    // 所有Timer都在blocks_中, 不管是否在堆中
+    for (size_t i = 0; i < blocks_.size(); ++i)
     {
-        delete it->second;
+        delete[] blocks_[i];
     }
 }
 
@@ -106,59 +108,89 @@ TimerQueue::~TimerQueue()
 // 参数interval: 没隔多久调用一次cb
 TimerId TimerQueue::addTimer(const TimerCallback &cb,
                              Timestamp when,
-                             double interval)
+                             double interval,
+                             double slack)
 {
-    Timer *timer = new Timer(cb, when, interval);
-    loop_->runInLoop(boost::bind(&TimerQueue::addTimerInLoop, this, timer));
-    return TimerId(timer, timer->sequence());
+    Timer *timer = allocTimer(cb, when, interval, slack);
+    TimerId timerId(timer, timer->sequence()); // 在addTimerInLoop之前取, 之后timer可能已经到期被复用了
+    // 在I/O线程中直接插入, 省掉构造Functor的内存分配
+    if (loop_->isInLoopThread())
+    {
+        addTimerInLoop(timer);
+    }
+    else
+    {
+        loop_->queueInLoop(boost::bind(&TimerQueue::addTimerInLoop, this, timer));
+    }
+    return timerId;
 }
 
 void TimerQueue::cancel(TimerId timerId)
 {
-    loop_->runInLoop(boost::bind(&TimerQueue::cancelInLoop, this, timerId));
+    if (loop_->isInLoopThread())
+    {
+        cancelInLoop(timerId);
+    }
+    else
+    {
+        loop_->queueInLoop(boost::bind(&TimerQueue::cancelInLoop, this, timerId));
+    }
 }
 
-// 被addTimer()所调用, 在addTimer()中, 该函数作为loop的runInLoop()参数, 是在IO线程中调用的, 所以对timers_的修改不需要加锁.
+// 被addTimer()所调用, 在I/O线程中执行, 所以对heap_的修改不需要加锁.
 void TimerQueue::addTimerInLoop(Timer *timer)
 {
     loop_->assertInLoopThread(); // 保证不能跨线程调用
 
+    // 跨线程addTimer之后, 在插入之前就被cancel了
+    if (timer->canceled())
+    {
+        freeTimer(timer);
+        return;
+    }
+
     // 插入一个定时器, 有可能会使得最早到期的定时器发生改变
     bool earliestChanged = insert(timer); // 如果timer比TimerQueue中管理的所有定时器都要早, 会使得最早到期的定时器发生改变, 则返回true.
 
     if (earliestChanged)
     {
         // 重置定时器的超时时刻(timerfd_settime)
-        resetTimerfd(timerfd_, timer->expiration());
+        armTimerfd(timer->expiration().microSecondsSinceEpoch());
     }
 }
 
-// 取消一个定时器timerId:
-// 1. 待取消的定时器在timers_和activeTimers_中, 直接取消.
-// 2. "自注销"的情况, 待取消的定时器在handleRead中已经从timers_和activeTimers_取出来了, 而此刻取消定时器的操作又是handleRead()触发的.
-//    此时只要把定时器加入到cancelingTimers_中就可以了, 等待handleRead()之后调用reset()来取消.
+// 取消一个定时器timerId, 通过TimerId中的Timer*直接定位, 不需要查找:
+// 1. sequence不匹配, 说明定时器已经到期或被取消, 并且放回了对象池, 什么也不做.
+// 2. 定时器在堆中, 直接从堆中删除并放回对象池.
+// 3. 不在堆中: "自注销"的情况, 定时器在handleRead中已经从堆中取出来了, 而此刻取消定时器的操作又是handleRead()触发的;
+//    或者跨线程添加的定时器还没有插入. 只做标记, 等handleRead()之后调用reset()或者addTimerInLoop()来回收.
 void TimerQueue::cancelInLoop(TimerId timerId)
 {
     loop_->assertInLoopThread();
-    assert(timers_.size() == activeTimers_.size());
 
-    ActiveTimer timer(timerId.timer_, timerId.sequence_);
-    auto it = activeTimers_.find(timer); // 查找该定时器
-    if (it != activeTimers_.end())       // 找到之后就删除
+    Timer *timer = timerId.timer_;
+    if (timer == NULL)
     {
-        size_t n = timers_.erase(Entry(it->first->expiration(), it->first));
-        assert(n == 1);
-        (void)n;
+        return;
+    }
+    {
+        MutexLockGuard lock(mutex_);
+        if (timer->sequence() != timerId.sequence_)
+        {
+            return;
+        }
+    }
+    // 走到这里, timer一定还没有放回对象池, 只有本线程会回收它, 后面不用加锁
 
-        activeTimers_.erase(it);
-        delete it->first; // 如果用了unique_ptr, 这里就不需要手动删除了
+    if (timer->heapIndex() >= 0)
+    {
+        removeAt(static_cast<size_t>(timer->heapIndex()));
+        freeTimer(timer);
     }
-    else if (callingExpiredTimers_) // "自注销"的情况.
+    else
     {
-        // 加入到cancelingTimers_, 见handleRead(), 等定时器回调函数调用完毕, 在reset()中清理(一次性定时器, 或者已被取消的定时器, 删除该定时器.).
-        cancelingTimers_.insert(timer);
+        timer->setCanceled();
     }
-    assert(timers_.size() == activeTimers_.size());
 }
 
 // 定时器可读时(超时)的回调函数
@@ -167,122 +199,192 @@ void TimerQueue::handleRead()
 {
     loop_->assertInLoopThread();
 
-    Timestamp now(Timestamp::now());
+    // 用poll返回时缓存的时刻, 不再读一次时钟.
+    // 粗粒度时钟可能还没走到堆顶的到期时刻, 这时才读精确时钟, 否则会反复被100微秒后的timerfd唤醒.
+    Timestamp now(loop_->now());
+    if (!heap_.empty() && now.microSecondsSinceEpoch() < heap_.front().when)
+    {
+        now = Timestamp::now();
+    }
     readTimerfd(timerfd_, now); // 清除该事件, 避免一直触发
+    armedExpiration_ = 0;       // 一次性的timerfd已经触发, 需要重新设定
 
-    // 获取该超时时刻之前所有的定时器列表
-    std::vector<Entry> expired = getExpired(now);
-
-    callingExpiredTimers_ = true;
-    cancelingTimers_.clear();
-    for (auto it = expired.begin(); it != expired.end(); ++it)
+    // 从堆顶依次取出该超时时刻之前所有的定时器, expired_的容量会保留下来
+    expired_.clear();
+    const int64_t nowUs = now.microSecondsSinceEpoch();
+    while (!heap_.empty() && heap_.front().when <= nowUs)
     {
-        // 这里回调定时器处理函数
-        it->second->run();
+        expired_.push_back(heap_.front().timer);
+        removeAt(0);
     }
-    // 不是一次性定时器，需要重启
-    callingExpiredTimers_ = false;
-
-    reset(expired, now);
-}
-
-// 从activeTimers_中返回参数now之前(超时)所有的定时器
-std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
-{
-    assert(timers_.size() == activeTimers_.size());
-
-    std::vector<Entry> expired;
-    Entry sentry(now, reinterpret_cast<Timer *>(UINTPTR_MAX)); // 哨兵: 保证了在set中查找时, 即使first相等, second也小于该sentry.
 
-    // 返回第一个未到期的Timer的迭代器. 注意: now < end->first, 而不是 >=, 因为sentry.second是UINTPTR_MAX
-    TimerList::iterator end = timers_.lower_bound(sentry);
-    assert(end == timers_.end() || now < end->first);
-
-    // 将所有到期的定时器插入到expired中
-    std::copy(timers_.begin(), end, std::back_inserter(expired));
-
-    // 从timers_中移除所有到期的定时器
-    timers_.erase(timers_.begin(), end);
-
-    // 从activeTimers_中移除所有到期的定时器
-    for (auto it = expired.begin(); it != expired.end(); ++it)
+    for (size_t i = 0; i < expired_.size(); ++i)
     {
-        ActiveTimer timer(it->second, it->second->sequence());
-        size_t n = activeTimers_.erase(timer);
-        assert(n == 1);
-        (void)n;
+        // 这里回调定时器处理函数, 已被前面的回调取消的不再调用
+        Timer *timer = expired_[i];
+        if (!timer->canceled())
+        {
+            timer->run();
+        }
     }
-
-    assert(timers_.size() == activeTimers_.size());
-
-    return expired; // RVO优化: 就是少了一个临时变量的拷贝构造和析构, VS2019中Debug没有RVO优化, Release有.
+    // 不是一次性定时器，需要重启
+    reset(now);
 }
 
-void TimerQueue::reset(const std::vector<Entry> &expired, Timestamp now)
+void TimerQueue::reset(Timestamp now)
 {
-    Timestamp nextExpire;
-
-    for (std::vector<Entry>::const_iterator it = expired.begin(); it != expired.end(); ++it)
+    for (size_t i = 0; i < expired_.size(); ++i)
     {
-        ActiveTimer timer(it->second, it->second->sequence());
+        Timer *timer = expired_[i];
         // 如果是重复的定时器, 并且是未取消定时器, 则重启该定时器
-        if (it->second->repeat() && cancelingTimers_.find(timer) == cancelingTimers_.end())
+        if (timer->repeat() && !timer->canceled())
         {
-            it->second->restart(now);
-            insert(it->second);
+            timer->restart(now);
+            insert(timer);
         }
         else
         {
-            // 一次性定时器, 或者已被取消的定时器, 删除该定时器.
-            // FIXME move to a free list
-            delete it->second; // FIXME: no delete please
+            // 一次性定时器, 或者已被取消的定时器, 放回对象池.
+            freeTimer(timer);
         }
     }
+    expired_.clear();
 
-    if (!timers_.empty())
+    if (!heap_.empty())
     {
-        // 获取最早到期的定时器超时时间
-        nextExpire = timers_.begin()->second->expiration();
+        // 重置定时器的超时时刻(timerfd_settime)
+        armTimerfd(heap_.front().when);
     }
+}
 
-    if (nextExpire.valid())
+// 最早的定时器被取消之后不重新设定timerfd, 提前醒来一次也没关系, handleRead()之后会按堆顶重新设定.
+// 所以只有新的到期时刻比已设定的更早时才需要调用timerfd_settime.
+// 同一个slack区间里的定时器到期时刻相同, 插入它们不会再触发系统调用.
+void TimerQueue::armTimerfd(int64_t when)
+{
+    if (armedExpiration_ == 0 || when < armedExpiration_)
     {
-        // 重置定时器的超时时刻(timerfd_settime)
-        resetTimerfd(timerfd_, nextExpire);
+        armedExpiration_ = when;
+        resetTimerfd(timerfd_, Timestamp(when));
     }
 }
 
-// 将定时器timer插入到timers_/ActiveTimer中
+// 将定时器timer插入到堆中
 bool TimerQueue::insert(Timer *timer)
 {
     loop_->assertInLoopThread();
-    assert(timers_.size() == activeTimers_.size());
+    assert(timer->heapIndex() < 0);
+
+    HeapEntry entry = {timer->expiration().microSecondsSinceEpoch(), timer};
+    heap_.push_back(entry);
+    siftUp(heap_.size() - 1);
 
     // 最早到期时间是否改变
-    bool earliestChanged = false;
-    Timestamp when = timer->expiration();
-    TimerList::iterator it = timers_.begin();
-    // 如果timers_为空, 或者when小于timers_中的最早到期时间
-    if (it == timers_.end() || when < it->first)
+    return timer->heapIndex() == 0;
+}
+
+void TimerQueue::siftUp(size_t index)
+{
+    HeapEntry entry = heap_[index];
+    while (index > 0)
     {
-        earliestChanged = true;
+        size_t parent = (index - 1) / kHeapArity;
+        if (!(entry.when < heap_[parent].when))
+        {
+            break;
+        }
+        heap_[index] = heap_[parent];
+        heap_[index].timer->setHeapIndex(static_cast<int>(index));
+        index = parent;
     }
+    heap_[index] = entry;
+    entry.timer->setHeapIndex(static_cast<int>(index));
+}
 
-    // 插入到timers_中
+void TimerQueue::siftDown(size_t index)
+{
+    const size_t n = heap_.size();
+    HeapEntry entry = heap_[index];
+    for (;;)
     {
-        std::pair<TimerList::iterator, bool> result = timers_.insert(Entry(when, timer));
-        assert(result.second);
-        (void)result;
+        size_t child = index * kHeapArity + 1;
+        if (child >= n)
+        {
+            break;
+        }
+        // 找出最多4个孩子中最早到期的一个
+        size_t last = std::min(child + kHeapArity, n);
+        size_t smallest = child;
+        for (size_t c = child + 1; c < last; ++c)
+        {
+            if (heap_[c].when < heap_[smallest].when)
+            {
+                smallest = c;
+            }
+        }
+        if (!(heap_[smallest].when < entry.when))
+        {
+            break;
+        }
+        heap_[index] = heap_[smallest];
+        heap_[index].timer->setHeapIndex(static_cast<int>(index));
+        index = smallest;
     }
+    heap_[index] = entry;
+    entry.timer->setHeapIndex(static_cast<int>(index));
+}
 
-    // 插入到activeTimers_中
+// 删除堆中index位置的元素: 用最后一个元素填补空位, 再向上或向下调整
+void TimerQueue::removeAt(size_t index)
+{
+    assert(index < heap_.size());
+    Timer *timer = heap_[index].timer;
+    HeapEntry last = heap_.back();
+    heap_.pop_back();
+    if (index < heap_.size())
     {
-        std::pair<ActiveTimerSet::iterator, bool> result = activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
-        assert(result.second);
-        (void)result;
+        heap_[index] = last;
+        if (index > 0 && last.when < heap_[(index - 1) / kHeapArity].when)
+        {
+            siftUp(index);
+        }
+        else
+        {
+            siftDown(index);
+        }
     }
+    timer->setHeapIndex(-1);
+}
 
-    assert(timers_.size() == activeTimers_.size());
+// 从空闲链表中取一个Timer, 没有就一次分配kTimersPerBlock个
+Timer *TimerQueue::allocTimer(const TimerCallback &cb, Timestamp when, double interval, double slack)
+{
+    MutexLockGuard lock(mutex_);
+    if (freeList_.empty())
+    {
+        Timer *block = new Timer[kTimersPerBlock];
+        blocks_.push_back(block);
+        freeList_.reserve(blocks_.size() * kTimersPerBlock);
+        for (size_t i = kTimersPerBlock; i > 0; --i)
+        {
+            freeList_.push_back(block + i - 1);
+        }
+    }
+    Timer *timer = freeList_.back();
+    freeList_.pop_back();
+    timer->reset(cb, when, interval, slack); // 在锁内修改sequence, 见cancelInLoop()
+    return timer;
+}
 
-    return earliestChanged;
+void TimerQueue::freeTimer(Timer *timer)
+{
+    assert(timer->heapIndex() < 0);
+    // 在锁外析构回调函数, 它绑定的对象析构时可能又会调用addTimer/cancel
+    TimerCallback callback;
+    timer->swapCallback(&callback);
+    {
+        MutexLockGuard lock(mutex_);
+        timer->release();
+        freeList_.push_back(timer);
+    }
 }
@@ -6,7 +6,6 @@
 #include <muduo/net/Callbacks.h>
 #include <muduo/net/Channel.h>
 
-#include <set>
 #include <vector>
 #include <boost/noncopyable.hpp>
 
@@ -26,15 +25,22 @@ namespace muduo
             ~TimerQueue();
 
             // 不直接调用, 而是通过EventLoop的runAt/runAfter/runEvery, cancel所调用.
-            TimerId addTimer(const TimerCallback &cb, Timestamp when, double interval);
+            // 参数slack: 允许推迟的秒数, 见Timer::reset()
+            TimerId addTimer(const TimerCallback &cb, Timestamp when, double interval, double slack = 0.0);
             void cancel(TimerId timerId);
 
         private:
-            typedef std::pair<Timestamp, Timer *> Entry; // 允许有两个定时器的Timestamp是相同的
-            typedef std::set<Entry> TimerList;
-
-            typedef std::pair<Timer *, int64_t> ActiveTimer;
-            typedef std::set<ActiveTimer> ActiveTimerSet;
+            // 堆中的元素, 到期时间放在这里而不是只放Timer*, 比较时不用访问Timer对象, 对cache更友好.
+            struct HeapEntry
+            {
+                int64_t when; // 到期时刻, microSecondsSinceEpoch
+                Timer *timer;
+            };
+
+            // 4叉堆比2叉堆层数少一半, 一个节点的4个孩子通常在同一个cache line里.
+            static const size_t kHeapArity = 4;
+            // 对象池每次分配的Timer个数
+            static const size_t kTimersPerBlock = 256;
 
             // 以下2个成员函数只可能在其所属的I/O线程中调用, 因而不必加锁.
             void addTimerInLoop(Timer *timer);
@@ -42,26 +48,39 @@ namespace muduo
 
             void handleRead();
 
-            std::vector<Entry> getExpired(Timestamp now);
-
             // 重置超时的定时器列表
-            void reset(const std::vector<Entry> &expired, Timestamp now);
+            void reset(Timestamp now);
 
-            // 插入定时器
+            // 插入定时器, 返回最早到期的定时器是否改变
             bool insert(Timer *timer);
 
+            // 只在when比timerfd当前设定的时刻早时才调用timerfd_settime
+            void armTimerfd(int64_t when);
+
+            // 堆操作, 移动元素的同时更新Timer::heapIndex_
+            void siftUp(size_t index);
+            void siftDown(size_t index);
+            void removeAt(size_t index);
+
+            // 对象池, 可能在任意线程调用
+            Timer *allocTimer(const TimerCallback &cb, Timestamp when, double interval, double slack);
+            void freeTimer(Timer *timer);
+
             EventLoop *loop_; // 所属EventLoop
             const int timerfd_;
             Channel timerfdChannel_; // 关注timerfd上的可读事件
+            int64_t armedExpiration_; // timerfd当前设定的到期时刻, 0表示没有设定(或者已经触发)
 
-            // timers_与activeTimers_保存的是相同的数据(目前有效的Timer_*), size相同, 但排序不同. 注意: 在delete Timer*资源时, 只要对其中一个操作即可, 不要两个都操作.
-            TimerList timers_;            // 是按到期时间排序
-            ActiveTimerSet activeTimers_; // 是按对象地址排序
+            std::vector<HeapEntry> heap_; // 按到期时间排序的4叉最小堆, 只在I/O线程中访问
+            std::vector<Timer *> expired_; // handleRead()中到期的定时器, 复用以避免每次分配内存
 
-            // 如下2个成员变量是为了应对"自注销"的情况, 即定时器回调中注销定时器自己, 详见cancelInLoop().
+            // "自注销"(定时器回调中注销定时器自己)不再需要单独的集合, 用Timer::canceled_标记, 详见cancelInLoop().
 
-            bool callingExpiredTimers_;      // 是否正在处理超时定时器
-            ActiveTimerSet cancelingTimers_; // 保存的是被取消的定时器
+            // 对象池. addTimer()可能在其他线程调用, 所以要加锁;
+            // cancelInLoop()比较sequence时也要加锁, 因为空闲的Timer可能正被其他线程复用.
+            MutexLock mutex_;
+            std::vector<Timer *> blocks_;   // 每块kTimersPerBlock个Timer, 析构时释放
+            std::vector<Timer *> freeList_; // 空闲的Timer
         };
 
     } // namespace net
@@ -1,6 +1,7 @@
 #include <muduo/net/http/HttpServer.h>
 
 #include <muduo/base/Logging.h>
+#include <muduo/net/ByteScan.h>
 #include <muduo/net/http/HttpContext.h>
 #include <muduo/net/http/HttpRequest.h>
 #include <muduo/net/http/HttpResponse.h>
@@ -17,17 +18,18 @@ namespace muduo
         namespace detail
         {
             // FIXME: move to HttpContext class
+            // 行内的分隔符用scan::findByte()查找, 和Buffer::findCRLF()一样是SIMD实现.
             bool processRequestLine(const char *begin, const char *end, HttpContext *context)
             {
                 bool succeed = false;
                 const char *start = begin;
-                const char *space = std::find(start, end, ' ');
+                const char *space = scan::findByte(start, end, ' ');
                 HttpRequest &request = context->request();
-                if (space != end && request.setMethod(start, space)) // 解析请求方法
+                if (space && request.setMethod(start, space)) // 解析请求方法
                 {
                     start = space + 1;
-                    space = std::find(start, end, ' ');
-                    if (space != end)
+                    space = scan::findByte(start, end, ' ');
+                    if (space)
                     {
                         request.setPath(start, space); // 解析PATH
                         start = space + 1;
@@ -87,8 +89,8 @@ namespace muduo
                         const char *crlf = buf->findCRLF();
                         if (crlf)
                         {
-                            const char *colon = std::find(buf->peek(), crlf, ':'); //冒号所在位置
-                            if (colon != crlf)
+                            const char *colon = scan::findByte(buf->peek(), crlf, ':'); //冒号所在位置
+                            if (colon)
                             {
                                 context->request().addHeader(buf->peek(), colon, crlf);
                             }
@@ -0,0 +1,154 @@
+#include <muduo/net/inspect/ConnectionInspector.h>
+#include <muduo/net/EventLoop.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+    typedef int64_t (*MetricFunc)(const ConnectionStats &, Timestamp now);
+
+    int64_t bytesIn(const ConnectionStats &s, Timestamp) { return s.bytesReceived; }
+    int64_t bytesOut(const ConnectionStats &s, Timestamp) { return s.bytesSent; }
+    int64_t reads(const ConnectionStats &s, Timestamp) { return s.reads; }
+    int64_t writes(const ConnectionStats &s, Timestamp) { return s.writes; }
+    int64_t peakOutput(const ConnectionStats &s, Timestamp) { return static_cast<int64_t>(s.peakOutputBytes); }
+    int64_t hwmHits(const ConnectionStats &s, Timestamp) { return s.highWaterMarkHits; }
+
+    int64_t idle(const ConnectionStats &s, Timestamp now)
+    {
+        return now.microSecondsSinceEpoch() - s.lastActivity().microSecondsSinceEpoch();
+    }
+
+    int64_t age(const ConnectionStats &s, Timestamp now)
+    {
+        return now.microSecondsSinceEpoch() - s.creationTime.microSecondsSinceEpoch();
+    }
+
+    struct Metric
+    {
+        const char *name;
+        MetricFunc func;
+    };
+
+    const Metric kMetrics[] = {
+        {"bytes_in", bytesIn},
+        {"bytes_out", bytesOut},
+        {"reads", reads},
+        {"writes", writes},
+        {"peak_output", peakOutput},
+        {"hwm_hits", hwmHits},
+        {"idle", idle},
+        {"age", age},
+    };
+    const size_t kNumMetrics = sizeof kMetrics / sizeof kMetrics[0];
+
+    // 从大到小
+    struct ByMetric
+    {
+        ByMetric(MetricFunc f, Timestamp t) : func(f), now(t) {}
+
+        bool operator()(const ConnectionStats &lhs, const ConnectionStats &rhs) const
+        {
+            return func(lhs, now) > func(rhs, now);
+        }
+
+        MetricFunc func;
+        Timestamp now;
+    };
+
+    double seconds(int64_t microSeconds)
+    {
+        return static_cast<double>(microSeconds) / Timestamp::kMicroSecondsPerSecond;
+    }
+} // namespace
+
+ConnectionInspector::ConnectionInspector(const std::vector<EventLoop *> &loops)
+    : loops_(loops)
+{
+}
+
+void ConnectionInspector::registerCommands(Inspector *ins)
+{
+    ins->add("conn", "loops", boost::bind(&ConnectionInspector::loops, this, _1, _2), "print per-loop totals");
+    ins->add("conn", "top", boost::bind(&ConnectionInspector::top, this, _1, _2), "top connections, /conn/top/<metric>/<n>");
+}
+
+string ConnectionInspector::loops(HttpRequest::Method, const Inspector::ArgList &)
+{
+    string result = "loop  conns  total  bytes_in  bytes_out  reads  writes  hwm_hits  spin_polls  spin_ms  block_polls  block_ms\n";
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+        LoopStats stats;
+        loops_[i]->getStats(&stats, NULL);
+        char buf[256];
+        snprintf(buf, sizeof buf, "%zu  %" PRId64 "  %" PRId64 "  %" PRId64 "  %" PRId64 "  %" PRId64 "  %" PRId64 "  %" PRId64
+                                  "  %" PRId64 "  %" PRId64 "  %" PRId64 "  %" PRId64 "\n", i,
+                 stats.connections, stats.totalConnections, stats.bytesReceived, stats.bytesSent,
+                 stats.reads, stats.writes, stats.highWaterMarkHits,
+                 stats.spinPolls, stats.spinMicros / 1000, stats.blockPolls, stats.blockMicros / 1000);
+        result += buf;
+    }
+    return result;
+}
+
+string ConnectionInspector::top(HttpRequest::Method, const Inspector::ArgList &args)
+{
+    const Metric *metric = NULL;
+    if (!args.empty())
+    {
+        for (size_t i = 0; i < kNumMetrics; ++i)
+        {
+            if (args[0] == kMetrics[i].name)
+            {
+                metric = &kMetrics[i];
+            }
+        }
+    }
+    if (metric == NULL)
+    {
+        string result = "usage: /conn/top/<metric>/<n>, metric is one of:";
+        for (size_t i = 0; i < kNumMetrics; ++i)
+        {
+            result += " ";
+            result += kMetrics[i].name;
+        }
+        result += "\n";
+        return result;
+    }
+    size_t n = args.size() > 1 ? static_cast<size_t>(atoi(args[1].c_str())) : 10;
+
+    // 每个loop在自己的线程中拷贝一份, 这里再合并排序
+    std::vector<ConnectionStats> all;
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+        std::vector<ConnectionStats> connections;
+        loops_[i]->getStats(NULL, &connections);
+        all.insert(all.end(), connections.begin(), connections.end());
+    }
+
+    Timestamp now(Timestamp::now());
+    n = std::min(n, all.size());
+    std::partial_sort(all.begin(), all.begin() + n, all.end(), ByMetric(metric->func, now));
+
+    char buf[512];
+    snprintf(buf, sizeof buf, "top %zu of %zu connections by %s\n", n, all.size(), metric->name);
+    string result = buf;
+    result += "name  bytes_in  bytes_out  reads  writes  peak_output  hwm_hits  age  idle\n";
+    for (size_t i = 0; i < n; ++i)
+    {
+        const ConnectionStats &s = all[i];
+        snprintf(buf, sizeof buf, "%s  %" PRId64 "  %" PRId64 "  %" PRId64 "  %" PRId64 "  %zu  %" PRId64 "  %.3f  %.3f\n",
+                 s.name.c_str(), s.bytesReceived, s.bytesSent, s.reads, s.writes,
+                 s.peakOutputBytes, s.highWaterMarkHits, seconds(age(s, now)), seconds(idle(s, now)));
+        result += buf;
+    }
+    return result;
+}
@@ -0,0 +1,34 @@
+#ifndef MUDUO_NET_INSPECT_CONNECTIONINSPECTOR_H
+#define MUDUO_NET_INSPECT_CONNECTIONINSPECTOR_H
+
+#include <muduo/net/inspect/Inspector.h>
+#include <boost/noncopyable.hpp>
+
+#include <vector>
+
+namespace muduo
+{
+    namespace net
+    {
+        // 连接统计页面:
+        //   /conn/loops                 每个EventLoop的累计值
+        //   /conn/top/<metric>/<n>      按metric排序的前n个连接, 不带参数时列出可用的metric
+        // loops通常是TcpServer::threadPool()->getAllLoops(), 查询时这些loop必须在运行.
+        class ConnectionInspector : boost::noncopyable
+        {
+        public:
+            explicit ConnectionInspector(const std::vector<EventLoop *> &loops);
+
+            void registerCommands(Inspector *ins); // 注册命令接口
+
+        private:
+            string loops(HttpRequest::Method, const Inspector::ArgList &);
+            string top(HttpRequest::Method, const Inspector::ArgList &);
+
+            std::vector<EventLoop *> loops_;
+        };
+
+    } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_INSPECT_CONNECTIONINSPECTOR_H
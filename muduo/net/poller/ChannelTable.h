@@ -0,0 +1,70 @@
+#ifndef MUDUO_NET_POLLER_CHANNELTABLE_H
+#define MUDUO_NET_POLLER_CHANNELTABLE_H
+
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <stddef.h>
+
+namespace muduo
+{
+    namespace net
+    {
+        class Channel;
+
+        // fd到Channel*的映射. 内核总是分配最小的可用fd, fd是稠密的小整数, 直接用fd做下标,
+        // 比std::map少了树的查找和每个节点一次的内存分配. 大小只增不减, 最大为进程打开过的最大fd.
+        // Poller内部使用, 不加锁.
+        class ChannelTable : boost::noncopyable
+        {
+        public:
+            ChannelTable()
+                : size_(0)
+            {
+            }
+
+            // 没有返回NULL
+            Channel *find(int fd) const
+            {
+                assert(fd >= 0);
+                return static_cast<size_t>(fd) < channels_.size() ? channels_[fd] : NULL;
+            }
+
+            void insert(int fd, Channel *channel)
+            {
+                assert(fd >= 0 && channel != NULL);
+                if (static_cast<size_t>(fd) >= channels_.size())
+                {
+                    channels_.resize(std::max(static_cast<size_t>(fd) + 1, 2 * channels_.size()), NULL);
+                }
+                assert(channels_[fd] == NULL);
+                channels_[fd] = channel;
+                ++size_;
+            }
+
+            // 返回删除的个数
+            size_t erase(int fd)
+            {
+                if (find(fd) == NULL)
+                {
+                    return 0;
+                }
+                channels_[fd] = NULL;
+                --size_;
+                return 1;
+            }
+
+            size_t size() const { return size_; }
+
+        private:
+            std::vector<Channel *> channels_; // 下标是fd
+            size_t size_;
+        };
+
+    } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_POLLER_CHANNELTABLE_H
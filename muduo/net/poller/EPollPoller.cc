@@ -55,7 +55,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
                                  static_cast<int>(events_.size()),
                                  timeoutMs);
 
-    Timestamp now(Timestamp::now());
+    Timestamp now(currentTime());
     if (numEvents > 0)
     {
         LOG_TRACE << numEvents << " events happended";
@@ -90,10 +90,7 @@ void EPollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels)
     {
         Channel *channel = static_cast<Channel *>(events_[i].data.ptr);
 #ifndef NDEBUG
-        int fd = channel->fd();
-        ChannelMap::const_iterator it = channels_.find(fd);
-        assert(it != channels_.end());
-        assert(it->second == channel);
+        assert(channels_.find(channel->fd()) == channel);
 #endif
         channel->set_revents(events_[i].events);
         activeChannels->push_back(channel);
@@ -113,16 +110,13 @@ void EPollPoller::updateChannel(Channel *channel)
     const int index = channel->index();
     if (index == kNew || index == kDeleted) // 不在epoll树上.
     {
-        int fd = channel->fd();
         if (index == kNew) // 不在channels_
         {
-            assert(channels_.find(fd) == channels_.end());
-            channels_[fd] = channel;
+            channels_.insert(channel->fd(), channel);
         }
         else // 在channels_
         {
-            assert(channels_.find(fd) != channels_.end());
-            assert(channels_[fd] == channel);
+            assert(channels_.find(channel->fd()) == channel);
         }
 
         channel->set_index(kAdded);
@@ -133,10 +127,7 @@ void EPollPoller::updateChannel(Channel *channel)
     else // index == kAdded
     {
         // update existing one with EPOLL_CTL_MOD/DEL
-        int fd = channel->fd();
-        (void)fd;
-        assert(channels_.find(fd) != channels_.end());
-        assert(channels_[fd] == channel);
+        assert(channels_.find(channel->fd()) == channel);
         assert(index == kAdded);
 
         if (channel->isNoneEvent()) // 没有事件, 就从epoll树中删除
@@ -159,8 +150,7 @@ void EPollPoller::removeChannel(Channel *channel)
 
     int fd = channel->fd(); // 保证在channels中
     LOG_TRACE << "fd = " << fd;
-    assert(channels_.find(fd) != channels_.end());
-    assert(channels_[fd] == channel);
+    assert(channels_.find(fd) == channel);
 
     int index = channel->index();
     assert(index == kAdded || index == kDeleted); // 保证在channels中
@@ -181,9 +171,14 @@ void EPollPoller::update(int operation, Channel *channel)
 {
     struct epoll_event event;
     bzero(&event, sizeof event);
-    event.events = channel->events();
+    event.events = channel->pollEvents();
     event.data.ptr = channel;
     int fd = channel->fd();
+    if (operation == EPOLL_CTL_MOD && channel->exclusive()) // EPOLLEXCLUSIVE不能用于EPOLL_CTL_MOD, 只能先删除再添加
+    {
+        ::epoll_ctl(epollfd_, EPOLL_CTL_DEL, fd, NULL);
+        operation = EPOLL_CTL_ADD;
+    }
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
     {
         if (operation == EPOLL_CTL_DEL)
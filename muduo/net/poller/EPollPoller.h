@@ -2,8 +2,8 @@
 #define MUDUO_NET_POLLER_EPOLLPOLLER_H
 
 #include <muduo/net/Poller.h>
+#include <muduo/net/poller/ChannelTable.h>
 
-#include <map>
 #include <vector>
 
 struct epoll_event;
@@ -17,7 +17,6 @@ namespace muduo
         class EPollPoller : public Poller
         {
             typedef std::vector<struct epoll_event> EventList; // muduo使用了epoll_event.data的ptr成员.
-            typedef std::map<int, Channel *> ChannelMap;       // fd到Channel*的映射
 
         public:
             EPollPoller(EventLoop *loop);
@@ -26,6 +25,7 @@ namespace muduo
             virtual Timestamp poll(int timeoutMs, ChannelList *activeChannels);
             virtual void updateChannel(Channel *channel);
             virtual void removeChannel(Channel *channel);
+            virtual bool supportsEdgeTriggered() const { return true; }
 
         private:
             static const int kInitEventListSize = 16;
@@ -39,7 +39,7 @@ namespace muduo
 
             // 1. Poller自己并不拥有Channel, Channel在析构之前(channels_), 必须要unregister(EventLoop::removeChannel), 避免空悬指针.
             // 2. 根据channel的index的含义, 位于channels中的Channel一定在epoll树上, 反之不一定.
-            ChannelMap channels_;
+            ChannelTable channels_; // fd到Channel*的映射
         };
 
     } // namespace net
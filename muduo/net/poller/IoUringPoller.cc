@@ -0,0 +1,660 @@
+#include <muduo/net/poller/IoUringPoller.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/Channel.h>
+
+#include <linux/io_uring.h>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// Channel::index的取值
+namespace
+{
+    const int kNew = -1;
+    const int kAdded = 1;
+
+    const uint64_t kIgnoredUserData = ~0ULL; // IORING_OP_POLL_REMOVE/ASYNC_CANCEL自己的CQE, 不关心结果
+
+    // user_data中的请求类型
+    const int kPollOp = 0;
+    const int kRecvOp = 1;
+    const int kSendOp = 2;
+
+    const uint16_t kBufferGroup = 0; // 接收缓冲区环的bgid
+
+    // io_uring的poll只认poll(2)的事件, 去掉EPOLLET/EPOLLEXCLUSIVE等epoll专用的标志
+    const int kPollMask = POLLIN | POLLPRI | POLLOUT | POLLRDHUP;
+
+    int ioUringSetup(unsigned entries, struct io_uring_params *params)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int ioUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags,
+                     const void *arg, size_t argSize)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, arg, argSize));
+    }
+
+    void *mapRing(int ringFd, size_t size, uint64_t offset)
+    {
+        void *p = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, static_cast<off_t>(offset));
+        if (p == MAP_FAILED)
+        {
+            LOG_SYSFATAL << "IoUringPoller mmap";
+        }
+        return p;
+    }
+
+    template <typename T>
+    T *ringField(void *ring, unsigned offset)
+    {
+        return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+    }
+
+    // user_data的低30位是fd, 接着2位是请求类型, 高32位是PollState::generation
+    uint64_t makeUserData(int fd, int op, uint32_t generation)
+    {
+        assert(fd < (1 << 30));
+        return (static_cast<uint64_t>(generation) << 32) | (static_cast<uint64_t>(op) << 30) | static_cast<uint32_t>(fd);
+    }
+
+    int ioUringRegister(int ringFd, unsigned opcode, void *arg, unsigned nrArgs)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_register, ringFd, opcode, arg, nrArgs));
+    }
+
+    int pollMask(const Channel *channel)
+    {
+        return channel->isNoneEvent() ? 0 : channel->pollEvents() & kPollMask;
+    }
+} // namespace
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop),
+      ringFd_(-1),
+      pollUpdate_(false),
+      sqRing_(NULL),
+      sqRingSize_(0),
+      cqRing_(NULL),
+      cqRingSize_(0),
+      sqes_(NULL),
+      sqesSize_(0),
+      sqLocalTail_(0),
+      round_(0),
+      bufRing_(NULL),
+      recvBuffers_(NULL),
+      bufTail_(0)
+{
+    // COOP_TASKRUN: 完成事件在IO线程下一次进入内核时处理, 不用打断正在处理事件的IO线程. 老的内核不支持时退回.
+    // 不用DEFER_TASKRUN, 它每次io_uring_enter只处理很少几个完成事件, 一轮就绪很多fd时要进出内核很多次.
+    const unsigned kSetupFlags[] = {
+        IORING_SETUP_CLAMP | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG,
+        IORING_SETUP_CLAMP,
+    };
+    struct io_uring_params params;
+    for (size_t i = 0; i < sizeof kSetupFlags / sizeof kSetupFlags[0] && ringFd_ < 0; ++i)
+    {
+        bzero(&params, sizeof params);
+        params.flags = kSetupFlags[i];
+        ringFd_ = ioUringSetup(kRingEntries, &params);
+    }
+    if (ringFd_ < 0)
+    {
+        LOG_SYSFATAL << "IoUringPoller::IoUringPoller";
+    }
+    // NODROP: CQ满了内核先缓存起来, 不丢事件. EXT_ARG: io_uring_enter可以带超时.
+    if (!(params.features & IORING_FEAT_NODROP) || !(params.features & IORING_FEAT_EXT_ARG))
+    {
+        LOG_FATAL << "IoUringPoller needs Linux 5.11 or later";
+    }
+    // multishot poll(IORING_POLL_ADD_MULTI)和原地修改(IORING_POLL_UPDATE_EVENTS)是5.13加入的, 没有单独的feature位,
+    // 用同一个版本加入的IORING_FEAT_RSRC_TAGS判断. 不支持时都用一次性的poll, 修改事件时先取消再重新提交.
+    pollUpdate_ = (params.features & IORING_FEAT_RSRC_TAGS) != 0;
+    if (!pollUpdate_)
+    {
+        LOG_INFO << "IoUringPoller: no multishot poll before Linux 5.13, using one-shot polls";
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+    sqRing_ = mapRing(ringFd_, sqRingSize_, IORING_OFF_SQ_RING);
+    cqRing_ = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqRing_ : mapRing(ringFd_, cqRingSize_, IORING_OFF_CQ_RING);
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe *>(mapRing(ringFd_, sqesSize_, IORING_OFF_SQES));
+
+    sqHead_ = ringField<unsigned>(sqRing_, params.sq_off.head);
+    sqTail_ = ringField<unsigned>(sqRing_, params.sq_off.tail);
+    sqFlags_ = ringField<unsigned>(sqRing_, params.sq_off.flags);
+    sqArray_ = ringField<unsigned>(sqRing_, params.sq_off.array);
+    sqMask_ = *ringField<unsigned>(sqRing_, params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqLocalTail_ = *sqTail_;
+
+    cqHead_ = ringField<unsigned>(cqRing_, params.cq_off.head);
+    cqTail_ = ringField<unsigned>(cqRing_, params.cq_off.tail);
+    cqes_ = ringField<struct io_uring_cqe>(cqRing_, params.cq_off.cqes);
+    cqMask_ = *ringField<unsigned>(cqRing_, params.cq_off.ring_mask);
+
+    setupRecvBuffers();
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    ::munmap(sqes_, sqesSize_);
+    if (cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    ::munmap(sqRing_, sqRingSize_);
+    ::close(ringFd_); // 内核中剩下的poll请求随之取消
+    if (bufRing_)
+    {
+        ::munmap(recvBuffers_, kRecvBuffers * kRecvBufferSize);
+        ::munmap(bufRing_, kRecvBuffers * sizeof(struct io_uring_buf));
+    }
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    ++round_;
+    recycleRecvBuffers(); // 上一轮的RecvCallback都已经返回
+    rearmPolls();
+
+    // CQ中已经有事件就不等了
+    bool ready = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_;
+    int ret = enter(ready || timeoutMs == 0 ? 0 : 1, timeoutMs);
+    int savedErrno = errno;
+    Timestamp now(currentTime());
+
+    fillActiveChannels(activeChannels);
+    if (!activeChannels->empty())
+    {
+        LOG_TRACE << activeChannels->size() << " events happended";
+    }
+    else if (ret >= 0 || savedErrno == ETIME || savedErrno == EINTR)
+    {
+        LOG_TRACE << " nothing happended";
+    }
+    else
+    {
+        errno = savedErrno;
+        LOG_SYSERR << "IoUringPoller::poll()";
+    }
+    return now;
+}
+
+// 只修改提交队列, 在下一次poll()中和等待一起提交
+void IoUringPoller::updateChannel(Channel *channel)
+{
+    Poller::assertInLoopThread();
+    LOG_TRACE << "fd = " << channel->fd() << " events = " << channel->events();
+
+    const int fd = channel->fd();
+    PollState &state = attach(channel);
+    const int events = pollMask(channel);
+    const bool multishot = channel->edgeTriggered() && pollUpdate_;
+    state.rearm = false;
+    if (state.events == 0)
+    {
+        if (events != 0)
+        {
+            armPoll(fd, &state, events, multishot);
+        }
+    }
+    else if (events == 0)
+    {
+        cancelPoll(fd, &state);
+    }
+    else if (events != state.events || multishot != state.multishot)
+    {
+        modifyPoll(fd, &state, events, multishot);
+    }
+}
+
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    Poller::assertInLoopThread();
+    LOG_TRACE << "fd = " << channel->fd();
+    assert(channel->isNoneEvent());
+    assert(channel->index() == kAdded);
+
+    PollState &state = stateOf(channel->fd());
+    assert(state.channel == channel);
+    assert(!state.sending); // 内核可能还在读要发送的数据, 见Channel::sendAsync()
+    if (state.events != 0)
+    {
+        cancelPoll(channel->fd(), &state);
+    }
+    if (state.recvArmed)
+    {
+        cancelRequest(makeUserData(channel->fd(), kRecvOp, state.generation));
+    }
+    state.channel = NULL;
+    state.rearm = false;
+    state.recvArmed = false;
+    state.recvWanted = false;
+    state.staleRecvs = 0;
+    ++state.generation;
+    channel->set_index(kNew);
+}
+
+IoUringPoller::PollState &IoUringPoller::stateOf(int fd)
+{
+    assert(fd >= 0);
+    if (static_cast<size_t>(fd) >= states_.size())
+    {
+        PollState empty = {NULL, 0, 0, false, false, -1, 0, 0, false, false, false};
+        states_.resize(std::max(static_cast<size_t>(fd) + 1, 2 * states_.size()), empty);
+    }
+    return states_[fd];
+}
+
+// 第一次updateChannel()/startRecv()/sendAsync()时登记Channel
+IoUringPoller::PollState &IoUringPoller::attach(Channel *channel)
+{
+    PollState &state = stateOf(channel->fd());
+    if (channel->index() == kNew)
+    {
+        assert(state.channel == NULL);
+        state.channel = channel;
+        channel->set_index(kAdded);
+    }
+    assert(state.channel == channel);
+    return state;
+}
+
+// 同一个Channel在一轮中只放进activeChannels一次
+void IoUringPoller::markActive(int fd, PollState *state)
+{
+    if (state->round != round_)
+    {
+        state->round = round_;
+        state->revents = 0;
+        activeFds_.push_back(fd);
+    }
+}
+
+struct io_uring_sqe *IoUringPoller::getSqe()
+{
+    if (sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+    {
+        // 提交队列满了, 先提交, 不等待
+        if (enter(0, 0) < 0 && sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+        {
+            LOG_SYSFATAL << "IoUringPoller::getSqe";
+        }
+    }
+    const unsigned index = sqLocalTail_ & sqMask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    bzero(sqe, sizeof *sqe);
+    sqArray_[index] = index;
+    ++sqLocalTail_;
+    return sqe;
+}
+
+void IoUringPoller::armPoll(int fd, PollState *state, int events, bool multishot)
+{
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = static_cast<uint32_t>(events);
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = makeUserData(fd, kPollOp, state->generation);
+    state->events = events;
+    state->multishot = multishot;
+}
+
+// 原地修改已提交的poll关注的事件, user_data不变. 如果这个poll刚好已经完成, 修改会失败,
+// 之后收到它的CQE时按Channel当前关注的事件重新提交. 内核不支持原地修改时取消之后重新提交.
+void IoUringPoller::modifyPoll(int fd, PollState *state, int events, bool multishot)
+{
+    if (!pollUpdate_)
+    {
+        cancelPoll(fd, state);
+        armPoll(fd, state, events, multishot);
+        return;
+    }
+
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, kPollOp, state->generation);
+    sqe->len = IORING_POLL_UPDATE_EVENTS | (multishot ? IORING_POLL_ADD_MULTI : 0);
+    sqe->poll32_events = static_cast<uint32_t>(events);
+    sqe->user_data = kIgnoredUserData;
+    state->events = events;
+    state->multishot = multishot;
+}
+
+// 取消之后generation加一, 旧请求已经在CQ中或者以后到达的CQE都对不上
+void IoUringPoller::cancelPoll(int fd, PollState *state)
+{
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, kPollOp, state->generation);
+    sqe->user_data = kIgnoredUserData;
+    ++state->generation;
+    state->events = 0;
+}
+
+// 上一轮完成的一次性poll, 如果Channel没有在事件处理中修改关注的事件, 按原样重新提交
+void IoUringPoller::rearmPolls()
+{
+    for (size_t i = 0; i < rearmFds_.size(); ++i)
+    {
+        const int fd = rearmFds_[i];
+        PollState &state = states_[fd];
+        if (state.rearm)
+        {
+            state.rearm = false;
+            int events = state.channel ? pollMask(state.channel) : 0;
+            if (state.events == 0 && events != 0)
+            {
+                armPoll(fd, &state, events, state.channel->edgeTriggered() && pollUpdate_);
+            }
+        }
+        if (state.recvWanted && !state.recvArmed)
+        {
+            armRecv(fd, &state);
+        }
+    }
+    rearmFds_.clear();
+}
+
+void IoUringPoller::startRecv(Channel *channel)
+{
+    Poller::assertInLoopThread();
+    assert(bufRing_ != NULL);
+    PollState &state = attach(channel);
+    state.recvWanted = true;
+    if (!state.recvArmed)
+    {
+        armRecv(channel->fd(), &state);
+    }
+}
+
+// 取消之后被取消的recv还会有一个结束的CQE, 在它之前收到的数据照常交给Channel
+void IoUringPoller::stopRecv(Channel *channel)
+{
+    Poller::assertInLoopThread();
+    PollState &state = attach(channel);
+    state.recvWanted = false;
+    if (state.recvArmed)
+    {
+        cancelRequest(makeUserData(channel->fd(), kRecvOp, state.generation));
+        state.recvArmed = false;
+        ++state.staleRecvs;
+    }
+}
+
+void IoUringPoller::sendAsync(Channel *channel, const struct msghdr *msg)
+{
+    Poller::assertInLoopThread();
+    assert(msg->msg_iovlen > 0);
+    PollState &state = attach(channel);
+    assert(!state.sending);
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->fd = channel->fd();
+    if (msg->msg_iovlen == 1)
+    {
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = reinterpret_cast<uint64_t>(msg->msg_iov[0].iov_base);
+        sqe->len = static_cast<uint32_t>(msg->msg_iov[0].iov_len);
+    }
+    else
+    {
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = reinterpret_cast<uint64_t>(msg);
+        sqe->len = 1;
+    }
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = makeUserData(channel->fd(), kSendOp, state.generation);
+    state.sending = true;
+}
+
+// 被取消的send以-ECANCELED或者已经发送的字节数完成
+void IoUringPoller::cancelSend(Channel *channel)
+{
+    Poller::assertInLoopThread();
+    PollState &state = attach(channel);
+    if (state.sending)
+    {
+        cancelRequest(makeUserData(channel->fd(), kSendOp, state.generation));
+    }
+}
+
+void IoUringPoller::armRecv(int fd, PollState *state)
+{
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = makeUserData(fd, kRecvOp, state->generation);
+    state->recvArmed = true;
+}
+
+void IoUringPoller::cancelRequest(uint64_t userData)
+{
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = userData;
+    sqe->user_data = kIgnoredUserData;
+}
+
+// 注册kRecvBuffers个接收缓冲区. 内存是匿名映射, 用到的时候才分配物理页. 内核不支持(6.0之前)时不能用完成式IO.
+void IoUringPoller::setupRecvBuffers()
+{
+    const size_t ringSize = kRecvBuffers * sizeof(struct io_uring_buf);
+    void *ring = ::mmap(NULL, ringSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void *buffers = ::mmap(NULL, kRecvBuffers * kRecvBufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED || buffers == MAP_FAILED)
+    {
+        LOG_SYSFATAL << "IoUringPoller::setupRecvBuffers";
+    }
+
+    struct io_uring_buf_reg reg;
+    bzero(&reg, sizeof reg);
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = kRecvBuffers;
+    reg.bgid = kBufferGroup;
+    if (ioUringRegister(ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        LOG_WARN << "IoUringPoller IORING_REGISTER_PBUF_RING failed, completion I/O disabled: " << strerror_tl(errno);
+        ::munmap(buffers, kRecvBuffers * kRecvBufferSize);
+        ::munmap(ring, ringSize);
+        return;
+    }
+
+    bufRing_ = static_cast<struct io_uring_buf *>(ring);
+    recvBuffers_ = static_cast<char *>(buffers);
+    for (unsigned bid = 0; bid < kRecvBuffers; ++bid)
+    {
+        usedBuffers_.push_back(static_cast<unsigned short>(bid));
+    }
+    recycleRecvBuffers();
+}
+
+// 把用过的缓冲区放回环中. 环的tail在第一项的resv字段, 见struct io_uring_buf_ring.
+void IoUringPoller::recycleRecvBuffers()
+{
+    if (usedBuffers_.empty())
+    {
+        return;
+    }
+    for (size_t i = 0; i < usedBuffers_.size(); ++i)
+    {
+        const unsigned short bid = usedBuffers_[i];
+        struct io_uring_buf &buf = bufRing_[bufTail_ & (kRecvBuffers - 1)];
+        buf.addr = reinterpret_cast<uint64_t>(recvBuffers_ + bid * kRecvBufferSize);
+        buf.len = kRecvBufferSize;
+        buf.bid = bid;
+        ++bufTail_;
+    }
+    __atomic_store_n(&bufRing_[0].resv, bufTail_, __ATOMIC_RELEASE);
+    usedBuffers_.clear();
+}
+
+// multishot recv的CQE. 每个recv请求最后有一个不带F_MORE的CQE表示结束.
+void IoUringPoller::handleRecv(int fd, PollState *state, const struct io_uring_cqe &cqe)
+{
+    bool current = true;
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+    {
+        if (state->staleRecvs > 0) // stopRecv()取消的recv按提交顺序先结束
+        {
+            --state->staleRecvs;
+            current = false;
+        }
+        else
+        {
+            state->recvArmed = false;
+        }
+    }
+
+    if (cqe.flags & IORING_CQE_F_BUFFER)
+    {
+        const unsigned short bid = static_cast<unsigned short>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        usedBuffers_.push_back(bid);
+        if (cqe.res > 0)
+        {
+            markActive(fd, state);
+            state->channel->addCompletion(recvBuffers_ + bid * kRecvBufferSize, cqe.res, false);
+        }
+    }
+
+    if (!current || state->recvArmed)
+    {
+        return;
+    }
+    if (cqe.res > 0 || cqe.res == -ENOBUFS) // 缓冲区用完了, 下一轮还回来之后重新提交
+    {
+        if (state->recvWanted)
+        {
+            rearmFds_.push_back(fd);
+        }
+    }
+    else // 对方关闭或者出错
+    {
+        state->recvWanted = false;
+        markActive(fd, state);
+        state->channel->addCompletion(NULL, cqe.res, false);
+    }
+}
+
+// 提交所有填好的SQE, 最多等待timeoutMs毫秒直到至少有minComplete个CQE. 总是带上GETEVENTS, 让内核把溢出的CQE搬回CQ.
+int IoUringPoller::enter(unsigned minComplete, int timeoutMs)
+{
+    __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+    const unsigned toSubmit = sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (toSubmit == 0 && minComplete == 0 &&
+        !(__atomic_load_n(sqFlags_, __ATOMIC_RELAXED) & (IORING_SQ_CQ_OVERFLOW | IORING_SQ_TASKRUN)))
+    {
+        return 0; // 忙轮询时没有要提交和收割的就不进内核
+    }
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    bzero(&arg, sizeof arg);
+    if (minComplete > 0 && timeoutMs >= 0)
+    {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    return ioUringEnter(ringFd_, toSubmit, minComplete, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+}
+
+// 收割CQ, 把就绪的Channel放到activeChannels中. 同一个Channel在一轮中只出现一次.
+void IoUringPoller::fillActiveChannels(ChannelList *activeChannels)
+{
+    unsigned head = *cqHead_;
+    const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        const struct io_uring_cqe &cqe = cqes_[head & cqMask_];
+        if (cqe.user_data == kIgnoredUserData)
+        {
+            continue;
+        }
+        const int fd = static_cast<int>(cqe.user_data & ((1 << 30) - 1));
+        const int op = static_cast<int>((cqe.user_data >> 30) & 3);
+        const uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+        if (static_cast<size_t>(fd) >= states_.size())
+        {
+            continue;
+        }
+        PollState &state = states_[fd];
+        if (state.channel == NULL || state.generation != generation) // 已经取消或替换的请求
+        {
+            if (cqe.flags & IORING_CQE_F_BUFFER)
+            {
+                usedBuffers_.push_back(static_cast<unsigned short>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+            continue;
+        }
+        if (op == kRecvOp)
+        {
+            handleRecv(fd, &state, cqe);
+            continue;
+        }
+        if (op == kSendOp)
+        {
+            state.sending = false;
+            markActive(fd, &state);
+            state.channel->addCompletion(NULL, cqe.res, true);
+            continue;
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_MORE)) // poll请求结束了: 一次性的poll完成, multishot被内核终止, 或者出错
+        {
+            // 出错时也按Channel当前关注的事件重新提交, 和epoll一样, 错误交给Channel处理, 不会悄悄地不再通知
+            state.events = 0;
+            state.rearm = true;
+            rearmFds_.push_back(fd);
+        }
+        if (cqe.res == -ECANCELED) // 被内核取消(自己取消的generation对不上, 到不了这里), 重新提交就行
+        {
+            continue;
+        }
+        markActive(fd, &state);
+        if (cqe.res < 0)
+        {
+            LOG_ERROR << "IoUringPoller poll fd = " << fd << " error = " << strerror_tl(-cqe.res);
+            state.revents |= POLLERR; // 由Channel的ErrorCallback处理
+        }
+        else
+        {
+            state.revents |= cqe.res;
+        }
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+    for (size_t i = 0; i < activeFds_.size(); ++i)
+    {
+        PollState &state = states_[activeFds_[i]];
+        state.channel->set_revents(state.revents);
+        activeChannels->push_back(state.channel);
+    }
+    activeFds_.clear();
+}
@@ -0,0 +1,123 @@
+#ifndef MUDUO_NET_POLLER_IOURINGPOLLER_H
+#define MUDUO_NET_POLLER_IOURINGPOLLER_H
+
+#include <muduo/net/Poller.h>
+
+#include <vector>
+
+#include <stdint.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf;
+
+namespace muduo
+{
+    namespace net
+    {
+        ///
+        /// IO Multiplexing with io_uring(7) IORING_OP_POLL_ADD.
+        ///
+        // updateChannel()/removeChannel()只把SQE放进提交队列, 下一次poll()时和等待事件合并成一次io_uring_enter,
+        // 修改关注的事件不再是每次一个epoll_ctl系统调用.
+        // 边沿触发的Channel使用multishot poll, 一直有效. 水平触发的Channel使用一次性的poll, 事件处理完之后在下一次poll()中
+        // 重新提交, 还是就绪的话马上完成, 效果和epoll的水平触发相同. 需要Linux 5.11以上, 5.13以下没有multishot poll,
+        // 边沿触发的Channel也用一次性的poll(效果是水平触发, Channel本来就会读写到EAGAIN).
+        // poll请求出错时向Channel报告POLLERR.
+        // 直接使用系统调用, 不依赖liburing. 通过环境变量MUDUO_USE_URING选择, 见DefaultPoller.cc.
+        //
+        // 完成式IO(Linux 6.0以上): multishot IORING_OP_RECV从内核提供的缓冲区环(IORING_REGISTER_PBUF_RING)中取缓冲区,
+        // 数据直接交给Channel::RecvCallback, 缓冲区在下一次poll()时还给内核; IORING_OP_SEND/SENDMSG发送调用者的数据.
+        // 它们的SQE同样在下一次poll()时一起提交.
+        class IoUringPoller : public Poller
+        {
+        public:
+            IoUringPoller(EventLoop *loop);
+            virtual ~IoUringPoller();
+
+            virtual Timestamp poll(int timeoutMs, ChannelList *activeChannels);
+            virtual void updateChannel(Channel *channel);
+            virtual void removeChannel(Channel *channel);
+            virtual bool supportsEdgeTriggered() const { return true; }
+
+            virtual bool supportsCompletionIo() const { return bufRing_ != NULL; }
+            virtual void startRecv(Channel *channel);
+            virtual void stopRecv(Channel *channel);
+            virtual void sendAsync(Channel *channel, const struct msghdr *msg);
+            virtual void cancelSend(Channel *channel);
+
+        private:
+            // 每个fd上的poll请求, 下标是fd
+            struct PollState
+            {
+                Channel *channel;
+                uint32_t generation; // 编进user_data, 被取消或替换的请求的CQE对不上, 直接丢弃
+                int events;          // 已提交的poll关注的事件, 0表示内核中没有poll请求
+                bool multishot;
+                bool rearm;          // 一次性的poll已经完成, 在下一次poll()中重新提交
+                int64_t round;       // 最近一次就绪时的poll()轮次, 同一轮中multishot的多个CQE合并成一个事件
+                int revents;
+
+                int staleRecvs;  // stopRecv()取消了, 还没有收到结束CQE的recv个数
+                bool recvArmed;  // 内核中有multishot recv
+                bool recvWanted; // Channel在接收, recv因为缓冲区用完(ENOBUFS)结束时在下一次poll()中重新提交
+                bool sending;    // 有一个send还没有完成
+            };
+
+            static const unsigned kRingEntries = 4096;
+            static const unsigned kRecvBuffers = 512; // 2的幂
+            static const unsigned kRecvBufferSize = 8192;
+
+            PollState &stateOf(int fd);
+            PollState &attach(Channel *channel);
+            void markActive(int fd, PollState *state);
+            struct io_uring_sqe *getSqe();
+            void armPoll(int fd, PollState *state, int events, bool multishot);
+            void modifyPoll(int fd, PollState *state, int events, bool multishot);
+            void cancelPoll(int fd, PollState *state);
+            void rearmPolls();
+            void armRecv(int fd, PollState *state);
+            void cancelRequest(uint64_t userData);
+            void setupRecvBuffers();
+            void recycleRecvBuffers();
+            void handleRecv(int fd, PollState *state, const struct io_uring_cqe &cqe);
+            int enter(unsigned minComplete, int timeoutMs);
+            void fillActiveChannels(ChannelList *activeChannels);
+
+            int ringFd_;
+            bool pollUpdate_; // 内核支持multishot poll和IORING_POLL_UPDATE_EVENTS(Linux 5.13)
+            void *sqRing_;
+            size_t sqRingSize_;
+            void *cqRing_; // 内核支持IORING_FEAT_SINGLE_MMAP时和sqRing_是同一块
+            size_t cqRingSize_;
+            struct io_uring_sqe *sqes_;
+            size_t sqesSize_;
+
+            unsigned *sqHead_; // 内核消费到的位置
+            unsigned *sqTail_;
+            unsigned *sqFlags_;
+            unsigned *sqArray_;
+            unsigned sqMask_;
+            unsigned sqEntries_;
+            unsigned sqLocalTail_; // 已经填好, 还没有提交的SQE的尾部
+
+            unsigned *cqHead_;
+            unsigned *cqTail_;
+            struct io_uring_cqe *cqes_;
+            unsigned cqMask_;
+
+            std::vector<PollState> states_;
+            std::vector<int> rearmFds_;  // 等待重新提交的fd
+            std::vector<int> activeFds_; // 本轮就绪的fd
+            int64_t round_;
+
+            struct io_uring_buf *bufRing_; // 内核不支持完成式IO时为NULL
+            char *recvBuffers_;             // kRecvBuffers个kRecvBufferSize字节的缓冲区
+            unsigned short bufTail_;
+            std::vector<unsigned short> usedBuffers_; // 本轮交给Channel的缓冲区, 下一次poll()时还给内核
+        };
+
+    } // namespace net
+} // namespace muduo
+
+#endif // MUDUO_NET_POLLER_IOURINGPOLLER_H
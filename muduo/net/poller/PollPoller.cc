@@ -31,7 +31,7 @@ Timestamp PollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
     // XXX pollfds_ shouldn't change
     int numEvents = ::poll(&*pollfds_.begin(), pollfds_.size(), timeoutMs);
-    Timestamp now(Timestamp::now());
+    Timestamp now(currentTime());
     if (numEvents > 0)
     {
         LOG_TRACE << numEvents << " events happended";
@@ -55,9 +55,8 @@ void PollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels)
         if (pfd->revents > 0)
         {
             --numEvents;
-            ChannelMap::const_iterator ch = channels_.find(pfd->fd);
-            assert(ch != channels_.end());
-            Channel *channel = ch->second;
+            Channel *channel = channels_.find(pfd->fd);
+            assert(channel != NULL);
             assert(channel->fd() == pfd->fd);
             channel->set_revents(pfd->revents);
             // pfd->revents = 0;
@@ -74,7 +73,6 @@ void PollPoller::updateChannel(Channel *channel)
     if (channel->index() < 0)
     {
         // a new one, add to pollfds_
-        assert(channels_.find(channel->fd()) == channels_.end());
         struct pollfd pfd;
         pfd.fd = channel->fd();
         pfd.events = static_cast<short>(channel->events());
@@ -82,13 +80,12 @@ void PollPoller::updateChannel(Channel *channel)
         pollfds_.push_back(pfd);
         int idx = static_cast<int>(pollfds_.size()) - 1;
         channel->set_index(idx);
-        channels_[pfd.fd] = channel;
+        channels_.insert(pfd.fd, channel);
     }
     else
     {
         // update existing one
-        assert(channels_.find(channel->fd()) != channels_.end());
-        assert(channels_[channel->fd()] == channel);
+        assert(channels_.find(channel->fd()) == channel);
         int idx = channel->index();
         assert(0 <= idx && idx < static_cast<int>(pollfds_.size()));
         struct pollfd &pfd = pollfds_[idx];
@@ -107,8 +104,7 @@ void PollPoller::removeChannel(Channel *channel)
 {
     Poller::assertInLoopThread();
     LOG_TRACE << "fd = " << channel->fd();
-    assert(channels_.find(channel->fd()) != channels_.end());
-    assert(channels_[channel->fd()] == channel);
+    assert(channels_.find(channel->fd()) == channel);
     assert(channel->isNoneEvent());
     int idx = channel->index();
     assert(0 <= idx && idx < static_cast<int>(pollfds_.size()));
@@ -130,7 +126,7 @@ void PollPoller::removeChannel(Channel *channel)
         {
             channelAtEnd = -channelAtEnd - 1;
         }
-        channels_[channelAtEnd]->set_index(idx);
+        channels_.find(channelAtEnd)->set_index(idx);
         pollfds_.pop_back();
     }
 }
@@ -2,8 +2,8 @@
 #define MUDUO_NET_POLLER_POLLPOLLER_H
 
 #include <muduo/net/Poller.h>
+#include <muduo/net/poller/ChannelTable.h>
 
-#include <map>
 #include <vector>
 
 // 并没有include <poll.h>, 而是前向声明.
@@ -19,7 +19,6 @@ namespace muduo
         class PollPoller : public Poller
         {
             typedef std::vector<struct pollfd> PollFdList;
-            typedef std::map<int, Channel *> ChannelMap;
 
         public:
             PollPoller(EventLoop *loop);
@@ -33,7 +32,7 @@ namespace muduo
             void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
 
             PollFdList pollfds_;
-            ChannelMap channels_;
+            ChannelTable channels_;
         };
 
     } // namespace net
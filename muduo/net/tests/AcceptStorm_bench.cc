@@ -0,0 +1,188 @@
+#include <muduo/base/Atomic.h>
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Mutex.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 连接风暴: 客户端一次发起burst个连接, 每个连接建立后马上发送8字节的发起连接时的时间戳, 服务端收到后记录
+// 从connect()到服务端处理第一条消息的时间(accept延迟). 这一批都到了之后关闭它们, 再发起下一批.
+// 比较每次可读事件accept一个连接和一直accept到EAGAIN(TcpServer::setMaxAcceptsPerWakeup()), 以及baseloop accept
+// 和每个loop各自accept(TcpServer::setAcceptPerLoop()). 报告每秒建立的连接数, accept延迟, 以及服务端每个连接的事件循环次数.
+
+AtomicInt32 g_connections; // 服务端当前的连接数
+AtomicInt32 g_received;    // 本批收到时间戳的连接数
+MutexLock g_mutex;
+std::vector<int64_t> g_latencies; // 微秒
+int64_t g_serverIterations = 0;
+
+void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        g_connections.increment();
+    }
+    else
+    {
+        g_connections.decrement();
+    }
+}
+
+void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    if (buf->readableBytes() >= sizeof(int64_t))
+    {
+        int64_t sent = 0;
+        ::memcpy(&sent, buf->peek(), sizeof sent);
+        buf->retrieve(sizeof sent);
+        int64_t latency = Timestamp::now().microSecondsSinceEpoch() - sent;
+        {
+            MutexLockGuard lock(g_mutex);
+            g_latencies.push_back(latency);
+        }
+        g_received.increment();
+    }
+}
+
+void runServer(uint16_t port, int threads, int maxAccepts, bool perLoop, EventLoop **serverLoop, CountDownLatch *latch)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "storm");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setThreadNum(threads);
+    server.setMaxAcceptsPerWakeup(maxAccepts);
+    server.setAcceptPerLoop(perLoop);
+    server.start();
+    *serverLoop = &loop;
+    latch->countDown();
+
+    loop.loop();
+
+    // IO线程还在运行, 这里只是读一下计数, 用作统计
+    g_serverIterations = loop.iteration();
+    std::vector<EventLoop *> loops(server.threadPool()->getAllLoops());
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        if (loops[i] != &loop)
+        {
+            g_serverIterations += loops[i]->iteration();
+        }
+    }
+}
+
+bool waitFor(AtomicInt32 *counter, int value)
+{
+    for (int i = 0; i < 100000 && counter->get() != value; ++i)
+    {
+        ::usleep(100);
+    }
+    return counter->get() == value;
+}
+
+void runBench(uint16_t port, int threads, int maxAccepts, bool perLoop, int burst, int bursts)
+{
+    EventLoop *serverLoop = NULL;
+    CountDownLatch latch(1);
+    Thread thread(boost::bind(runServer, port, threads, maxAccepts, perLoop, &serverLoop, &latch));
+    thread.start();
+    latch.wait();
+    ::usleep(100 * 1000); // 每个loop各自accept时, 等它们开始listen
+
+    g_latencies.clear();
+    struct sockaddr_in serverAddr = InetAddress("127.0.0.1", port).getSockAddrInet();
+    std::vector<int> fds;
+    double seconds = 0;
+    int connections = 0;
+    for (int b = 0; b < bursts; ++b)
+    {
+        g_received.getAndSet(0);
+        Timestamp start(Timestamp::now());
+        for (int i = 0; i < burst; ++i)
+        {
+            int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+            int64_t now = Timestamp::now().microSecondsSinceEpoch();
+            if (fd < 0 || ::connect(fd, reinterpret_cast<struct sockaddr *>(&serverAddr), sizeof serverAddr) < 0)
+            {
+                perror("connect");
+                abort();
+            }
+            ssize_t n = ::write(fd, &now, sizeof now);
+            (void)n;
+            fds.push_back(fd);
+        }
+        if (!waitFor(&g_received, burst))
+        {
+            printf("timeout: %d of %d connections\n", g_received.get(), burst);
+            abort();
+        }
+        seconds += timeDifference(Timestamp::now(), start);
+        connections += burst;
+
+        // 服务端先关闭, TIME_WAIT留在服务端, 客户端的端口不会用完
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            ::shutdown(fds[i], SHUT_WR);
+        }
+        waitFor(&g_connections, 0);
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            ::close(fds[i]);
+        }
+        fds.clear();
+    }
+
+    serverLoop->quit();
+    thread.join();
+
+    std::sort(g_latencies.begin(), g_latencies.end());
+    printf("%-7s threads %d  accepts/wakeup %3d  %8.0f conns/s  latency p50 %6lld us  p99 %6lld us  %5.2f iterations/conn\n",
+           perLoop ? "perloop" : "base", threads, maxAccepts, connections / seconds,
+           static_cast<long long>(g_latencies[g_latencies.size() / 2]),
+           static_cast<long long>(g_latencies[g_latencies.size() * 99 / 100]),
+           static_cast<double>(g_serverIterations) / connections);
+}
+
+int main(int argc, char *argv[])
+{
+    int burst = argc > 1 ? atoi(argv[1]) : 1000;
+    int bursts = argc > 2 ? atoi(argv[2]) : 20;
+    int threads = argc > 3 ? atoi(argv[3]) : 2;
+    Logger::setLogLevel(Logger::WARN);
+
+    struct rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    if (rl.rlim_cur < static_cast<rlim_t>(2 * burst + 64))
+    {
+        printf("RLIMIT_NOFILE too small for burst %d\n", burst);
+        return 1;
+    }
+
+    uint16_t port = 23550;
+    int maxAccepts[] = {1, 16, 64};
+    for (int perLoop = 0; perLoop < 2; ++perLoop)
+    {
+        for (size_t i = 0; i < sizeof maxAccepts / sizeof maxAccepts[0]; ++i)
+        {
+            runBench(port++, threads, maxAccepts[i], perLoop != 0, burst, bursts);
+        }
+    }
+}
@@ -1,12 +1,17 @@
 #include <muduo/net/Buffer.h>
+#include <muduo/net/BufferPool.h>
 
 //#define BOOST_TEST_MODULE BufferTest
 #define BOOST_TEST_MAIN
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 using muduo::string;
 using muduo::net::Buffer;
+using muduo::net::BufferPool;
 
 BOOST_AUTO_TEST_CASE(testBufferAppendRetrieve)
 {
@@ -140,3 +145,293 @@ BOOST_AUTO_TEST_CASE(testBufferReadInt)
     BOOST_CHECK_EQUAL(buf.readInt32(), -1);
     BOOST_CHECK_EQUAL(buf.readInt16(), -1);
 }
+
+BOOST_AUTO_TEST_CASE(testSegmentedAppendRetrieve)
+{
+    Buffer buf;
+    buf.enableSegments(64);
+    BOOST_CHECK(buf.segmented());
+    BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+    BOOST_CHECK_EQUAL(buf.prependableBytes(), Buffer::kCheapPrepend);
+
+    string str;
+    for (int i = 0; i < 200; ++i)
+    {
+        str += static_cast<char>('a' + i % 26);
+    }
+    buf.append(str);
+    BOOST_CHECK_EQUAL(buf.readableBytes(), 200);
+    BOOST_CHECK_EQUAL(buf.numSegments(), 4); // 56 + 64 + 64 + 16
+
+    const string str2 = buf.retrieveAsString(100);
+    BOOST_CHECK_EQUAL(str2, str.substr(0, 100));
+    BOOST_CHECK_EQUAL(buf.readableBytes(), 100);
+    BOOST_CHECK_EQUAL(buf.numSegments(), 3);
+
+    // 跨slab的连续视图
+    BOOST_CHECK_EQUAL(string(buf.peek(), buf.readableBytes()), str.substr(100));
+    BOOST_CHECK_EQUAL(buf.numSegments(), 1);
+
+    buf.retrieveAll();
+    BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+    BOOST_CHECK_EQUAL(buf.numSegments(), 1);
+    BOOST_CHECK_EQUAL(buf.prependableBytes(), Buffer::kCheapPrepend);
+}
+
+BOOST_AUTO_TEST_CASE(testSegmentedGrowWithoutMove)
+{
+    Buffer buf;
+    buf.append(string(100, 'x'));
+    buf.enableSegments(1024);
+    BOOST_CHECK_EQUAL(buf.readableBytes(), 100);
+
+    const char *head = buf.peek();
+    for (int i = 0; i < 100; ++i)
+    {
+        buf.append(string(1000, 'y'));
+    }
+    BOOST_CHECK_EQUAL(buf.readableBytes(), 100100);
+    BOOST_CHECK(buf.numSegments() > 1);
+
+    // 已有数据没有被移动
+    BOOST_CHECK_EQUAL(buf.retrieveAsString(100), string(100, 'x'));
+    BOOST_CHECK_EQUAL(head[0], 'x');
+
+    buf.ensureWritableBytes(5000);
+    BOOST_CHECK(buf.writableBytes() >= 5000);
+    buf.shrink(0);
+    BOOST_CHECK_EQUAL(buf.numSegments(), 1);
+    BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), string(100000, 'y'));
+}
+
+BOOST_AUTO_TEST_CASE(testSegmentedReadInt)
+{
+    Buffer buf;
+    buf.enableSegments(16);
+    buf.append(string(6, 'z'));
+    buf.appendInt32(-2);
+    buf.appendInt16(3);
+    buf.prependInt32(42);
+    BOOST_CHECK_EQUAL(buf.readableBytes(), 16);
+    BOOST_CHECK_EQUAL(buf.readInt32(), 42);
+    BOOST_CHECK_EQUAL(buf.retrieveAsString(6), string(6, 'z'));
+    BOOST_CHECK_EQUAL(buf.peekInt32(), -2); // 跨越两个slab
+    BOOST_CHECK_EQUAL(buf.numSegments(), 2);
+    BOOST_CHECK_EQUAL(buf.readInt32(), -2);
+    BOOST_CHECK_EQUAL(buf.readInt16(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(testSegmentedRetrieveUntil)
+{
+    Buffer buf;
+    buf.enableSegments(16);
+    buf.append("GET / HTTP/1.1\r\nHost: example\r\n\r\n");
+    BOOST_CHECK(buf.numSegments() > 1);
+    const char *crlf = buf.findCRLF(); // 分段时合并之后查找
+    BOOST_REQUIRE(crlf != NULL);
+    buf.retrieveUntil(crlf + 2);
+    crlf = buf.findCRLF();
+    BOOST_REQUIRE(crlf != NULL);
+    BOOST_CHECK_EQUAL(string(buf.peek(), crlf), "Host: example");
+    buf.retrieveUntil(crlf + 2);
+    BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), "\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(testSegmentedFd)
+{
+    int fds[2];
+    BOOST_REQUIRE(::pipe(fds) == 0);
+
+    Buffer out;
+    out.enableSegments(128);
+    string str;
+    for (int i = 0; i < 1000; ++i)
+    {
+        str += static_cast<char>('0' + i % 10);
+    }
+    out.append(str);
+    int savedErrno = 0;
+    BOOST_CHECK_EQUAL(out.writeFd(fds[1], &savedErrno), 1000);
+    BOOST_CHECK_EQUAL(out.readableBytes(), 0);
+
+    Buffer in;
+    in.enableSegments(128);
+    ssize_t total = 0;
+    while (total < 1000)
+    {
+        ssize_t n = in.readFd(fds[0], &savedErrno);
+        BOOST_REQUIRE(n > 0);
+        total += n;
+    }
+    BOOST_CHECK_EQUAL(in.readableBytes(), 1000);
+    BOOST_CHECK_EQUAL(in.retrieveAllAsString(), str);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(testPooledBuffer)
+{
+    BufferPool pool(64);
+    Buffer buf(&pool);
+    BOOST_CHECK(buf.segmented());
+    BOOST_CHECK_EQUAL(buf.numSegments(), 0); // 没有数据时不占用内存
+    BOOST_CHECK_EQUAL(buf.internalCapacity(), 0);
+
+    buf.append(string(100, 'x'));
+    BOOST_CHECK_EQUAL(buf.numSegments(), 2);
+    BOOST_CHECK_EQUAL(pool.inUse(), 2);
+    BOOST_CHECK_EQUAL(pool.misses(), 2);
+    BOOST_CHECK_EQUAL(pool.hits(), 0);
+
+    buf.retrieve(60);
+    BOOST_CHECK_EQUAL(pool.inUse(), 1);
+    BOOST_CHECK_EQUAL(pool.freeChunks(), 1);
+
+    buf.retrieveAll(); // 取空之后chunk全部还给pool
+    BOOST_CHECK_EQUAL(buf.numSegments(), 0);
+    BOOST_CHECK_EQUAL(pool.inUse(), 0);
+    BOOST_CHECK_EQUAL(pool.freeChunks(), 2);
+    BOOST_CHECK_EQUAL(pool.highWater(), 2);
+
+    buf.append(string(10, 'y'));
+    BOOST_CHECK_EQUAL(pool.hits(), 1);
+    BOOST_CHECK_EQUAL(pool.inUse(), 1);
+
+    Buffer copy(buf); // 拷贝不属于pool
+    BOOST_CHECK(copy.pool() == NULL);
+    BOOST_CHECK_EQUAL(copy.retrieveAllAsString(), string(10, 'y'));
+
+    buf.detachPool();
+    BOOST_CHECK(buf.pool() == NULL);
+    BOOST_CHECK_EQUAL(pool.inUse(), 0);
+    BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), string(10, 'y'));
+}
+
+BOOST_AUTO_TEST_CASE(testPooledBufferRelease)
+{
+    BufferPool pool(64);
+    int fds[2];
+    BOOST_REQUIRE(::pipe2(fds, O_NONBLOCK) == 0);
+    int savedErrno = 0;
+    {
+        Buffer buf(&pool);
+        BOOST_CHECK_EQUAL(buf.readFd(fds[0], &savedErrno), -1); // EAGAIN, 借来的chunk要还回去
+        BOOST_CHECK_EQUAL(savedErrno, EAGAIN);
+        BOOST_CHECK_EQUAL(buf.numSegments(), 0);
+        BOOST_CHECK_EQUAL(pool.inUse(), 0);
+
+        buf.append(string(100, 'x'));
+        BOOST_CHECK_EQUAL(pool.inUse(), 2);
+        BOOST_CHECK_EQUAL(buf.readFd(fds[0], &savedErrno, 32), -1); // 尾部新加的空slab也要还回去
+        BOOST_CHECK_EQUAL(pool.inUse(), 2);
+        BOOST_CHECK_EQUAL(buf.readableBytes(), 100);
+
+        ::close(fds[1]);
+        BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), string(100, 'x'));
+        BOOST_CHECK_EQUAL(buf.readFd(fds[0], &savedErrno), 0); // EOF
+        BOOST_CHECK_EQUAL(pool.inUse(), 0);
+
+        buf.append(string(10, 'y'));
+        BOOST_CHECK_EQUAL(pool.inUse(), 1);
+    }
+    BOOST_CHECK_EQUAL(pool.inUse(), 0); // 析构时归还, 不需要detachPool()
+    BOOST_CHECK_EQUAL(pool.freeChunks(), pool.highWater());
+    ::close(fds[0]);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferPoolTrim)
+{
+    BufferPool pool(64);
+    std::vector<char> chunks[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        pool.get(&chunks[i]);
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        pool.put(&chunks[i]);
+    }
+    BOOST_CHECK_EQUAL(pool.freeChunks(), 4);
+
+    pool.trim(); // 第一个周期内空闲链表最少时是0个, 不回收
+    BOOST_CHECK_EQUAL(pool.freeChunks(), 4);
+
+    pool.get(&chunks[0]);
+    pool.put(&chunks[0]);
+    pool.trim(); // 这个周期里有3个chunk一直没有被用到
+    BOOST_CHECK_EQUAL(pool.freeChunks(), 1);
+    BOOST_CHECK_EQUAL(pool.reclaimed(), 3);
+
+    pool.trim();
+    BOOST_CHECK_EQUAL(pool.freeChunks(), 0);
+    BOOST_CHECK_EQUAL(pool.memoryBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testReadFdHint)
+{
+    int fds[2];
+    BOOST_REQUIRE(::pipe(fds) == 0);
+    const string str(200 * 1000, 'h');
+    BOOST_REQUIRE(::write(fds[1], str.data(), 60000) == 60000);
+
+    Buffer buf;
+    int savedErrno = 0;
+    BOOST_CHECK_EQUAL(buf.readFd(fds[0], &savedErrno, 32 * 1024), 60000);
+    BOOST_CHECK(buf.internalCapacity() >= 32 * 1024); // 先扩充到hint, 再读
+    BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), str.substr(0, 60000));
+
+    // 分段模式下hint不超过一个slab
+    Buffer seg;
+    seg.enableSegments(4096);
+    seg.append(string(4000, 's'));
+    BOOST_REQUIRE(::write(fds[1], str.data(), 10000) == 10000);
+    BOOST_CHECK_EQUAL(seg.readFd(fds[0], &savedErrno, 1000 * 1000), 10000);
+    BOOST_CHECK_EQUAL(seg.readableBytes(), 14000);
+    BOOST_CHECK_EQUAL(seg.retrieveAsString(4000), string(4000, 's'));
+    BOOST_CHECK_EQUAL(seg.retrieveAllAsString(), str.substr(0, 10000));
+
+    // maxBytes限制一次读的总量, 包括溢出区
+    BOOST_REQUIRE(::write(fds[1], str.data(), 50000) == 50000);
+    Buffer limited;
+    BOOST_CHECK_EQUAL(limited.readFd(fds[0], &savedErrno, 0, 3000), 3000);
+    BOOST_CHECK_EQUAL(limited.readFd(fds[0], &savedErrno, 0, 500), 500);
+    BOOST_CHECK_EQUAL(limited.readableBytes(), 3500);
+    BOOST_CHECK_EQUAL(limited.readFd(fds[0], &savedErrno), 46500);
+    BOOST_CHECK_EQUAL(limited.retrieveAllAsString(), str.substr(0, 50000));
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(testFindDelimiters)
+{
+    // 各种长度和位置, 覆盖SIMD的主循环和尾巴
+    for (size_t len = 0; len < 100; ++len)
+    {
+        for (size_t pos = 0; pos + 1 < len; ++pos)
+        {
+            Buffer buf;
+            string str(len, 'x');
+            str[pos] = '\r';
+            str[pos + 1] = '\n';
+            buf.append(str);
+            BOOST_CHECK_EQUAL(buf.findCRLF(), buf.peek() + pos);
+            BOOST_CHECK_EQUAL(buf.findEOL(), buf.peek() + pos + 1);
+            BOOST_CHECK_EQUAL(buf.findAny(":\n", 2), buf.peek() + pos + 1);
+            BOOST_CHECK_EQUAL(buf.findAny("ab;:\r", 5), buf.peek() + pos);
+            BOOST_CHECK(buf.findCRLF(buf.peek() + pos + 1) == NULL);
+        }
+
+        Buffer buf;
+        buf.append(string(len, '\r')); // 只有'\r'没有'\n'
+        BOOST_CHECK(buf.findCRLF() == NULL);
+        BOOST_CHECK(buf.findEOL() == NULL);
+        BOOST_CHECK(buf.findAny("abcdefg\n", 8) == NULL);
+    }
+
+    Buffer buf;
+    buf.append("GET / HTTP/1.1\r\nHost: x\r\n\r\n");
+    const char *crlf = buf.findCRLF();
+    BOOST_CHECK_EQUAL(crlf - buf.peek(), 14);
+    BOOST_CHECK_EQUAL(buf.findCRLF(crlf + 2) - buf.peek(), 23);
+    BOOST_CHECK_EQUAL(buf.findAny(crlf + 2, ":", 1) - buf.peek(), 20);
+}
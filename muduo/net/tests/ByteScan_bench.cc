@@ -0,0 +1,112 @@
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/ByteScan.h>
+
+#include <algorithm>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const char kCRLF[] = "\r\n";
+
+// 原来Buffer::findCRLF()的实现
+const char *searchCRLF(const char *begin, const char *end)
+{
+    const char *crlf = std::search(begin, end, kCRLF, kCRLF + 2);
+    return crlf == end ? NULL : crlf;
+}
+
+const char *stdFind(const char *begin, const char *end, char c)
+{
+    const char *p = std::find(begin, end, c);
+    return p == end ? NULL : p;
+}
+
+const char *stdFindAny(const char *begin, const char *end, const char *chars, size_t n)
+{
+    const char *p = std::find_first_of(begin, end, chars, chars + n);
+    return p == end ? NULL : p;
+}
+
+std::string makeRequest()
+{
+    std::string req = "GET /index.html?user=muduo&lang=zh-CN HTTP/1.1\r\n"
+                      "Host: www.example.com\r\n"
+                      "Connection: keep-alive\r\n"
+                      "Cache-Control: max-age=0\r\n"
+                      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/96.0 Safari/537.36\r\n"
+                      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+                      "Accept-Encoding: gzip, deflate, br\r\n"
+                      "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+                      "Cookie: sessionid=0123456789abcdef0123456789abcdef; csrftoken=fedcba9876543210fedcba9876543210\r\n"
+                      "\r\n";
+    return req;
+}
+
+// 模拟HttpServer的解析: 逐行找CRLF, 再在行内找':'
+template <typename FindCRLF, typename FindByte>
+size_t parseHeaders(const std::string &req, FindCRLF findCRLF, FindByte findByte)
+{
+    size_t colons = 0;
+    const char *p = req.data();
+    const char *end = p + req.size();
+    const char *crlf;
+    while ((crlf = findCRLF(p, end)) != NULL)
+    {
+        if (findByte(p, crlf, ':'))
+        {
+            ++colons;
+        }
+        p = crlf + 2;
+    }
+    return colons;
+}
+
+template <typename FindCRLF, typename FindByte>
+void benchHeaders(const char *name, const std::string &req, int times, FindCRLF findCRLF, FindByte findByte)
+{
+    size_t total = 0;
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < times; ++i)
+    {
+        total += parseHeaders(req, findCRLF, findByte);
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    printf("%-16s headers %8.1f MB/s %6.1f ns/request (%zu)\n", name,
+           static_cast<double>(req.size()) * times / seconds / 1024 / 1024,
+           seconds * 1e9 / times, total);
+}
+
+// 在一大块数据中查找很少出现的分隔符, 比如请求体中的边界
+template <typename FindAny>
+void benchLarge(const char *name, const std::string &data, int times, FindAny findAny)
+{
+    const char chars[] = "\r\n:;";
+    size_t found = 0;
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < times; ++i)
+    {
+        const char *p = findAny(data.data(), data.data() + data.size(), chars, 4);
+        found += p ? p - data.data() : 0;
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    printf("%-16s findAny %8.1f MB/s (%zu)\n", name,
+           static_cast<double>(data.size()) * times / seconds / 1024 / 1024, found);
+}
+
+int main(int argc, char *argv[])
+{
+    int times = argc > 1 ? atoi(argv[1]) : 200000;
+    printf("kernel = %s\n", scan::kernelName());
+
+    std::string req = makeRequest();
+    benchHeaders("std::search", req, times, searchCRLF, stdFind);
+    benchHeaders("scan", req, times, scan::findCRLF, scan::findByte);
+
+    std::string data(64 * 1024, 'x');
+    data[data.size() - 10] = ';';
+    benchLarge("std::find_first", data, times / 100, stdFindAny);
+    benchLarge("scan", data, times / 100, scan::findAny);
+}
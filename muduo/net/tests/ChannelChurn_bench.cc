@@ -0,0 +1,107 @@
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/EventLoop.h>
+
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 很多连接的loop上频繁修改关注的事件, 测量Poller::updateChannel()/removeChannel()的开销.
+// 用eventfd代替socket, 只是为了快速打开大量fd.
+
+// 打开的fd数不够时尽量调高RLIMIT_NOFILE, 返回实际可以用的个数
+int raiseFdLimit(int wanted)
+{
+    struct rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rlim_t need = static_cast<rlim_t>(wanted) + 64;
+    if (rl.rlim_cur < need)
+    {
+        rl.rlim_cur = need;
+        if (rl.rlim_max < need)
+        {
+            rl.rlim_max = need; // 需要CAP_SYS_RESOURCE
+        }
+        if (::setrlimit(RLIMIT_NOFILE, &rl) < 0)
+        {
+            ::getrlimit(RLIMIT_NOFILE, &rl);
+            return static_cast<int>(rl.rlim_cur) - 64;
+        }
+    }
+    return wanted;
+}
+
+void bench(EventLoop *loop, int n, int ops)
+{
+    boost::ptr_vector<Channel> channels;
+    std::vector<int> order(ops);
+    for (int i = 0; i < ops; ++i)
+    {
+        order[i] = static_cast<int>(random() % n); // 连接的活动是随机分布的
+    }
+
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < n; ++i)
+    {
+        channels.push_back(new Channel(loop, ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)));
+        channels.back().enableReading();
+    }
+    double add = timeDifference(Timestamp::now(), start);
+
+    // 部分写: 开启EPOLLOUT, 写完再关掉
+    start = Timestamp::now();
+    for (int i = 0; i < ops; ++i)
+    {
+        Channel &ch = channels[order[i]];
+        ch.enableWriting();
+        ch.disableWriting();
+    }
+    double mod = timeDifference(Timestamp::now(), start);
+
+    // 连接关闭, 同一个fd马上被新连接复用
+    start = Timestamp::now();
+    for (int i = 0; i < ops; ++i)
+    {
+        Channel &ch = channels[order[i]];
+        ch.disableAll();
+        ch.remove();
+        ch.enableReading();
+    }
+    double reuse = timeDifference(Timestamp::now(), start);
+
+    printf("fds %7d  add %6.0f ns  mod %6.0f ns  del+add %6.0f ns\n", n,
+           add * 1e9 / n, mod * 1e9 / (2 * ops), reuse * 1e9 / ops);
+
+    for (int i = 0; i < n; ++i)
+    {
+        channels[i].disableAll();
+        channels[i].remove();
+        ::close(channels[i].fd());
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int wanted = argc > 1 ? atoi(argv[1]) : 100000;
+    int maxFds = raiseFdLimit(wanted);
+    if (maxFds < wanted)
+    {
+        printf("RLIMIT_NOFILE too small, only %d fds\n", maxFds);
+    }
+    int ops = argc > 2 ? atoi(argv[2]) : 200000;
+    EventLoop loop;
+
+    for (int n = 100; n < wanted * 10; n *= 10)
+    {
+        bench(&loop, std::min(n, maxFds), ops);
+    }
+}
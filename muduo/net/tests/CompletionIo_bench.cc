@@ -0,0 +1,158 @@
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 很多连接同时ping-pong小消息, 比较回显服务端的三种模式:
+//   epoll: 就绪通知, 每个连接每个事件一次read和一次write
+//   uring: io_uring的poll就绪通知, 读写还是系统调用
+//   cio:   io_uring完成式IO(TcpConnection::setCompletionIo()), 一轮事件循环的收发只有一次io_uring_enter
+// 客户端在主线程中, 总是用epoll. 报告每秒回显的消息数, 服务端线程每条消息的CPU时间, 以及服务端每轮事件循环处理的消息数.
+
+const int kMessageSize = 64;
+
+string g_message(kMessageSize, 'x');
+int64_t g_messages = 0;
+bool g_stopping = false;
+double g_serverCpu = 0;
+int64_t g_serverIterations = 0;
+
+double threadCpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_THREAD, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void onServerMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf);
+}
+
+void runServer(uint16_t port, bool completionIo, EventLoop **serverLoop, CountDownLatch *latch)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "echo");
+    server.setMessageCallback(onServerMessage);
+    server.setCompletionIo(completionIo);
+    server.start();
+    *serverLoop = &loop;
+    latch->countDown();
+
+    double cpu = threadCpuSeconds();
+    loop.loop();
+    g_serverCpu = threadCpuSeconds() - cpu;
+    g_serverIterations = loop.iteration();
+}
+
+void onClientConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        conn->send(g_message);
+    }
+}
+
+void onClientMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    while (buf->readableBytes() >= static_cast<size_t>(kMessageSize))
+    {
+        buf->retrieve(kMessageSize);
+        ++g_messages;
+        if (!g_stopping)
+        {
+            conn->send(g_message);
+        }
+    }
+}
+
+void startMeasure(int64_t *messages, Timestamp *start)
+{
+    *messages = g_messages;
+    *start = Timestamp::now();
+}
+
+void stopMeasure(EventLoop *loop, int64_t *messages, Timestamp *start, double *seconds)
+{
+    *messages = g_messages - *messages;
+    *seconds = timeDifference(Timestamp::now(), *start);
+    g_stopping = true;
+    loop->quit();
+}
+
+void runBench(const char *name, uint16_t port, bool uring, bool completionIo, int connections, double seconds)
+{
+    // Poller在EventLoop构造时按环境变量选择, 只影响服务端
+    if (uring)
+    {
+        ::setenv("MUDUO_USE_URING", "1", 1);
+    }
+    EventLoop *serverLoop = NULL;
+    CountDownLatch latch(1);
+    Thread thread(boost::bind(runServer, port, completionIo, &serverLoop, &latch));
+    thread.start();
+    latch.wait();
+    ::unsetenv("MUDUO_USE_URING");
+
+    g_messages = 0;
+    g_stopping = false;
+    EventLoop loop;
+    InetAddress serverAddr("127.0.0.1", port);
+    boost::ptr_vector<TcpClient> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.push_back(new TcpClient(&loop, serverAddr, "client"));
+        clients.back().setConnectionCallback(onClientConnection);
+        clients.back().setMessageCallback(onClientMessage);
+        clients.back().connect();
+    }
+
+    int64_t messages = 0;
+    Timestamp start;
+    double elapsed = 0;
+    loop.runAfter(0.5, boost::bind(startMeasure, &messages, &start)); // 等连接都建立起来
+    loop.runAfter(0.5 + seconds, boost::bind(stopMeasure, &loop, &messages, &start, &elapsed));
+    loop.loop();
+
+    for (int i = 0; i < connections; ++i)
+    {
+        clients[i].disconnect();
+    }
+    serverLoop->quit();
+    thread.join();
+
+    printf("%-6s connections %5d  %9.0f msgs/s  server %6.2f us/msg  %6.1f msgs/iteration\n", name, connections,
+           static_cast<double>(messages) / elapsed, g_serverCpu * 1e6 / static_cast<double>(g_messages),
+           static_cast<double>(g_messages) / static_cast<double>(g_serverIterations));
+}
+
+int main(int argc, char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 1000;
+    double seconds = argc > 2 ? atof(argv[2]) : 3.0;
+    Logger::setLogLevel(Logger::WARN);
+
+    for (int n = std::min(connections, 10); n <= connections; n *= 10)
+    {
+        // 服务端线程退出时io_uring是异步关闭的, 每次换一个端口
+        runBench("epoll", 23531, false, false, n, seconds);
+        runBench("uring", 23532, true, false, n, seconds);
+        runBench("cio", 23533, true, true, n, seconds);
+    }
+}
@@ -0,0 +1,134 @@
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 完成式IO的sendFile(): 没有sendfile, 文件要一块一块地读进outputBuffer_, 每个send完成后再读下一块,
+// 不能在回调中把整个文件读进内存. 文件前后send()的数据顺序不变, 发完之后shutdown()才关闭写端.
+
+const size_t kFileSize = 8 * 1024 * 1024;
+const size_t kMaxBuffered = 256 * 1024; // outputBuffer_中最多只有一两块文件数据
+
+int g_file = -1;
+bool g_completionIo = false;
+size_t g_maxBuffered = 0;
+int g_highWaterMarks = 0;
+TcpConnectionPtr g_conn;
+
+char patternAt(size_t offset)
+{
+    return static_cast<char>('a' + offset % 19);
+}
+
+void onHighWaterMark(const TcpConnectionPtr &, size_t)
+{
+    ++g_highWaterMarks;
+}
+
+void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        g_completionIo = conn->completionIo();
+        g_conn = conn;
+        conn->setHighWaterMarkCallback(onHighWaterMark, 1024 * 1024);
+        conn->send("head");
+        conn->sendFile(g_file, 0, kFileSize);
+        conn->send("tail");
+        conn->shutdown(); // 文件发完才关闭写端
+        g_maxBuffered = std::max(g_maxBuffered, conn->outputBuffer()->readableBytes());
+    }
+    else
+    {
+        g_conn.reset();
+        conn->getLoop()->quit();
+    }
+}
+
+void sample()
+{
+    if (g_conn)
+    {
+        g_maxBuffered = std::max(g_maxBuffered, g_conn->outputBuffer()->readableBytes());
+    }
+}
+
+void serverThread(uint16_t port, CountDownLatch *latch)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "CompletionSendFile");
+    server.setCompletionIo(true);
+    server.setConnectionCallback(onConnection);
+    server.start();
+    loop.runEvery(0.001, sample);
+    latch->countDown();
+    loop.loop();
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    ::setenv("MUDUO_USE_URING", "1", 1);
+    const uint16_t port = 23611;
+
+    char path[] = "/tmp/completionsendfile_unittest.XXXXXX";
+    g_file = ::mkstemp(path);
+    assert(g_file >= 0);
+    ::unlink(path);
+    string content(kFileSize, '\0');
+    for (size_t i = 0; i < kFileSize; ++i)
+    {
+        content[i] = patternAt(i);
+    }
+    ssize_t nf = ::write(g_file, content.data(), content.size());
+    assert(nf == static_cast<ssize_t>(kFileSize));
+    (void)nf;
+
+    CountDownLatch latch(1);
+    Thread thread(boost::bind(serverThread, port, &latch));
+    thread.start();
+    latch.wait();
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    struct sockaddr_in addr = InetAddress("127.0.0.1", port).getSockAddrInet();
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+    assert(ret == 0);
+    (void)ret;
+
+    string got;
+    char buf[64 * 1024];
+    ssize_t n = 0;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+        got.append(buf, n);
+        ::usleep(100); // 慢速的客户端, 文件要分很多次send
+    }
+    ::close(fd);
+    thread.join();
+    ::close(g_file);
+
+    if (!g_completionIo)
+    {
+        printf("io_uring completion I/O not supported, skipped\n");
+        return 0;
+    }
+    printf("got %zu bytes, max buffered %zu, high water marks %d\n", got.size(), g_maxBuffered, g_highWaterMarks);
+    assert(got == "head" + content + "tail");
+    assert(g_maxBuffered < kMaxBuffered);
+    assert(g_highWaterMarks == 1); // 排队的文件也算在待发送的数据中
+    printf("OK\n");
+}
@@ -0,0 +1,169 @@
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 延迟发送和TCP_CORK: 客户端每发一个'x', 服务端回复很多小帧, 一个Slice和一个文件, 这些send()要在本轮事件处理结束后
+// 用一次writev加一次sendfile发出去, sendFile()也不能提前发送; 发完之后要关闭TCP_CORK, 否则每一轮都要等内核200ms的cork超时.
+// 最后客户端发'q', 服务端回复之后马上shutdown(), 关闭写端之前要等延迟的数据发完.
+
+const int kFrames = 20;
+const int kRounds = 200;
+const int kWritesPerRound = 2; // 帧和Slice一次writev, 文件一次sendfile
+const char kFileContent[] = "file\n";
+
+int g_file = -1;
+int64_t g_lastWrites = -1;
+int g_badRounds = 0;   // 两次onMessage()之间write(2)次数不是kWritesPerRound的轮数
+int g_earlyWrites = 0; // sendFile()在回调中就发送了
+
+string frame(int i)
+{
+    char buf[32];
+    snprintf(buf, sizeof buf, "frame %02d\n", i);
+    return buf;
+}
+
+string response()
+{
+    string result;
+    for (int i = 0; i < kFrames; ++i)
+    {
+        result += frame(i);
+    }
+    result += "slice\n";
+    result += kFileContent;
+    return result;
+}
+
+void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    int64_t writes = conn->stats().writes;
+    if (g_lastWrites >= 0 && writes - g_lastWrites != kWritesPerRound)
+    {
+        ++g_badRounds;
+    }
+    g_lastWrites = writes;
+
+    while (buf->readableBytes() > 0)
+    {
+        char c = *buf->peek();
+        buf->retrieve(1);
+        for (int i = 0; i < kFrames; ++i)
+        {
+            conn->send(frame(i));
+        }
+        conn->send(Slice(boost::shared_ptr<const string>(new string("slice\n"))));
+        int64_t before = conn->stats().writes;
+        conn->sendFile(g_file, 0, sizeof kFileContent - 1);
+        if (conn->stats().writes != before)
+        {
+            ++g_earlyWrites;
+        }
+        if (c == 'q')
+        {
+            conn->shutdown(); // 这时数据还在发送队列中
+        }
+    }
+}
+
+void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->disconnected())
+    {
+        conn->getLoop()->quit();
+    }
+}
+
+void serverThread(uint16_t port, CountDownLatch *latch)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "DeferredFlush");
+    server.setDeferredFlush(true, true);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.start();
+    latch->countDown();
+    loop.loop();
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    const uint16_t port = 23601;
+    const string expected(response());
+
+    char path[] = "/tmp/deferredflush_unittest.XXXXXX";
+    g_file = ::mkstemp(path);
+    assert(g_file >= 0);
+    ::unlink(path);
+    ssize_t nf = ::write(g_file, kFileContent, sizeof kFileContent - 1);
+    assert(nf == sizeof kFileContent - 1);
+    (void)nf;
+
+    CountDownLatch latch(1);
+    Thread thread(boost::bind(serverThread, port, &latch));
+    thread.start();
+    latch.wait();
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    struct sockaddr_in addr = InetAddress("127.0.0.1", port).getSockAddrInet();
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+    assert(ret == 0);
+    (void)ret;
+
+    char buf[64 * 1024];
+    Timestamp start(Timestamp::now());
+    for (int r = 0; r < kRounds; ++r)
+    {
+        ssize_t nw = ::write(fd, "x", 1);
+        assert(nw == 1);
+        (void)nw;
+        string got;
+        while (got.size() < expected.size())
+        {
+            ssize_t n = ::read(fd, buf, sizeof buf);
+            assert(n > 0);
+            got.append(buf, n);
+        }
+        assert(got == expected);
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+
+    // shutdown()要等延迟发送的数据发完
+    ssize_t nw = ::write(fd, "q", 1);
+    assert(nw == 1);
+    (void)nw;
+    string last;
+    ssize_t n = 0;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+        last.append(buf, n);
+    }
+    ::close(fd);
+    thread.join();
+
+    ::close(g_file);
+
+    printf("%d rounds in %.3f seconds, bad rounds %d, early writes %d, last %zu bytes\n",
+           kRounds, seconds, g_badRounds, g_earlyWrites, last.size());
+    assert(g_badRounds == 0); // 每一轮的回复只用一次writev和一次sendfile
+    assert(g_earlyWrites == 0);
+    assert(seconds < kRounds * 0.02); // 发完之后关闭了TCP_CORK, 没有等cork超时
+    assert(last == expected);
+    printf("OK\n");
+}
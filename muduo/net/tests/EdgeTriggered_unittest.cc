@@ -0,0 +1,169 @@
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 边沿触发: 客户端每轮一次写入一大块请求, 服务端收齐之后回复一大块. 一次可读事件之后不会再有通知,
+// 服务端必须读到EAGAIN(drain), 设置了读预算时读满预算要排到本轮事件之后接着读(requeue), 否则请求收不齐;
+// 回复也要一直写到EAGAIN, 不再开关EPOLLOUT. 用LT作为对照.
+// 第一轮服务端先暂停读, 等请求全部进了内核缓冲区再恢复, 这样只有一次可读事件.
+
+const size_t kRequest = 128 * 1024; // 要能全部放进内核缓冲区
+const size_t kResponse = 1024 * 1024;
+const int kRounds = 20;
+
+bool g_edgeTriggered = false;
+size_t g_received = 0; // 本轮收到的字节数
+int g_round = 0;
+int g_firstRoundMessages = 0; // 第一轮回调messageCallback_的次数
+bool g_patternOk = true;
+
+char patternAt(size_t offset)
+{
+    return static_cast<char>('a' + offset % 23);
+}
+
+void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        g_edgeTriggered = conn->edgeTriggered();
+        conn->stopRead();
+        conn->getLoop()->runAfter(0.2, boost::bind(&TcpConnection::startRead, conn));
+    }
+    else
+    {
+        conn->getLoop()->quit();
+    }
+}
+
+void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    size_t n = buf->readableBytes();
+    if (g_round == 0)
+    {
+        ++g_firstRoundMessages;
+    }
+    const char *data = buf->peek();
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (data[i] != patternAt(g_received + i))
+        {
+            g_patternOk = false;
+        }
+    }
+    g_received += n;
+    buf->retrieveAll();
+    if (g_received == kRequest)
+    {
+        g_received = 0;
+        ++g_round;
+        conn->send(string(kResponse, 'r'));
+    }
+}
+
+void serverThread(uint16_t port, bool edgeTriggered, size_t readBudget, CountDownLatch *latch)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "EdgeTriggered");
+    server.setEdgeTriggered(edgeTriggered);
+    server.setReadBudget(readBudget);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.start();
+    latch->countDown();
+    loop.loop();
+}
+
+void run(uint16_t port, bool edgeTriggered, size_t readBudget)
+{
+    g_received = 0;
+    g_round = 0;
+    g_firstRoundMessages = 0;
+    g_patternOk = true;
+
+    CountDownLatch latch(1);
+    Thread thread(boost::bind(serverThread, port, edgeTriggered, readBudget, &latch));
+    thread.start();
+    latch.wait();
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    struct sockaddr_in addr = InetAddress("127.0.0.1", port).getSockAddrInet();
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+    assert(ret == 0);
+    (void)ret;
+    struct timeval timeout = {5, 0}; // 服务端漏读时read()超时失败, 而不是一直等下去
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
+    string request(kRequest, '\0');
+    for (size_t i = 0; i < kRequest; ++i)
+    {
+        request[i] = patternAt(i);
+    }
+    char buf[64 * 1024];
+    bool responseOk = true;
+    for (int r = 0; r < kRounds; ++r)
+    {
+        size_t sent = 0;
+        while (sent < kRequest)
+        {
+            ssize_t n = ::write(fd, request.data() + sent, kRequest - sent);
+            assert(n > 0);
+            sent += n;
+        }
+        size_t got = 0;
+        while (got < kResponse)
+        {
+            ssize_t n = ::read(fd, buf, sizeof buf);
+            assert(n > 0);
+            if (std::count(buf, buf + n, 'r') != n)
+            {
+                responseOk = false;
+            }
+            got += n;
+        }
+    }
+    ::close(fd);
+    thread.join();
+
+    printf("%s budget %zu: first round %d messages\n", edgeTriggered ? "ET" : "LT", readBudget, g_firstRoundMessages);
+    assert(g_edgeTriggered == edgeTriggered);
+    assert(g_round == kRounds);
+    assert(g_patternOk);
+    assert(responseOk);
+    if (edgeTriggered && readBudget == 0)
+    {
+        assert(g_firstRoundMessages == 1); // 一次事件就读空了
+    }
+    if (edgeTriggered && readBudget > 0)
+    {
+        assert(g_firstRoundMessages > 1); // 读满预算就让出, 剩下的没有新事件, 是排队继续读的
+    }
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    if (::getenv("MUDUO_USE_POLL"))
+    {
+        printf("poll(2) does not support edge-triggered mode, skipped\n");
+        return 0;
+    }
+    run(23607, false, 0);
+    run(23608, true, 0);    // 读到EAGAIN
+    run(23609, true, 4096); // 每次最多读4096字节, 排队继续读
+    printf("OK\n");
+}
@@ -1,9 +1,13 @@
 #include <muduo/net/EventLoopThreadPool.h>
 #include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
 #include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
 
 #include <boost/bind.hpp>
 
+#include <map>
+#include <set>
 #include <stdio.h>
 
 using namespace muduo;
@@ -15,6 +19,14 @@ void print(EventLoop* p = NULL)
          getpid(), CurrentThread::tid(), p);
 }
 
+void spin(double seconds)
+{
+  Timestamp start(Timestamp::now());
+  while (timeDifference(Timestamp::now(), start) < seconds)
+  {
+  }
+}
+
 void init(EventLoop* p)
 {
   printf("init(): pid = %d, tid = %d, loop = %p\n",
@@ -64,6 +76,58 @@ int main()
     assert(nextLoop == model.getNextLoop());
   }
 
+  {
+    printf("Peer hash:\n");
+    EventLoopThreadPool model(&loop);
+    model.setThreadNum(3);
+    model.setPlacement(EventLoopThreadPool::kPeerHash);
+    model.start(init);
+    assert(model.getLoopForPeer(InetAddress("10.0.0.1", 1000)) == model.getLoopForPeer(InetAddress("10.0.0.1", 2000)));
+    std::set<EventLoop*> used;
+    for (int i = 0; i < 256; ++i)
+    {
+      char ip[32];
+      snprintf(ip, sizeof ip, "10.0.%d.%d", i / 16, i % 16 + 1);
+      used.insert(model.getLoopForPeer(InetAddress(ip, 1000)));
+    }
+    assert(used.size() == 3);
+  }
+
+  {
+    printf("Least connections:\n");
+    EventLoopThreadPool model(&loop);
+    model.setThreadNum(3);
+    model.setPlacement(EventLoopThreadPool::kLeastConnections);
+    model.start(init);
+    // 还没有建立的连接也算, 一批连接均匀分开
+    std::map<EventLoop*, int> count;
+    for (int i = 0; i < 6; ++i)
+    {
+      ++count[model.getLoopForPeer(InetAddress("10.0.0.1", 1000))];
+    }
+    assert(count.size() == 3);
+    for (std::map<EventLoop*, int>::iterator it = count.begin(); it != count.end(); ++it)
+    {
+      assert(it->second == 2);
+    }
+  }
+
+  {
+    printf("Least busy:\n");
+    EventLoopThreadPool model(&loop);
+    model.setThreadNum(3);
+    model.setPlacement(EventLoopThreadPool::kLeastBusy);
+    model.start(init);
+    EventLoop* busy = model.getAllLoops()[0];
+    busy->runInLoop(boost::bind(spin, 0.6));
+    ::usleep(300 * 1000);
+    assert(busy->busyPermille() == 1000);
+    for (int i = 0; i < 6; ++i)
+    {
+      assert(model.getLoopForPeer(InetAddress("10.0.0.1", 1000)) != busy);
+    }
+  }
+
   loop.loop();
 }
 
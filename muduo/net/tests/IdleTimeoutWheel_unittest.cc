@@ -0,0 +1,222 @@
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/IdleTimeoutWheel.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <vector>
+#include <assert.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// IdleTimeoutWheel: 收发数据都会推迟到期时间(refresh), 空闲超过timeout的连接被关闭(expire),
+// kForceClose直接关闭, kShutdown先关闭写端, 对端再空闲一个timeout还不关闭才强制关闭.
+
+const double kTimeout = 0.5;
+const double kTick = 0.1;
+const int kConns = 12; // i % 3 == 0: 客户端定期发送, 1: 服务端定期发送, 2: 空闲
+
+boost::shared_ptr<IdleTimeoutWheel> g_wheel;
+int g_connections = 0;
+std::vector<boost::weak_ptr<TcpConnection> > g_serverSends; // 服务端定期发送数据的连接
+
+int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    struct sockaddr_in addr = InetAddress("127.0.0.1", port).getSockAddrInet();
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+    assert(ret == 0);
+    (void)ret;
+    return fd;
+}
+
+// 读完已经到达的数据, 对端关闭了写端时返回true
+bool peerClosed(int fd)
+{
+    char buf[1024];
+    ssize_t n = 0;
+    while ((n = ::recv(fd, buf, sizeof buf, MSG_DONTWAIT)) > 0)
+    {
+    }
+    return n == 0;
+}
+
+void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        g_wheel->add(conn);
+        // 客户端按顺序连接, 每三个中的第二个由服务端发送数据
+        if (g_connections++ % 3 == 1)
+        {
+            g_serverSends.push_back(conn);
+        }
+    }
+}
+
+void onMessage(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+{
+    buf->retrieveAll();
+}
+
+void serverSend()
+{
+    for (size_t i = 0; i < g_serverSends.size(); ++i)
+    {
+        TcpConnectionPtr conn(g_serverSends[i].lock());
+        if (conn && conn->connected())
+        {
+            conn->send("t");
+        }
+    }
+}
+
+void forceCloseClients(EventLoop *loop, uint16_t port, int *aliveOk, int *idleClosed)
+{
+    std::vector<int> fds;
+    for (int i = 0; i < kConns; ++i)
+    {
+        fds.push_back(connectTo(port));
+        ::usleep(10 * 1000); // 按顺序建立, 见onConnection()
+    }
+    for (int r = 0; r < 12; ++r) // 1.2秒, 超过两个timeout
+    {
+        ::usleep(100 * 1000);
+        for (int i = 0; i < kConns; i += 3)
+        {
+            ssize_t n = ::write(fds[i], "x", 1);
+            assert(n == 1);
+            (void)n;
+        }
+    }
+    for (int i = 0; i < kConns; ++i)
+    {
+        bool closed = peerClosed(fds[i]);
+        if (i % 3 != 2 && !closed)
+        {
+            ++*aliveOk;
+        }
+        if (i % 3 == 2 && closed)
+        {
+            ++*idleClosed;
+        }
+        ::close(fds[i]);
+    }
+    // 关闭了的连接在下一次到期时不再跟踪
+    loop->runAfter(kTimeout + 3 * kTick, boost::bind(&EventLoop::quit, loop));
+}
+
+void testForceClose()
+{
+    const uint16_t port = 23605;
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "IdleForceClose");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.start();
+    g_wheel.reset(new IdleTimeoutWheel(&loop, kTimeout, kTick, IdleTimeoutWheel::kForceClose));
+    g_wheel->start();
+    loop.runEvery(kTick, serverSend);
+
+    int aliveOk = 0;
+    int idleClosed = 0;
+    Thread thread(boost::bind(forceCloseClients, &loop, port, &aliveOk, &idleClosed));
+    thread.start();
+    loop.loop();
+    thread.join();
+
+    printf("force close: alive %d idle closed %d expired %lld size %zu\n",
+           aliveOk, idleClosed, static_cast<long long>(g_wheel->expired()), g_wheel->size());
+    assert(aliveOk == 2 * kConns / 3);  // 收发数据都推迟了到期时间
+    assert(idleClosed == kConns / 3);
+    assert(g_wheel->expired() == kConns / 3);
+    assert(g_wheel->size() == 0);
+    g_wheel->stop();
+    g_wheel.reset();
+    g_serverSends.clear();
+    g_connections = 0;
+    printf("force close OK\n");
+}
+
+void shutdownClients(EventLoop *loop, uint16_t port, int *halfClosed, int *reset)
+{
+    std::vector<int> fds;
+    for (int i = 0; i < kConns; ++i)
+    {
+        fds.push_back(connectTo(port));
+    }
+    ::usleep(static_cast<useconds_t>((kTimeout + 3 * kTick) * 1000 * 1000));
+    for (int i = 0; i < kConns; ++i)
+    {
+        // 服务端只关闭了写端, 还可以发送
+        if (peerClosed(fds[i]) && ::write(fds[i], "y", 1) == 1)
+        {
+            ++*halfClosed;
+        }
+    }
+    // 不关闭, 再过一个timeout被强制关闭: 写会收到RST
+    ::usleep(static_cast<useconds_t>((kTimeout + 5 * kTick) * 1000 * 1000));
+    for (int i = 0; i < kConns; ++i)
+    {
+        if (::write(fds[i], "z", 1) < 0)
+        {
+            ++*reset;
+        }
+        else
+        {
+            ::usleep(10 * 1000);
+            if (::write(fds[i], "z", 1) < 0)
+            {
+                ++*reset;
+            }
+        }
+        ::close(fds[i]);
+    }
+    loop->runAfter(0.1, boost::bind(&EventLoop::quit, loop));
+}
+
+void testShutdown()
+{
+    const uint16_t port = 23606;
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "IdleShutdown");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.start();
+    g_wheel.reset(new IdleTimeoutWheel(&loop, kTimeout, kTick, IdleTimeoutWheel::kShutdown));
+    g_wheel->start();
+
+    int halfClosed = 0;
+    int reset = 0;
+    Thread thread(boost::bind(shutdownClients, &loop, port, &halfClosed, &reset));
+    thread.start();
+    loop.loop();
+    thread.join();
+
+    printf("shutdown: half closed %d reset %d expired %lld\n",
+           halfClosed, reset, static_cast<long long>(g_wheel->expired()));
+    assert(halfClosed == kConns);
+    assert(reset == kConns);
+    assert(g_wheel->expired() == kConns); // 第二次到期的连接不重复计数
+    g_wheel->stop();
+    g_wheel.reset();
+    g_serverSends.clear();
+    g_connections = 0;
+    printf("shutdown OK\n");
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    testForceClose();
+    testShutdown();
+    printf("OK\n");
+}
@@ -0,0 +1,197 @@
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/EventLoop.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 比较epoll和io_uring(MUDUO_USE_URING)两种Poller. n个socket(socketpair的两端)都关注可读, 每一轮:
+//   churn: 随机k个socket开启可写, 可写事件到来后关闭, 就是部分写的开启/关闭EPOLLOUT, 每个socket两次修改关注的事件.
+//   ready: 往随机k个socket写1字节, 可读事件到来后读走.
+
+int g_n = 0;
+int g_k = 0;
+int g_rounds = 0;
+int g_round = 0;
+int g_pending = 0; // 本轮还没有收到事件的socket数
+bool g_churn = false;
+bool g_edgeTriggered = false;
+EventLoop *g_loop = NULL;
+boost::ptr_vector<Channel> *g_channels = NULL;
+std::vector<int> g_peers;  // g_peers[i]是channel i对面的fd
+std::vector<int> g_picked; // 本轮选中的socket记为g_round, 同一轮不重复选
+
+int raiseFdLimit(int wanted)
+{
+    struct rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rlim_t need = static_cast<rlim_t>(wanted) + 64;
+    if (rl.rlim_cur < need)
+    {
+        rl.rlim_cur = need;
+        if (rl.rlim_max < need)
+        {
+            rl.rlim_max = need; // 需要CAP_SYS_RESOURCE
+        }
+        if (::setrlimit(RLIMIT_NOFILE, &rl) < 0)
+        {
+            ::getrlimit(RLIMIT_NOFILE, &rl);
+            return static_cast<int>(rl.rlim_cur) - 64;
+        }
+    }
+    return wanted;
+}
+
+void startRound();
+
+void eventDone()
+{
+    if (--g_pending == 0)
+    {
+        if (++g_round == g_rounds)
+        {
+            g_loop->quit();
+        }
+        else
+        {
+            g_loop->queueInLoop(startRound);
+        }
+    }
+}
+
+void onReadable(int i, Timestamp)
+{
+    char buf[16];
+    ssize_t n = ::read((*g_channels)[i].fd(), buf, sizeof buf);
+    (void)n;
+    eventDone();
+}
+
+void onWritable(int i)
+{
+    (*g_channels)[i].disableWriting();
+    eventDone();
+}
+
+void startRound()
+{
+    for (int j = 0; j < g_k; ++j)
+    {
+        int i = static_cast<int>(random() % g_n);
+        if (g_picked[i] == g_round)
+        {
+            continue;
+        }
+        g_picked[i] = g_round;
+        if (g_churn)
+        {
+            (*g_channels)[i].enableWriting();
+        }
+        else
+        {
+            ssize_t n = ::write(g_peers[i], "x", 1);
+            (void)n;
+        }
+        ++g_pending;
+    }
+}
+
+void runBench(const char *name, int n, int k, int rounds)
+{
+    EventLoop loop;
+    boost::ptr_vector<Channel> channels;
+    g_loop = &loop;
+    g_channels = &channels;
+    g_n = n;
+    g_k = k;
+    g_rounds = rounds;
+    g_peers.resize(n);
+    g_picked.assign(n, -1);
+
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < n; i += 2)
+    {
+        int sv[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) < 0)
+        {
+            perror("socketpair");
+            abort();
+        }
+        for (int j = 0; j < 2; ++j)
+        {
+            channels.push_back(new Channel(&loop, sv[j]));
+            channels.back().setEdgeTriggered(g_edgeTriggered); // io_uring用multishot poll
+            channels.back().setReadCallback(boost::bind(onReadable, i + j, _1));
+            channels.back().setWriteCallback(boost::bind(onWritable, i + j));
+            channels.back().enableReading();
+            g_peers[i + j] = sv[1 - j];
+        }
+    }
+    double add = timeDifference(Timestamp::now(), start);
+
+    // 边沿触发时EPOLLOUT一直在epoll中, 已经可写的socket再enableWriting()不会有新的事件, 只测ready
+    for (int churn = g_edgeTriggered ? 1 : 0; churn < 2; ++churn)
+    {
+        g_churn = churn == 0;
+        g_round = 0;
+        g_pending = 0;
+        g_picked.assign(n, -1);
+        int64_t iterations = loop.iteration();
+        start = Timestamp::now();
+        startRound();
+        loop.loop();
+        double seconds = timeDifference(Timestamp::now(), start);
+        printf("%-5s%-3s sockets %7d  add %5.0f ns  %s %5.0f ns/socket  %5.1f iterations/round\n", name, g_edgeTriggered ? "-et" : "", n,
+               add * 1e9 / n, g_churn ? "churn" : "ready", seconds * 1e9 / (static_cast<double>(rounds) * k),
+               static_cast<double>(loop.iteration() - iterations) / rounds);
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        channels[i].disableAll();
+        channels[i].remove();
+        ::close(channels[i].fd());
+    }
+}
+
+void runIn(const char *name, int n, int k, int rounds)
+{
+    // 每个线程只能有一个EventLoop, 在新线程中创建, 构造时按环境变量选择Poller
+    Thread thread(boost::bind(runBench, name, n, k, rounds));
+    thread.start();
+    thread.join();
+}
+
+int main(int argc, char *argv[])
+{
+    int wanted = argc > 1 ? atoi(argv[1]) : 100000;
+    int k = argc > 2 ? atoi(argv[2]) : 1000;
+    int rounds = argc > 3 ? atoi(argv[3]) : 200;
+    g_edgeTriggered = argc > 4 && strcmp(argv[4], "et") == 0;
+    int maxFds = raiseFdLimit(wanted) & ~1;
+    if (maxFds < wanted)
+    {
+        printf("RLIMIT_NOFILE too small, only %d sockets\n", maxFds);
+    }
+
+    for (int n = std::min(wanted, 10000); n <= wanted; n *= 10)
+    {
+        ::unsetenv("MUDUO_USE_URING");
+        runIn("epoll", std::min(n, maxFds), k, rounds);
+        ::setenv("MUDUO_USE_URING", "1", 1);
+        runIn("uring", std::min(n, maxFds), k, rounds);
+    }
+}
@@ -0,0 +1,104 @@
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThread.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <algorithm>
+#include <inttypes.h>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 工作线程向IO线程投递大量functor, 测量吞吐量和唤醒次数; 再用ping-pong测量单个functor的延迟.
+
+EventLoop *g_loop = NULL;
+int64_t g_count = 0; // 只在IO线程中修改
+int64_t g_total = 0;
+CountDownLatch *g_done = NULL;
+
+void onFunctor()
+{
+    if (++g_count == g_total)
+    {
+        g_done->countDown();
+    }
+}
+
+void produce(int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        g_loop->queueInLoop(onFunctor);
+    }
+}
+
+void benchThroughput(int producers, int perProducer)
+{
+    g_count = 0;
+    g_total = static_cast<int64_t>(producers) * perProducer;
+    CountDownLatch done(1);
+    g_done = &done;
+
+    boost::ptr_vector<Thread> threads;
+    for (int i = 0; i < producers; ++i)
+    {
+        threads.push_back(new Thread(boost::bind(produce, perProducer)));
+    }
+    int64_t iterations = g_loop->iteration();
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < producers; ++i)
+    {
+        threads[i].start();
+    }
+    done.wait();
+    double seconds = timeDifference(Timestamp::now(), start);
+    for (int i = 0; i < producers; ++i)
+    {
+        threads[i].join();
+    }
+    printf("producers %d %8.1f ns/post %6.2f Mposts/s %8" PRId64 " loop iterations\n", producers,
+           seconds * 1e9 / static_cast<double>(g_total), static_cast<double>(g_total) / seconds / 1e6,
+           g_loop->iteration() - iterations);
+}
+
+void pong(Timestamp sent, std::vector<int> *latencies, CountDownLatch *latch)
+{
+    latencies->push_back(static_cast<int>(Timestamp::now().microSecondsSinceEpoch() - sent.microSecondsSinceEpoch()));
+    latch->countDown();
+}
+
+// 每次投递一个functor, 等它执行完再投下一个, 这时IO线程总是阻塞在poll()中, 每次都要唤醒
+void benchLatency(int rounds)
+{
+    std::vector<int> latencies;
+    latencies.reserve(rounds);
+    for (int i = 0; i < rounds; ++i)
+    {
+        CountDownLatch latch(1);
+        g_loop->queueInLoop(boost::bind(pong, Timestamp::now(), &latencies, &latch));
+        latch.wait();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    printf("latency   rounds %d median %d us, p99 %d us, max %d us\n", rounds,
+           latencies[rounds / 2], latencies[rounds * 99 / 100], latencies.back());
+}
+
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    EventLoopThread loopThread;
+    g_loop = loopThread.startLoop();
+
+    benchThroughput(1, n);
+    benchThroughput(2, n / 2);
+    benchThroughput(4, n / 4);
+    benchThroughput(8, n / 8);
+    benchLatency(10000);
+}
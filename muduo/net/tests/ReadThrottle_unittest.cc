@@ -0,0 +1,300 @@
+#include <muduo/base/Atomic.h>
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 读的流控: stopRead()/startRead(), setInputHighWaterMark()自动暂停读, 以及setUpstream()在下游积压时暂停上游.
+
+int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    struct sockaddr_in addr = InetAddress("127.0.0.1", port).getSockAddrInet();
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+    assert(ret == 0);
+    (void)ret;
+    return fd;
+}
+
+void writeAll(int fd, size_t total, char c)
+{
+    const string chunk(64 * 1024, c);
+    size_t sent = 0;
+    while (sent < total)
+    {
+        ssize_t n = ::write(fd, chunk.data(), std::min(chunk.size(), total - sent));
+        assert(n > 0);
+        sent += n;
+    }
+}
+
+size_t readUntilEof(int fd, int pauseEvery)
+{
+    char buf[16 * 1024];
+    size_t got = 0;
+    ssize_t n = 0;
+    int reads = 0;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+        got += n;
+        if (pauseEvery > 0 && ++reads % pauseEvery == 0)
+        {
+            ::usleep(1000); // 慢速的消费者
+        }
+    }
+    return got;
+}
+
+// ------------------------------------------------------------
+// stopRead()/startRead(): 暂停期间不回调messageCallback_, 其他线程可以恢复读
+// ------------------------------------------------------------
+
+TcpConnectionPtr g_paused;
+CountDownLatch g_pausedLatch(1);
+AtomicInt32 g_pausedMessages;
+string g_pausedReceived;
+
+void onPausedConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->stopRead();
+        assert(!conn->isReading());
+        g_paused = conn;
+        g_pausedLatch.countDown();
+    }
+    else
+    {
+        conn->getLoop()->quit();
+    }
+}
+
+void onPausedMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    g_pausedMessages.increment();
+    g_pausedReceived += buf->retrieveAllAsString();
+    if (g_pausedReceived == "hello")
+    {
+        conn->shutdown();
+    }
+}
+
+void pausedClient(uint16_t port)
+{
+    int fd = connectTo(port);
+    ssize_t n = ::write(fd, "hello", 5);
+    assert(n == 5);
+    (void)n;
+    g_pausedLatch.wait();
+    ::usleep(200 * 1000);
+    assert(g_pausedMessages.get() == 0); // 数据留在内核中
+    g_paused->startRead();               // 不在IO线程中
+    readUntilEof(fd, 0);
+    ::close(fd);
+}
+
+void testStopStartRead()
+{
+    const uint16_t port = 23602;
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "Paused");
+    server.setConnectionCallback(onPausedConnection);
+    server.setMessageCallback(onPausedMessage);
+    server.start();
+    Thread client(boost::bind(pausedClient, port));
+    client.start();
+    loop.loop();
+    client.join();
+    assert(g_pausedReceived == "hello");
+    g_paused.reset();
+    printf("stopRead/startRead OK\n");
+}
+
+// ------------------------------------------------------------
+// setInputHighWaterMark(): 消息回调不取数据, 定时器慢慢取, inputBuffer_不会一直增长
+// ------------------------------------------------------------
+
+const size_t kInputCap = 256 * 1024;
+const size_t kCapTotal = 16 * 1024 * 1024;
+TcpConnectionPtr g_slow;
+size_t g_maxInput = 0;
+size_t g_drained = 0;
+int g_pausedSeen = 0;
+
+void onSlowConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setInputHighWaterMark(kInputCap);
+        g_slow = conn;
+    }
+}
+
+void onSlowMessage(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+{
+    g_maxInput = std::max(g_maxInput, buf->readableBytes());
+}
+
+void drain(EventLoop *loop)
+{
+    if (!g_slow)
+    {
+        return;
+    }
+    if (!g_slow->isReading()) // 回调返回之后达到了上限
+    {
+        ++g_pausedSeen;
+    }
+    Buffer *buf = g_slow->inputBuffer();
+    size_t n = std::min<size_t>(buf->readableBytes(), 64 * 1024);
+    buf->retrieve(n);
+    g_drained += n;
+    if (g_drained == kCapTotal)
+    {
+        loop->quit();
+    }
+}
+
+void blast(uint16_t port)
+{
+    int fd = connectTo(port);
+    writeAll(fd, kCapTotal, 'q');
+    ::sleep(1);
+    ::close(fd);
+}
+
+void testInputHighWaterMark()
+{
+    const uint16_t port = 23603;
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "Cap");
+    server.setConnectionCallback(onSlowConnection);
+    server.setMessageCallback(onSlowMessage);
+    server.start();
+    loop.runEvery(0.001, boost::bind(drain, &loop));
+    Thread client(boost::bind(blast, port));
+    client.start();
+    loop.loop();
+    g_slow.reset();
+    client.join();
+    printf("input cap: max input %zu, paused %d\n", g_maxInput, g_pausedSeen);
+    assert(g_drained == kCapTotal);
+    assert(g_pausedSeen > 0);
+    assert(g_maxInput < 2 * kInputCap); // 达到上限之后最多再读一次
+    printf("input high water mark OK\n");
+}
+
+// ------------------------------------------------------------
+// setUpstream(): 第一个连接(快)读到的数据转发给第二个连接(慢), 第二个连接的输出积压时暂停读第一个连接
+// ------------------------------------------------------------
+
+const size_t kProxyTotal = 32 * 1024 * 1024;
+const size_t kHighWaterMark = 1024 * 1024;
+TcpConnectionPtr g_producer;
+TcpConnectionPtr g_consumer;
+size_t g_maxOutput = 0;
+size_t g_forwarded = 0;
+AtomicInt32 g_consumerDone;
+
+void onProxyConnection(const TcpConnectionPtr &conn)
+{
+    if (!conn->connected())
+    {
+        return;
+    }
+    if (!g_producer)
+    {
+        g_producer = conn;
+        conn->stopRead(); // 消费者连上之后才开始转发
+    }
+    else
+    {
+        g_consumer = conn;
+        conn->setHighWaterMarkCallback(HighWaterMarkCallback(), kHighWaterMark);
+        conn->setUpstream(g_producer);
+        g_producer->startRead();
+    }
+}
+
+void onProxyMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    if (conn != g_producer)
+    {
+        buf->retrieveAll();
+        return;
+    }
+    g_forwarded += buf->readableBytes();
+    g_consumer->send(buf);
+    g_maxOutput = std::max(g_maxOutput, g_consumer->outputBuffer()->readableBytes());
+    if (g_forwarded == kProxyTotal)
+    {
+        g_consumer->shutdown();
+    }
+}
+
+void produce(uint16_t port)
+{
+    int fd = connectTo(port);
+    writeAll(fd, kProxyTotal, 'p');
+    while (g_consumerDone.get() == 0)
+    {
+        ::usleep(10 * 1000);
+    }
+    ::close(fd);
+}
+
+void consume(uint16_t port, EventLoop *loop, size_t *got)
+{
+    ::usleep(100 * 1000); // 生产者先连上
+    int fd = connectTo(port);
+    *got = readUntilEof(fd, 16);
+    ::close(fd);
+    g_consumerDone.getAndSet(1);
+    loop->quit();
+}
+
+void testUpstream()
+{
+    const uint16_t port = 23604;
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "Proxy");
+    server.setConnectionCallback(onProxyConnection);
+    server.setMessageCallback(onProxyMessage);
+    server.start();
+    size_t got = 0;
+    Thread producer(boost::bind(produce, port));
+    Thread consumer(boost::bind(consume, port, &loop, &got));
+    producer.start();
+    consumer.start();
+    loop.loop();
+    consumer.join();
+    producer.join();
+    g_producer.reset();
+    g_consumer.reset();
+    printf("upstream: got %zu, max output %zu\n", got, g_maxOutput);
+    assert(got == kProxyTotal);
+    assert(g_maxOutput < 4 * kHighWaterMark); // 积压到高水位之后上游暂停了
+    printf("upstream OK\n");
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    testStopStartRead();
+    testInputHighWaterMark();
+    testUpstream();
+    printf("OK\n");
+}
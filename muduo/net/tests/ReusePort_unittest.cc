@@ -0,0 +1,157 @@
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Mutex.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThread.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <map>
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// TcpServer::setAcceptPerLoop(): 每个IO线程的loop有自己的SO_REUSEPORT监听socket, 连接在accept它的loop上建立,
+// 由内核分布到所有loop, baseloop不接受连接. ~TcpServer()关闭所有监听socket和连接.
+
+const int kThreads = 4;
+const int kConns = 400;
+
+MutexLock g_mutex;
+std::map<EventLoop *, int> g_distribution; // 每个loop上建立的连接数
+int g_wrongLoop = 0;                       // 连接回调不在连接所属的loop中
+int g_up = 0;
+int g_down = 0;
+
+void onConnection(const TcpConnectionPtr &conn)
+{
+    MutexLockGuard lock(g_mutex);
+    if (conn->getLoop() != EventLoop::getEventLoopOfCurrentThread())
+    {
+        ++g_wrongLoop;
+    }
+    if (conn->connected())
+    {
+        ++g_up;
+        ++g_distribution[conn->getLoop()];
+    }
+    else
+    {
+        ++g_down;
+    }
+}
+
+void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf);
+}
+
+void createServer(EventLoop *loop, uint16_t port, TcpServer **server, CountDownLatch *latch)
+{
+    *server = new TcpServer(loop, InetAddress("127.0.0.1", port), "ReusePort");
+    (*server)->setThreadNum(kThreads);
+    (*server)->setAcceptPerLoop(true);
+    (*server)->setConnectionCallback(onConnection);
+    (*server)->setMessageCallback(onMessage);
+    (*server)->start();
+    latch->countDown();
+}
+
+void destroyServer(TcpServer *server, CountDownLatch *latch)
+{
+    delete server;
+    latch->countDown();
+}
+
+int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    struct sockaddr_in addr = InetAddress("127.0.0.1", port).getSockAddrInet();
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) < 0)
+    {
+        int savedErrno = errno;
+        ::close(fd);
+        return -savedErrno;
+    }
+    return fd;
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    const uint16_t port = 23610;
+    EventLoopThread thread;
+    EventLoop *baseLoop = thread.startLoop();
+
+    TcpServer *server = NULL;
+    {
+        CountDownLatch latch(1);
+        baseLoop->runInLoop(boost::bind(createServer, baseLoop, port, &server, &latch));
+        latch.wait();
+    }
+    ::usleep(200 * 1000); // 等各个loop开始listen
+
+    int fds[kConns];
+    for (int i = 0; i < kConns; ++i)
+    {
+        fds[i] = connectTo(port);
+        assert(fds[i] >= 0);
+    }
+    for (int i = 0; i < kConns; ++i)
+    {
+        char buf[8];
+        ssize_t nw = ::write(fds[i], "hello", 5);
+        ssize_t nr = ::read(fds[i], buf, 5);
+        assert(nw == 5 && nr == 5 && memcmp(buf, "hello", 5) == 0);
+        (void)nw;
+        (void)nr;
+    }
+    for (int i = 0; i < kConns / 2; ++i) // 一半由客户端关闭, 另一半由~TcpServer()关闭
+    {
+        ::close(fds[i]);
+    }
+    ::usleep(300 * 1000);
+
+    {
+        MutexLockGuard lock(g_mutex);
+        printf("up %d down %d wrong loop %d loops %zu\n", g_up, g_down, g_wrongLoop, g_distribution.size());
+        assert(g_up == kConns);
+        assert(g_down == kConns / 2);
+        assert(g_distribution.size() == kThreads); // 每个IO线程都accept了连接
+        assert(g_distribution.count(baseLoop) == 0);
+    }
+
+    {
+        CountDownLatch latch(1);
+        baseLoop->runInLoop(boost::bind(destroyServer, server, &latch));
+        latch.wait();
+    }
+    ::usleep(200 * 1000);
+
+    for (int i = kConns / 2; i < kConns; ++i)
+    {
+        char c;
+        ssize_t n = ::read(fds[i], &c, 1);
+        assert(n == 0); // 连接被关闭了
+        (void)n;
+        ::close(fds[i]);
+    }
+    int fd = connectTo(port);
+    assert(fd == -ECONNREFUSED); // 所有loop的监听socket都关闭了
+    (void)fd;
+
+    {
+        MutexLockGuard lock(g_mutex);
+        assert(g_down == kConns);
+        assert(g_wrongLoop == 0);
+    }
+    printf("OK\n");
+}
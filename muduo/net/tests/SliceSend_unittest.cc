@@ -0,0 +1,148 @@
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <vector>
+#include <assert.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 输出队列和writev: send(StringPiece)和send(Slice)交替发送, 客户端先不读, 让writev只写出一部分,
+// 之后由handleWrite()接着发送. 检查收到的字节顺序, Slice发送完毕回调的顺序和时机, 以及WriteCompleteCallback.
+// 排队时很小的Slice会拷贝进outputBuffer_, 拷贝之后就回调, 所以只有大的Slice的回调按发送顺序.
+
+const int kRounds = 4;
+const size_t kBigSize = 2 * 1024 * 1024;
+
+string g_expected;
+std::vector<int> g_completed; // 发送完毕回调的编号, 大的Slice是偶数, 只在IO线程中访问
+size_t g_completedAtWriteComplete = 0;
+int g_writeCompleteCount = 0;
+int64_t g_writes = 0;
+boost::weak_ptr<const string> g_big;
+
+string header(int i)
+{
+    char buf[32];
+    snprintf(buf, sizeof buf, "hdr%d:", i);
+    return buf;
+}
+
+void onSendComplete(int id, const TcpConnectionPtr &, bool)
+{
+    g_completed.push_back(id);
+}
+
+void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        boost::shared_ptr<const string> big = boost::make_shared<const string>(kBigSize, 'B');
+        g_big = big;
+        for (int i = 0; i < kRounds; ++i)
+        {
+            conn->send(header(i));
+            conn->send(Slice(big), boost::bind(onSendComplete, 2 * i, _1, _2));
+            conn->send(Slice(big).slice(i, 100 + i), boost::bind(onSendComplete, 2 * i + 1, _1, _2));
+        }
+        conn->send("end");
+        assert(g_completed.empty()); // 回调不会在send()中直接调用
+        conn->shutdown(); // 等输出队列发送完毕再关闭写端
+    }
+    else
+    {
+        g_writes = conn->stats().writes;
+        conn->getLoop()->quit();
+    }
+}
+
+void onWriteComplete(const TcpConnectionPtr &)
+{
+    ++g_writeCompleteCount;
+    g_completedAtWriteComplete = g_completed.size();
+}
+
+void serverThread(uint16_t port, CountDownLatch *latch)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "SliceSend");
+    server.setConnectionCallback(onConnection);
+    server.setWriteCompleteCallback(onWriteComplete);
+    server.start();
+    latch->countDown();
+    loop.loop();
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    const uint16_t port = 23600;
+    for (int i = 0; i < kRounds; ++i)
+    {
+        g_expected += header(i);
+        g_expected += string(kBigSize, 'B');
+        g_expected += string(100 + i, 'B');
+    }
+    g_expected += "end";
+
+    CountDownLatch latch(1);
+    Thread thread(boost::bind(serverThread, port, &latch));
+    thread.start();
+    latch.wait();
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    int rcvbuf = 4096; // 接收窗口很小, 服务端的writev一定只能写出一部分
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+    struct sockaddr_in addr = InetAddress("127.0.0.1", port).getSockAddrInet();
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+    assert(ret == 0);
+    (void)ret;
+    ::usleep(200 * 1000); // 服务端的发送缓冲区填满之后再读
+
+    string received;
+    char buf[64 * 1024];
+    ssize_t n = 0;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+        received.append(buf, n);
+    }
+    ::close(fd);
+    thread.join();
+
+    printf("received %zu bytes, writes %lld, write complete %d\n",
+           received.size(), static_cast<long long>(g_writes), g_writeCompleteCount);
+    assert(received == g_expected);
+    assert(g_writes > 1); // 发送被分成了多次, 由handleWrite()接着发送
+    assert(g_completed.size() == 2 * kRounds); // 每个Slice都回调了一次
+    std::vector<int> seen(2 * kRounds, 0);
+    int lastBig = -1;
+    for (size_t i = 0; i < g_completed.size(); ++i)
+    {
+        int id = g_completed[i];
+        ++seen[id];
+        if (id % 2 == 0)
+        {
+            assert(id > lastBig); // 大的Slice按发送顺序发完
+            lastBig = id;
+        }
+    }
+    for (int i = 0; i < 2 * kRounds; ++i)
+    {
+        assert(seen[i] == 1);
+    }
+    assert(g_writeCompleteCount >= 1);
+    assert(g_completedAtWriteComplete == 2 * kRounds); // 输出队列发完时所有Slice都已经回调
+    assert(g_big.expired());                           // 发送完毕后不再持有Slice
+    printf("OK\n");
+}
@@ -0,0 +1,132 @@
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/EventLoop.h>
+
+#include <boost/bind.hpp>
+
+#include <new>
+#include <inttypes.h>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 统计operator new的次数, 看每个定时器操作要分配几次内存
+int64_t g_allocs = 0;
+
+void *operator new(size_t size)
+{
+    ++g_allocs;
+    void *p = ::malloc(size ? size : 1);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) throw()
+{
+    ::free(p);
+}
+
+void operator delete(void *p, size_t) throw()
+{
+    ::free(p);
+}
+
+int g_fired = 0;
+int g_total = 0;
+EventLoop *g_loop = NULL;
+
+void onTimer()
+{
+    if (++g_fired == g_total)
+    {
+        g_loop->quit();
+    }
+}
+
+void noop()
+{
+}
+
+// 模拟RPC的超时定时器: 每个请求注册一个几秒后的定时器, 回复到达后取消.
+// 同时有live个请求在路上, 总共n个.
+void benchChurn(EventLoop *loop, int n, int live)
+{
+    std::vector<TimerId> inflight(live);
+    for (int i = 0; i < live; ++i)
+    {
+        inflight[i] = loop->runAfter(5.0 + (i % 1000) * 0.001, noop);
+    }
+
+    int64_t allocs = g_allocs;
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < n; ++i)
+    {
+        int slot = i % live;
+        loop->cancel(inflight[slot]);
+        inflight[slot] = loop->runAfter(5.0 + (i % 1000) * 0.001, noop);
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    printf("churn   live %7d %8.1f ns/op (add+cancel) %5.2f allocs/op\n", live,
+           seconds * 1e9 / n, static_cast<double>(g_allocs - allocs) / n);
+
+    for (int i = 0; i < live; ++i)
+    {
+        loop->cancel(inflight[i]);
+    }
+}
+
+// n个定时器在差不多同一时刻到期, 测量从注册到全部回调完的时间
+void benchExpire(EventLoop *loop, int n)
+{
+    g_fired = 0;
+    g_total = n;
+    int64_t allocs = g_allocs;
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < n; ++i)
+    {
+        loop->runAfter(0.001 * (i % 10), onTimer);
+    }
+    loop->loop();
+    double seconds = timeDifference(Timestamp::now(), start);
+    printf("expire  n    %7d %8.1f ns/timer (add+fire) %5.2f allocs/timer\n", n,
+           seconds * 1e9 / n, static_cast<double>(g_allocs - allocs) / n);
+}
+
+// n个定时器的到期时刻均匀分布在1秒内, 比较不同slack下loop被唤醒的次数
+void benchSlack(EventLoop *loop, int n, double slack)
+{
+    g_fired = 0;
+    g_total = n;
+    int64_t iterations = loop->iteration();
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < n; ++i)
+    {
+        loop->runAfter(static_cast<double>(i) / n, slack, onTimer);
+    }
+    loop->loop();
+    double seconds = timeDifference(Timestamp::now(), start);
+    printf("slack   %5.0fms %7d timers %6" PRId64 " wakeups %6.3fs\n", slack * 1000, n,
+           loop->iteration() - iterations, seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    EventLoop loop;
+    g_loop = &loop;
+
+    benchChurn(&loop, n, 1000);
+    benchChurn(&loop, n, 100000);
+    benchExpire(&loop, n / 10);
+    benchExpire(&loop, n / 10);
+
+    benchSlack(&loop, n / 100, 0.0);
+    benchSlack(&loop, n / 100, 0.001);
+    benchSlack(&loop, n / 100, 0.01);
+    benchSlack(&loop, n / 100, 0.05);
+}
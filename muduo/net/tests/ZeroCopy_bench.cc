@@ -0,0 +1,139 @@
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/Slice.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 在回环上用普通send()和MSG_ZEROCOPY各发送一遍同样的数据, 比较吞吐量和CPU时间.
+// 注意: 回环上内核总是会拷贝(完成通知带有SO_EE_CODE_ZEROCOPY_COPIED), 要在真实网卡上才能看到收益.
+
+const size_t kSliceSize = 256 * 1024;
+
+Slice g_slice;
+int64_t g_total = 0;
+size_t g_minBytes = 0;
+int g_completed = 0;
+int g_zeroCopied = 0;
+
+double cpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void onSendComplete(const TcpConnectionPtr &, bool zeroCopied)
+{
+    ++g_completed;
+    if (zeroCopied)
+    {
+        ++g_zeroCopied;
+    }
+}
+
+void sendMore(const TcpConnectionPtr &conn)
+{
+    int64_t *sent = boost::any_cast<int64_t>(conn->getMutableContext());
+    if (*sent < g_total)
+    {
+        conn->send(g_slice, onSendComplete);
+        *sent += static_cast<int64_t>(g_slice.size());
+    }
+    else
+    {
+        conn->shutdown();
+    }
+}
+
+void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        if (g_minBytes > 0 && !conn->setZeroCopy(g_minBytes))
+        {
+            LOG_ERROR << "SO_ZEROCOPY is not supported";
+        }
+        conn->setContext(int64_t(0));
+        sendMore(conn);
+    }
+}
+
+void onMessage(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+{
+    buf->retrieveAll();
+}
+
+// 客户端: 阻塞读到EOF, 然后让服务端的loop退出
+void receive(EventLoop *loop, const InetAddress &addr, int64_t *received)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in sa = addr.getSockAddrInet();
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&sa), sizeof sa) < 0)
+    {
+        LOG_SYSFATAL << "connect";
+    }
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+        *received += n;
+    }
+    ::close(fd);
+    loop->quit();
+}
+
+void run(const char *name, uint16_t port, size_t minBytes)
+{
+    g_minBytes = minBytes;
+    g_completed = 0;
+    g_zeroCopied = 0;
+
+    EventLoop loop;
+    InetAddress addr("127.0.0.1", port);
+    TcpServer server(&loop, addr, name);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setWriteCompleteCallback(sendMore);
+    server.start();
+
+    int64_t received = 0;
+    Thread client(boost::bind(receive, &loop, addr, &received), "client");
+
+    double cpuStart = cpuSeconds();
+    Timestamp start(Timestamp::now());
+    client.start();
+    loop.loop();
+    client.join();
+    double seconds = timeDifference(Timestamp::now(), start);
+    double cpu = cpuSeconds() - cpuStart;
+
+    printf("%-9s %8.1f MiB/s  cpu %6.3fs  completions %d  zero-copied %d\n", name,
+           static_cast<double>(received) / seconds / 1024 / 1024, cpu, g_completed, g_zeroCopied);
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::WARN);
+    int megabytes = argc > 1 ? atoi(argv[1]) : 4096;
+    g_total = static_cast<int64_t>(megabytes) * 1024 * 1024;
+
+    boost::shared_ptr<string> data(new string(kSliceSize, 'z'));
+    g_slice = Slice(data);
+
+    run("copy", 23460, 0);
+    run("zerocopy", 23461, kSliceSize);
+}